@@ -20,6 +20,7 @@ extern "C" {
 #ifdef __cplusplus
 namespace circa {
     struct Block;
+    struct JsonStream;
     struct ListData;
     struct NativePatch;
     struct Term;
@@ -27,6 +28,7 @@ namespace circa {
     struct World;
     struct Value;
     struct VM;
+    struct WorkerPool;
 }
 
 typedef circa::Block caBlock;
@@ -45,6 +47,8 @@ typedef circa::World caWorld;
 
 typedef circa::NativePatch caNativePatch;
 typedef circa::Value caValue;
+typedef circa::WorkerPool caWorkerPool;
+typedef circa::JsonStream caJsonStream;
 
 #else
 
@@ -56,6 +60,8 @@ typedef struct caType caType;
 typedef struct caWorld caWorld;
 typedef struct caNativePatch caNativePatch;
 typedef struct caValue caValue;
+typedef struct caWorkerPool caWorkerPool;
+typedef struct caJsonStream caJsonStream;
 
 #endif
 
@@ -170,6 +176,10 @@ typedef void (*caNativePtrRelease)(void* ptr);
 
 typedef void (*caLogFunc)(void* context, const char* msg);
 
+// Called on each worker thread after its World is created, so the embedder can install
+// native patches or add module search paths.
+typedef void (*caWorkerSetupFunc)(void* context, caWorld* world);
+
 // -- Setting up the Circa environment --
 
 // Create a caWorld. This should be done once at the start of the program.
@@ -349,7 +359,8 @@ bool circa_is_string(caValue* value);
 bool circa_is_symbol(caValue* value);
 bool circa_is_type(caValue* value);
 
-// Read the value from a caValue.
+// Read the value from a caValue. For a short string, circa_string points into the caValue
+// itself, so the result is only good until that value is moved or modified.
 bool        circa_bool(caValue* value);
 char*       circa_blob(caValue* value);
 caBlock*    circa_block(caValue* value);
@@ -468,6 +479,55 @@ void circa_parse_string_len(const char* str, int len, caValue* out);
 // Write a string representation of 'value' to 'out'.
 void circa_to_string(caValue* value, caValue* out);
 
+// -- JSON --
+
+// Parse a JSON document from the string 'in'. Objects become tables with string keys, and
+// null becomes nil. If there is a parsing error, an error value will be saved to 'out'.
+void circa_parse_json(caValue* in, caValue* out);
+void circa_parse_json_len(const char* str, int len, caValue* out);
+
+// Write 'in' as a JSON string. Tables and struct values are written as objects. If 'in'
+// contains a value with no JSON form, an error value will be saved to 'out'.
+void circa_to_json(caValue* in, caValue* out);
+
+// Create an incremental parser, for JSON input that arrives in chunks. If 'arrayElements'
+// is true, the input is one or more arrays, and each array element is emitted as soon as
+// it's complete. Otherwise each top-level value is emitted (such as for newline-delimited
+// JSON). The stream only holds onto the input for the value that's in progress.
+caJsonStream* circa_new_json_stream(bool arrayElements);
+void circa_free_json_stream(caJsonStream* stream);
+
+// Add a chunk of input. 'valuesOut' is set to a list of the values that this chunk
+// completed. If the input is invalid, 'valuesOut' is an error value, and so is the result
+// of each later push until circa_json_stream_finish is called.
+void circa_json_stream_push(caJsonStream* stream, const char* data, int len,
+    caValue* valuesOut);
+
+// Mark the end of the input. 'valuesOut' is set to a list of any values completed by the
+// end, or an error value if the input stopped in the middle of a value. Afterwards, the
+// stream can be used for new input.
+void circa_json_stream_finish(caJsonStream* stream, caValue* valuesOut);
+
+// -- Binary Format --
+
+// Encode 'value' in a compact binary form, as a Blob. Numbers, bools, strings, symbols,
+// blobs, lists, tables and struct values can be encoded. If 'value' contains anything
+// else, an error value will be saved to 'blobOut'.
+void circa_to_binary(caValue* value, caValue* blobOut);
+
+// Decode a value that was encoded with circa_to_binary. If the data is malformed, an
+// error value will be saved to 'out'.
+void circa_from_binary(const char* data, int len, caValue* out);
+
+// Decode just the value found by following 'path' (a list of list indexes and table
+// keys), without decoding the rest. An error value is saved to 'out' if the path isn't
+// found.
+void circa_binary_get(const char* data, int len, caValue* path, caValue* out);
+
+// Length of the list, table, string or blob at 'path', without decoding it. Returns -1
+// if the path isn't found, or the value there doesn't have a length.
+int circa_binary_length(const char* data, int len, caValue* path);
+
 // -- Code Reflection --
 
 // Find a Term by name, looking in the given block.
@@ -532,6 +592,13 @@ void circa_finish_native_patch(caNativePatch* module);
 // -- File IO --
 void circa_read_file(caWorld* world, const char* filename, caValue* contentsOut);
 void circa_read_file_with_vm(caVM* vm, const char* filename, caValue* contentsOut);
+
+// Like circa_read_file, but files on the local filesystem are memory-mapped instead of
+// copied. The result is a Blob over the mapping, which stays mapped until the Blob (and
+// every slice of it) is released. The file must not be truncated while it's mapped, so
+// this is meant for large read-only inputs, such as a tarball for
+// circa_use_tarball_filesystem. circa_read_file never maps.
+void circa_read_file_mapped(caWorld* world, const char* filename, caValue* contentsOut);
 bool circa_file_exists(caWorld* world, const char* filename);
 int circa_file_get_version(caWorld* world, const char* filename);
 void circa_use_local_filesystem(caWorld* world, const char* rootDir);
@@ -555,6 +622,38 @@ void circa_repl_run_line(caVM* vm, caValue* input, caValue* output);
 void circa_resolve_possible_module_path(caWorld* world, caValue* dir, caValue* moduleName, caValue* result);
 caBlock* circa_load_module_by_filename(caWorld* world, const char* filename);
 
+// -- Worker threads --
+//
+// List.par_map, par_filter and par_reduce use a pool that's owned by the World. It's
+// started on first use, with one thread per core, or with the number of threads given in
+// the CIRCA_WORKER_THREADS environment variable.
+
+// Start a pool of 'threadCount' worker threads. Each thread has its own World, which copies
+// the file sources and module search paths of 'world'. If 'setup' is not NULL, it's called on each thread
+// once that World is created. Values are copied when they're sent to or from a worker,
+// and only values that circa_to_binary can encode can be sent.
+caWorkerPool* circa_new_worker_pool(caWorld* world, int threadCount, caWorkerSetupFunc setup,
+    void* context);
+
+// Stop all worker threads and free the pool. Calls that haven't finished are still run.
+void circa_free_worker_pool(caWorkerPool* pool);
+
+// Create an instance that runs 'functionName' from the module file 'filename'. Returns
+// the instance id. An instance stays on one thread and keeps its state between calls.
+int circa_worker_spawn(caWorkerPool* pool, const char* filename, const char* functionName);
+
+// Queue a call to an instance, with a list of inputs. Returns false (and writes a message
+// to 'errorOut') if the inputs can't be sent.
+bool circa_worker_call(caWorkerPool* pool, int instance, caValue* inputs, caValue* errorOut);
+
+// Fetch the result of a finished call, as [instance, :success, output] or
+// [instance, :error, message]. If 'wait' is true, this blocks until a result is ready.
+// Returns false if there's no result (or, when waiting, if no calls are pending).
+bool circa_worker_receive(caWorkerPool* pool, caValue* resultOut, bool wait);
+
+// Delete an instance. Calls that were queued before this are still run.
+void circa_worker_kill(caWorkerPool* pool, int instance);
+
 // -- Debugging --
 
 // 'dump' commands will print a representation to stdout
@@ -0,0 +1,20 @@
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+#pragma once
+
+namespace circa {
+
+typedef void (*BenchmarkFunc)(int iterations);
+
+// Run 'func' a few times with the given number of iterations, and print the best time per
+// iteration.
+void benchmark(const char* name, BenchmarkFunc func, int iterations);
+
+// Keeps results alive so that the compiler can't remove the work being measured.
+void benchmark_sink(const void* ptr);
+
+void hashtable_benchmarks();
+void json_benchmarks();
+void symbol_benchmarks();
+
+} // namespace circa
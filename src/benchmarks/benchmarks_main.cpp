@@ -0,0 +1,79 @@
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+// Microbenchmarks for the runtime's core data structures. These only use the internal
+// APIs (not any particular implementation), so the same program can be built against an
+// older revision to compare the two.
+//
+// Usage: circa_bench [suite names...]
+
+#include "common_headers.h"
+
+#include <chrono>
+
+#include "benchmarks.h"
+
+namespace circa {
+
+const int BENCHMARK_RUNS = 3;
+
+static const void* volatile g_sink;
+
+void benchmark_sink(const void* ptr)
+{
+    g_sink = ptr;
+}
+
+void benchmark(const char* name, BenchmarkFunc func, int iterations)
+{
+    double best = 0;
+
+    for (int run=0; run < BENCHMARK_RUNS; run++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        func(iterations);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        ns /= iterations;
+        if (run == 0 || ns < best)
+            best = ns;
+    }
+
+    printf("%-40s %10.1f ns\n", name, best);
+}
+
+struct BenchmarkSuite {
+    const char* name;
+    void (*run)();
+};
+
+static BenchmarkSuite g_suites[] = {
+    { "hashtable", hashtable_benchmarks },
+    { "json", json_benchmarks },
+    { "symbols", symbol_benchmarks },
+};
+
+} // namespace circa
+
+using namespace circa;
+
+int main(int argc, const char* args[])
+{
+    caWorld* world = circa_initialize();
+
+    int suiteCount = sizeof(g_suites) / sizeof(g_suites[0]);
+
+    for (int i=0; i < suiteCount; i++) {
+        bool selected = argc <= 1;
+        for (int arg=1; arg < argc; arg++)
+            if (strcmp(args[arg], g_suites[i].name) == 0)
+                selected = true;
+
+        if (selected) {
+            printf("-- %s\n", g_suites[i].name);
+            g_suites[i].run();
+        }
+    }
+
+    circa_shutdown(world);
+    return 0;
+}
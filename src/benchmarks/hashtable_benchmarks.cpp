@@ -0,0 +1,142 @@
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+#include "common_headers.h"
+
+#include "hashtable.h"
+#include "list.h"
+#include "string_type.h"
+#include "symbols.h"
+#include "tagged_value.h"
+
+#include "benchmarks.h"
+
+namespace circa {
+
+enum KeyKind { INT_KEYS, SYMBOL_KEYS, STRING_KEYS, LONG_STRING_KEYS };
+
+// Keys in the table, and keys that are not in the table. These point to locals in
+// hashtable_benchmarks.
+static Value* g_keys;
+static Value* g_missingKeys;
+static Value* g_table;
+
+static void make_key(KeyKind kind, int i, Value* out)
+{
+    char buf[64];
+    switch (kind) {
+    case INT_KEYS:
+        set_int(out, i);
+        break;
+    case SYMBOL_KEYS:
+        sprintf(buf, "key%d", i);
+        set_symbol(out, string_to_symbol(buf));
+        break;
+    case STRING_KEYS:
+        sprintf(buf, "key%d", i);
+        set_string(out, buf);
+        break;
+    case LONG_STRING_KEYS:
+        sprintf(buf, "a_somewhat_longer_key_%d", i);
+        set_string(out, buf);
+        break;
+    }
+}
+
+static void setup(KeyKind kind, int count)
+{
+    set_list(g_keys, count);
+    set_list(g_missingKeys, count);
+    set_hashtable(g_table);
+
+    for (int i=0; i < count; i++) {
+        make_key(kind, i, list_get(g_keys, i));
+        make_key(kind, i + count, list_get(g_missingKeys, i));
+        set_int(hashtable_insert(g_table, list_get(g_keys, i)), i);
+    }
+}
+
+static void lookup_hit(int iterations)
+{
+    int count = list_length(g_keys);
+    for (int i=0; i < iterations; i++)
+        benchmark_sink(hashtable_get(g_table, list_get(g_keys, i % count)));
+}
+
+static void lookup_miss(int iterations)
+{
+    int count = list_length(g_missingKeys);
+    for (int i=0; i < iterations; i++)
+        benchmark_sink(hashtable_get(g_table, list_get(g_missingKeys, i % count)));
+}
+
+static void insert_all(int iterations)
+{
+    // Each iteration is one insert, into a table that is rebuilt from empty.
+    int count = list_length(g_keys);
+    Value table;
+    for (int i=0; i < iterations; i++) {
+        if (i % count == 0)
+            set_hashtable(&table);
+        set_int(hashtable_insert(&table, list_get(g_keys, i % count)), i);
+    }
+    benchmark_sink(&table);
+}
+
+static void remove_and_insert(int iterations)
+{
+    int count = list_length(g_keys);
+    for (int i=0; i < iterations; i++) {
+        Value* key = list_get(g_keys, i % count);
+        hashtable_remove(g_table, key);
+        set_int(hashtable_insert(g_table, key), i);
+    }
+}
+
+static void iterate_copy(int iterations)
+{
+    // Each iteration visits one entry, of a touched copy of the table. Large copies are
+    // stored as a HAMT.
+    Value shared;
+    copy(g_table, &shared);
+    hashtable_touch(&shared);
+    int visited = 0;
+    while (visited < iterations) {
+        for (HashtableIterator it(&shared); it && visited < iterations; ++it) {
+            benchmark_sink(it.value());
+            visited++;
+        }
+    }
+}
+
+void hashtable_benchmarks()
+{
+    const char* kindNames[] = { "int", "symbol", "string", "long string" };
+    int sizes[] = { 8, 64, 4096 };
+    const int iterations = 200000;
+
+    Value keys, missingKeys, table;
+    g_keys = &keys;
+    g_missingKeys = &missingKeys;
+    g_table = &table;
+
+    for (int kind=INT_KEYS; kind <= LONG_STRING_KEYS; kind++) {
+        for (int sizeIndex=0; sizeIndex < 3; sizeIndex++) {
+            int size = sizes[sizeIndex];
+            setup(KeyKind(kind), size);
+
+            char name[100];
+            sprintf(name, "%s keys, %d: get hit", kindNames[kind], size);
+            benchmark(name, lookup_hit, iterations);
+            sprintf(name, "%s keys, %d: get miss", kindNames[kind], size);
+            benchmark(name, lookup_miss, iterations);
+            sprintf(name, "%s keys, %d: insert", kindNames[kind], size);
+            benchmark(name, insert_all, iterations);
+            sprintf(name, "%s keys, %d: remove + insert", kindNames[kind], size);
+            benchmark(name, remove_and_insert, iterations);
+            sprintf(name, "%s keys, %d: iterate copy", kindNames[kind], size);
+            benchmark(name, iterate_copy, iterations);
+        }
+    }
+}
+
+} // namespace circa
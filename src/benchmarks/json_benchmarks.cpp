@@ -0,0 +1,109 @@
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+#include "common_headers.h"
+
+#include "json.h"
+#include "list.h"
+#include "string_type.h"
+#include "tagged_value.h"
+
+#include "benchmarks.h"
+
+namespace circa {
+
+const int JSON_ITEM_COUNT = 1000;
+
+// Source documents, and the values that they parse to.
+static Value* g_numbersText;
+static Value* g_stringsText;
+static Value* g_recordsText;
+static Value* g_numbers;
+static Value* g_strings;
+static Value* g_records;
+
+static void build_documents()
+{
+    std::string numbers = "[";
+    std::string strings = "[";
+    std::string records = "[";
+
+    for (int i=0; i < JSON_ITEM_COUNT; i++) {
+        char buf[200];
+        const char* sep = i > 0 ? ", " : "";
+
+        sprintf(buf, "%s%d, %d.%d", sep, i * 7919, i, i % 100);
+        numbers += buf;
+
+        if (i % 8 == 0)
+            sprintf(buf, "%s\"line %d\\nwith \\\"escapes\\\" \\u00e9\"", sep, i);
+        else
+            sprintf(buf, "%s\"a plain string value, number %d\"", sep, i);
+        strings += buf;
+
+        sprintf(buf, "%s\n  {\"id\": %d, \"name\": \"item %d\", \"active\": %s,"
+            " \"score\": %d.5, \"tags\": [\"a\", \"b\"], \"parent\": null}",
+            sep, i, i, i % 2 ? "true" : "false", i);
+        records += buf;
+    }
+
+    numbers += "]";
+    strings += "]";
+    records += "]";
+
+    set_string(g_numbersText, numbers.c_str());
+    set_string(g_stringsText, strings.c_str());
+    set_string(g_recordsText, records.c_str());
+}
+
+static void parse_document(Value* text, int iterations)
+{
+    Value result;
+    for (int i=0; i < iterations; i++) {
+        json_parse(as_cstring(text), &result);
+        benchmark_sink(&result);
+    }
+}
+
+static void write_document(Value* value, int iterations)
+{
+    Value result;
+    for (int i=0; i < iterations; i++) {
+        json_write(value, &result);
+        benchmark_sink(&result);
+    }
+}
+
+static void parse_numbers(int iterations) { parse_document(g_numbersText, iterations); }
+static void parse_strings(int iterations) { parse_document(g_stringsText, iterations); }
+static void parse_records(int iterations) { parse_document(g_recordsText, iterations); }
+static void write_numbers(int iterations) { write_document(g_numbers, iterations); }
+static void write_strings(int iterations) { write_document(g_strings, iterations); }
+static void write_records(int iterations) { write_document(g_records, iterations); }
+
+void json_benchmarks()
+{
+    const int iterations = 200;
+
+    Value numbersText, stringsText, recordsText;
+    Value numbers, strings, records;
+    g_numbersText = &numbersText;
+    g_stringsText = &stringsText;
+    g_recordsText = &recordsText;
+    g_numbers = &numbers;
+    g_strings = &strings;
+    g_records = &records;
+
+    build_documents();
+    json_parse(as_cstring(&numbersText), &numbers);
+    json_parse(as_cstring(&stringsText), &strings);
+    json_parse(as_cstring(&recordsText), &records);
+
+    benchmark("parse numbers (2000)", parse_numbers, iterations);
+    benchmark("parse strings (1000)", parse_strings, iterations);
+    benchmark("parse records (1000)", parse_records, iterations);
+    benchmark("write numbers (2000)", write_numbers, iterations);
+    benchmark("write strings (1000)", write_strings, iterations);
+    benchmark("write records (1000)", write_records, iterations);
+}
+
+} // namespace circa
@@ -0,0 +1,83 @@
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+#include "common_headers.h"
+
+#include "list.h"
+#include "string_type.h"
+#include "symbols.h"
+#include "tagged_value.h"
+
+#include "benchmarks.h"
+
+namespace circa {
+
+const int SYMBOL_NAME_COUNT = 256;
+
+// Names of symbols that already exist, as C strings and as String values.
+static char g_names[SYMBOL_NAME_COUNT][32];
+static Value* g_nameStrings;
+static int g_newSymbolCounter = 0;
+
+static void lookup_builtin(int iterations)
+{
+    const char* names[] = { "unknown", "file", "success", "failure" };
+    for (int i=0; i < iterations; i++)
+        benchmark_sink((void*) (size_t) string_to_symbol(names[i % 4]));
+}
+
+static void lookup_existing(int iterations)
+{
+    for (int i=0; i < iterations; i++)
+        benchmark_sink((void*) (size_t) string_to_symbol(g_names[i % SYMBOL_NAME_COUNT]));
+}
+
+static void lookup_existing_from_string_value(int iterations)
+{
+    Value symbol;
+    for (int i=0; i < iterations; i++) {
+        set_symbol_from_string(&symbol, list_get(g_nameStrings, i % SYMBOL_NAME_COUNT));
+        benchmark_sink(&symbol);
+    }
+}
+
+static void create_new(int iterations)
+{
+    char name[32];
+    for (int i=0; i < iterations; i++) {
+        sprintf(name, "new_symbol_%d", g_newSymbolCounter++);
+        benchmark_sink((void*) (size_t) string_to_symbol(name));
+    }
+}
+
+static void to_string(int iterations)
+{
+    Value symbol, str;
+    set_symbol(&symbol, string_to_symbol(g_names[0]));
+    for (int i=0; i < iterations; i++) {
+        symbol_to_string(&symbol, &str);
+        benchmark_sink(&str);
+    }
+}
+
+void symbol_benchmarks()
+{
+    const int iterations = 200000;
+
+    Value nameStrings;
+    g_nameStrings = &nameStrings;
+    set_list(&nameStrings, SYMBOL_NAME_COUNT);
+
+    for (int i=0; i < SYMBOL_NAME_COUNT; i++) {
+        sprintf(g_names[i], "existing_symbol_%d", i);
+        string_to_symbol(g_names[i]);
+        set_string(list_get(&nameStrings, i), g_names[i]);
+    }
+
+    benchmark("lookup builtin", lookup_builtin, iterations);
+    benchmark("lookup existing", lookup_existing, iterations);
+    benchmark("lookup existing, from String", lookup_existing_from_string_value, iterations);
+    benchmark("create new", create_new, iterations);
+    benchmark("symbol_to_string", to_string, iterations);
+}
+
+} // namespace circa
@@ -0,0 +1,848 @@
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+#include "common_headers.h"
+
+#include "binary_repr.h"
+#include "blob.h"
+#include "hashtable.h"
+#include "kernel.h"
+#include "list.h"
+#include "names.h"
+#include "native_patch.h"
+#include "string_type.h"
+#include "symbols.h"
+#include "tagged_value.h"
+#include "type.h"
+#include "vm.h"
+#include "world.h"
+
+namespace circa {
+
+/*
+ Binary format
+
+ A compact encoding for trees of plain data: ints, floats, bools, strings, symbols,
+ blobs, lists, tables, and struct values. It's used to send values between worker
+ threads, and it's stable enough to save to disk or send to another process.
+
+ Layout:
+
+   header:  "CAB" 0x01, u32 size of the names section
+   names:   varint count, then each name as (varint length, bytes)
+   value:   tag byte, followed by:
+
+     null, false, true    nothing
+     int                  zigzag varint
+     float                4 bytes
+     string, blob         varint length, bytes
+     symbol               varint name index
+     list, table          varint count, u32 size of contents, contents
+     struct               varint name index (the type name), varint count, u32 size of
+                          contents, contents
+
+ Fixed-size numbers are little-endian. A table's contents alternate keys and values.
+
+ Symbols and type names are stored by name (symbol ids differ between processes), and
+ each distinct name is only stored once. Lists and tables record the size of their
+ contents, so a reader can skip over one without looking inside. binary_get uses this
+ to find one value in a large encoding, and decode only that value. Strings and blobs
+ are stored as-is, and a blob that's decoded out of a Blob shares its memory.
+
+ When decoding a struct, the type is found by name in the builtins and the loaded
+ modules. If there's no matching struct type, the value is decoded as a plain list.
+*/
+
+enum BinaryTag {
+    BIN_NULL = 0,
+    BIN_FALSE,
+    BIN_TRUE,
+    BIN_INT,
+    BIN_FLOAT,
+    BIN_STRING,
+    BIN_SYMBOL,
+    BIN_BLOB,
+    BIN_LIST,
+    BIN_TABLE,
+    BIN_STRUCT
+};
+
+const char BINARY_MAGIC[4] = { 'C', 'A', 'B', 1 };
+
+// Values nested deeper than this are rejected (when encoding and decoding), instead of
+// overflowing the C stack.
+const int BINARY_MAX_DEPTH = 512;
+
+// -- Writing --
+
+void binary_buffer_init(BinaryBuffer* buf)
+{
+    buf->data = NULL;
+    buf->size = 0;
+    buf->capacity = 0;
+}
+
+static char* buffer_reserve(BinaryBuffer* buf, u32 size)
+{
+    if (buf->size + size > buf->capacity) {
+        u32 capacity = buf->capacity < 64 ? 64 : buf->capacity;
+        while (capacity < buf->size + size)
+            capacity *= 2;
+        buf->data = (char*) ca_realloc(buf->data, capacity);
+        buf->capacity = capacity;
+    }
+    return buf->data + buf->size;
+}
+
+static void buffer_append(BinaryBuffer* buf, const void* data, u32 size)
+{
+    memcpy(buffer_reserve(buf, size), data, size);
+    buf->size += size;
+}
+
+static void buffer_append_u8(BinaryBuffer* buf, u8 value)
+{
+    *buffer_reserve(buf, 1) = (char) value;
+    buf->size++;
+}
+
+static void write_u32_at(char* out, u32 value)
+{
+    out[0] = (char) value;
+    out[1] = (char) (value >> 8);
+    out[2] = (char) (value >> 16);
+    out[3] = (char) (value >> 24);
+}
+
+static void buffer_append_u32(BinaryBuffer* buf, u32 value)
+{
+    write_u32_at(buffer_reserve(buf, 4), value);
+    buf->size += 4;
+}
+
+static void buffer_append_varint(BinaryBuffer* buf, u32 value)
+{
+    char* out = buffer_reserve(buf, 5);
+    int length = 0;
+    while (value >= 0x80) {
+        out[length++] = (char) (value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (char) value;
+    buf->size += length;
+}
+
+struct BinaryWriter {
+    BinaryBuffer body;
+
+    // Names section. 'nameIndex' maps each symbol and type name to its index.
+    BinaryBuffer names;
+    u32 nameCount;
+    Value nameIndex;
+
+    bool failed;
+    Value error;
+};
+
+static void writer_fail(BinaryWriter* writer, const char* message, Value* value)
+{
+    writer->failed = true;
+    set_string(&writer->error, "binary: ");
+    string_append(&writer->error, message);
+    if (value != NULL)
+        string_append(&writer->error, &value->value_type->name);
+}
+
+// Index of a name in the names section, adding it if needed. 'key' is the symbol, or the
+// Type's name as a String.
+static u32 writer_name_index(BinaryWriter* writer, Value* key, const char* str, int length)
+{
+    Value* existing = hashtable_get(&writer->nameIndex, key);
+    if (existing != NULL)
+        return (u32) as_int(existing);
+
+    u32 index = writer->nameCount++;
+    set_int(hashtable_insert(&writer->nameIndex, key, false), (int) index);
+    buffer_append_varint(&writer->names, length);
+    buffer_append(&writer->names, str, length);
+    return index;
+}
+
+static void encode_value(BinaryWriter* writer, Value* value, int depth);
+
+static void encode_elements(BinaryWriter* writer, Value* list, int depth)
+{
+    int count = list_length(list);
+    buffer_append_varint(&writer->body, count);
+
+    // Contents size is filled in afterwards.
+    u32 sizeOffset = writer->body.size;
+    buffer_append_u32(&writer->body, 0);
+
+    for (int i=0; i < count && !writer->failed; i++)
+        encode_value(writer, list_get(list, i), depth + 1);
+
+    u32 contentsSize = writer->body.size - sizeOffset - 4;
+    write_u32_at(writer->body.data + sizeOffset, contentsSize);
+}
+
+static void encode_value(BinaryWriter* writer, Value* value, int depth)
+{
+    if (depth > BINARY_MAX_DEPTH)
+        return writer_fail(writer, "value is too deeply nested", NULL);
+
+    BinaryBuffer* body = &writer->body;
+
+    if (is_null(value)) {
+        buffer_append_u8(body, BIN_NULL);
+    } else if (is_bool(value)) {
+        buffer_append_u8(body, as_bool(value) ? BIN_TRUE : BIN_FALSE);
+    } else if (is_int(value)) {
+        i32 i = as_int(value);
+        buffer_append_u8(body, BIN_INT);
+        buffer_append_varint(body, ((u32) i << 1) ^ (u32) (i >> 31));
+    } else if (is_float(value)) {
+        float f = as_float(value);
+        u32 bits;
+        memcpy(&bits, &f, 4);
+        buffer_append_u8(body, BIN_FLOAT);
+        buffer_append_u32(body, bits);
+    } else if (is_string(value)) {
+        u32 length = string_length(value);
+        buffer_append_u8(body, BIN_STRING);
+        buffer_append_varint(body, length);
+        buffer_append(body, as_cstring(value), length);
+    } else if (is_symbol(value)) {
+        const char* str = symbol_as_string(value);
+        u32 index = writer_name_index(writer, value, str, (int) strlen(str));
+        buffer_append_u8(body, BIN_SYMBOL);
+        buffer_append_varint(body, index);
+    } else if (is_blob(value)) {
+        u32 size = blob_size(value);
+        buffer_append_u8(body, BIN_BLOB);
+        buffer_append_varint(body, size);
+        buffer_append(body, blob_data_flat(value), size);
+    } else if (is_hashtable(value)) {
+        buffer_append_u8(body, BIN_TABLE);
+        buffer_append_varint(body, hashtable_count(value));
+
+        u32 sizeOffset = body->size;
+        buffer_append_u32(body, 0);
+
+        for (HashtableIterator it(value); it && !writer->failed; ++it) {
+            encode_value(writer, it.key(), depth + 1);
+            encode_value(writer, it.value(), depth + 1);
+        }
+
+        write_u32_at(body->data + sizeOffset, body->size - sizeOffset - 4);
+    } else if (is_struct(value) && string_length(&value->value_type->name) > 0) {
+        Value* name = &value->value_type->name;
+        u32 index = writer_name_index(writer, name, as_cstring(name), string_length(name));
+        buffer_append_u8(body, BIN_STRUCT);
+        buffer_append_varint(body, index);
+        encode_elements(writer, value, depth);
+    } else if (is_list_based(value) && !is_func(value)) {
+        buffer_append_u8(body, BIN_LIST);
+        encode_elements(writer, value, depth);
+    } else {
+        writer_fail(writer, "can't encode a value of type ", value);
+    }
+}
+
+bool binary_encode(Value* value, BinaryBuffer* buf, Value* errorOut)
+{
+    BinaryWriter writer;
+    binary_buffer_init(&writer.body);
+    binary_buffer_init(&writer.names);
+    writer.nameCount = 0;
+    set_hashtable(&writer.nameIndex);
+    writer.failed = false;
+
+    encode_value(&writer, value, 0);
+
+    if (!writer.failed) {
+        // The names section goes before the value, now that it's complete.
+        BinaryBuffer nameCount;
+        binary_buffer_init(&nameCount);
+        buffer_append_varint(&nameCount, writer.nameCount);
+
+        buffer_append(buf, BINARY_MAGIC, 4);
+        buffer_append_u32(buf, nameCount.size + writer.names.size);
+        buffer_append(buf, nameCount.data, nameCount.size);
+        if (writer.names.size > 0)
+            buffer_append(buf, writer.names.data, writer.names.size);
+        buffer_append(buf, writer.body.data, writer.body.size);
+
+        free(nameCount.data);
+    }
+
+    free(writer.body.data);
+    free(writer.names.data);
+
+    if (writer.failed) {
+        move(&writer.error, errorOut);
+        return false;
+    }
+    return true;
+}
+
+void binary_encode(Value* value, Value* blobOut)
+{
+    ca_assert(value != blobOut);
+
+    BinaryBuffer buf;
+    binary_buffer_init(&buf);
+    Value error;
+
+    if (binary_encode(value, &buf, &error))
+        set_blob_flat(blobOut, buf.data, buf.size);
+    else
+        set_error_string(blobOut, as_cstring(&error));
+
+    free(buf.data);
+}
+
+// -- Reading --
+
+struct BinaryReader {
+    const char* start;
+    const char* end;
+
+    // If the data is in a Blob, then decoded blobs are slices of it.
+    Value* backing;
+
+    // Names section, and the offset of each name (found on first use).
+    const char* names;
+    const char* namesEnd;
+    u32 nameCount;
+    u32* nameOffsets;
+
+    bool failed;
+    Value error;
+};
+
+static void reader_fail(BinaryReader* reader, const char* message, const char* pos)
+{
+    if (reader->failed)
+        return;
+
+    char buf[32];
+    reader->failed = true;
+    set_string(&reader->error, "binary: ");
+    string_append(&reader->error, message);
+    if (pos != NULL) {
+        sprintf(buf, " at offset %d", (int) (pos - reader->start));
+        string_append(&reader->error, buf);
+    }
+}
+
+static bool read_u8(BinaryReader* reader, const char** pos, u8* out)
+{
+    if (*pos >= reader->end) {
+        reader_fail(reader, "unexpected end of data", *pos);
+        return false;
+    }
+    *out = (u8) **pos;
+    *pos += 1;
+    return true;
+}
+
+static bool read_u32(BinaryReader* reader, const char** pos, u32* out)
+{
+    if (reader->end - *pos < 4) {
+        reader_fail(reader, "unexpected end of data", *pos);
+        return false;
+    }
+    const u8* bytes = (const u8*) *pos;
+    *out = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((u32) bytes[3] << 24);
+    *pos += 4;
+    return true;
+}
+
+static bool read_varint(BinaryReader* reader, const char** pos, u32* out)
+{
+    u32 value = 0;
+    for (int shift=0; shift < 35; shift += 7) {
+        u8 byte;
+        if (!read_u8(reader, pos, &byte))
+            return false;
+        value |= (u32) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *out = value;
+            return true;
+        }
+    }
+    reader_fail(reader, "bad varint", *pos);
+    return false;
+}
+
+// Check that 'size' more bytes are available.
+static bool read_bytes(BinaryReader* reader, const char** pos, u32 size, const char** out)
+{
+    if ((u32) (reader->end - *pos) < size) {
+        reader_fail(reader, "unexpected end of data", *pos);
+        return false;
+    }
+    *out = *pos;
+    *pos += size;
+    return true;
+}
+
+static bool reader_init(BinaryReader* reader, const char* data, u32 size, Value* backing,
+    const char** rootOut)
+{
+    reader->start = data;
+    reader->end = data + size;
+    reader->backing = backing;
+    reader->nameOffsets = NULL;
+    reader->failed = false;
+
+    const char* pos = data;
+    const char* magic;
+    if (!read_bytes(reader, &pos, 4, &magic))
+        return false;
+    if (memcmp(magic, BINARY_MAGIC, 4) != 0) {
+        reader_fail(reader, "not binary encoded data", NULL);
+        return false;
+    }
+
+    u32 namesSize;
+    if (!read_u32(reader, &pos, &namesSize)
+            || !read_bytes(reader, &pos, namesSize, &reader->names))
+        return false;
+    reader->namesEnd = pos;
+
+    const char* namesPos = reader->names;
+    if (!read_varint(reader, &namesPos, &reader->nameCount))
+        return false;
+    if (reader->nameCount > namesSize) {
+        reader_fail(reader, "bad name count", reader->names);
+        return false;
+    }
+
+    *rootOut = pos;
+    return true;
+}
+
+static void reader_cleanup(BinaryReader* reader)
+{
+    free(reader->nameOffsets);
+}
+
+static bool read_name(BinaryReader* reader, u32 index, const char** strOut, u32* lengthOut)
+{
+    if (index >= reader->nameCount) {
+        reader_fail(reader, "bad name index", NULL);
+        return false;
+    }
+
+    if (reader->nameOffsets == NULL) {
+        reader->nameOffsets = (u32*) malloc(sizeof(u32) * (reader->nameCount + 1));
+
+        const char* pos = reader->names;
+        u32 count;
+        read_varint(reader, &pos, &count);
+
+        // Names are checked against the end of the names section, not the whole data.
+        const char* end = reader->end;
+        reader->end = reader->namesEnd;
+        for (u32 i=0; i < count && !reader->failed; i++) {
+            u32 length;
+            const char* str;
+            reader->nameOffsets[i] = (u32) (pos - reader->start);
+            if (read_varint(reader, &pos, &length))
+                read_bytes(reader, &pos, length, &str);
+        }
+        reader->end = end;
+
+        if (reader->failed)
+            return false;
+    }
+
+    const char* pos = reader->start + reader->nameOffsets[index];
+    return read_varint(reader, &pos, lengthOut)
+        && read_bytes(reader, &pos, *lengthOut, strOut);
+}
+
+static Type* find_struct_type(const char* name)
+{
+    World* world = global_world();
+    if (world == NULL)
+        return NULL;
+
+    Type* type = find_type(world->builtins, name);
+    for (int i=0; type == NULL && i < list_length(&world->everyModule); i++)
+        type = find_type(as_block(list_get(&world->everyModule, i)), name);
+
+    if (type == NULL || !is_struct_type(type))
+        return NULL;
+    return type;
+}
+
+// Move 'pos' past the value that starts there.
+static bool skip_value(BinaryReader* reader, const char** pos)
+{
+    u8 tag;
+    u32 n;
+    const char* bytes;
+
+    if (!read_u8(reader, pos, &tag))
+        return false;
+
+    switch (tag) {
+    case BIN_NULL:
+    case BIN_FALSE:
+    case BIN_TRUE:
+        return true;
+    case BIN_INT:
+    case BIN_SYMBOL:
+        return read_varint(reader, pos, &n);
+    case BIN_FLOAT:
+        return read_u32(reader, pos, &n);
+    case BIN_STRING:
+    case BIN_BLOB:
+        return read_varint(reader, pos, &n) && read_bytes(reader, pos, n, &bytes);
+    case BIN_STRUCT:
+        if (!read_varint(reader, pos, &n))
+            return false;
+        // fall through
+    case BIN_LIST:
+    case BIN_TABLE: {
+        u32 count, size;
+        return read_varint(reader, pos, &count) && read_u32(reader, pos, &size)
+            && read_bytes(reader, pos, size, &bytes);
+    }
+    }
+
+    reader_fail(reader, "bad tag", *pos - 1);
+    return false;
+}
+
+// Check that a list or table's elements filled exactly the recorded contents size.
+static bool check_contents_end(BinaryReader* reader, const char* pos, const char* expected)
+{
+    if (pos != expected) {
+        reader_fail(reader, "bad contents size", pos);
+        return false;
+    }
+    return true;
+}
+
+static bool decode_value(BinaryReader* reader, const char** pos, Value* out, int depth)
+{
+    if (depth > BINARY_MAX_DEPTH) {
+        reader_fail(reader, "value is too deeply nested", *pos);
+        return false;
+    }
+
+    u8 tag;
+    u32 n;
+    if (!read_u8(reader, pos, &tag))
+        return false;
+
+    switch (tag) {
+    case BIN_NULL:
+        set_null(out);
+        return true;
+    case BIN_FALSE:
+        set_bool(out, false);
+        return true;
+    case BIN_TRUE:
+        set_bool(out, true);
+        return true;
+    case BIN_INT:
+        if (!read_varint(reader, pos, &n))
+            return false;
+        set_int(out, (int) ((n >> 1) ^ (0 - (n & 1))));
+        return true;
+    case BIN_FLOAT: {
+        if (!read_u32(reader, pos, &n))
+            return false;
+        float f;
+        memcpy(&f, &n, 4);
+        set_float(out, f);
+        return true;
+    }
+    case BIN_STRING: {
+        const char* str;
+        if (!read_varint(reader, pos, &n) || !read_bytes(reader, pos, n, &str))
+            return false;
+        set_string(out, str, n);
+        return true;
+    }
+    case BIN_SYMBOL: {
+        const char* str;
+        u32 length;
+        if (!read_varint(reader, pos, &n) || !read_name(reader, n, &str, &length))
+            return false;
+        set_symbol(out, string_to_symbol(str, length));
+        return true;
+    }
+    case BIN_BLOB: {
+        const char* data;
+        if (!read_varint(reader, pos, &n) || !read_bytes(reader, pos, n, &data))
+            return false;
+        if (reader->backing != NULL)
+            set_blob_slice(out, reader->backing, data, n);
+        else
+            set_blob_flat(out, data, n);
+        return true;
+    }
+    case BIN_LIST:
+    case BIN_STRUCT: {
+        Type* type = NULL;
+
+        if (tag == BIN_STRUCT) {
+            const char* str;
+            u32 length;
+            if (!read_varint(reader, pos, &n) || !read_name(reader, n, &str, &length))
+                return false;
+            Value name;
+            set_string(&name, str, length);
+            type = find_struct_type(as_cstring(&name));
+        }
+
+        u32 count, size;
+        const char* contents;
+        if (!read_varint(reader, pos, &count) || !read_u32(reader, pos, &size)
+                || !read_bytes(reader, pos, size, &contents))
+            return false;
+
+        // Each element takes at least one byte.
+        if (count > size) {
+            reader_fail(reader, "bad element count", contents);
+            return false;
+        }
+
+        if (type != NULL && compound_type_get_field_count(type) == (int) count)
+            make(type, out);
+        else
+            set_list(out, count);
+
+        const char* element = contents;
+        for (u32 i=0; i < count; i++)
+            if (!decode_value(reader, &element, list_get(out, i), depth + 1))
+                return false;
+        return check_contents_end(reader, element, contents + size);
+    }
+    case BIN_TABLE: {
+        u32 count, size;
+        const char* contents;
+        if (!read_varint(reader, pos, &count) || !read_u32(reader, pos, &size)
+                || !read_bytes(reader, pos, size, &contents))
+            return false;
+
+        if (count > size) {
+            reader_fail(reader, "bad element count", contents);
+            return false;
+        }
+
+        set_hashtable(out);
+        const char* element = contents;
+        for (u32 i=0; i < count; i++) {
+            Value key;
+            if (!decode_value(reader, &element, &key, depth + 1)
+                    || !decode_value(reader, &element,
+                        hashtable_insert(out, &key, true), depth + 1))
+                return false;
+        }
+        return check_contents_end(reader, element, contents + size);
+    }
+    }
+
+    reader_fail(reader, "bad tag", *pos - 1);
+    return false;
+}
+
+// Check whether the table key at 'pos' equals 'key', and move past it.
+static bool match_key(BinaryReader* reader, const char** pos, Value* key, bool* matchOut)
+{
+    // String keys are compared in place.
+    if (is_string(key) && *pos < reader->end && **pos == BIN_STRING) {
+        const char* keyPos = *pos + 1;
+        const char* str;
+        u32 length;
+        if (!read_varint(reader, &keyPos, &length) || !read_bytes(reader, &keyPos, length, &str))
+            return false;
+        *matchOut = length == (u32) string_length(key)
+            && memcmp(str, as_cstring(key), length) == 0;
+        *pos = keyPos;
+        return true;
+    }
+
+    Value decoded;
+    if (!decode_value(reader, pos, &decoded, 0))
+        return false;
+    *matchOut = equals(&decoded, key);
+    return true;
+}
+
+// Move 'pos' from a list, struct or table to one of its elements.
+static bool seek_element(BinaryReader* reader, const char** pos, Value* key)
+{
+    const char* start = *pos;
+    u8 tag;
+    u32 n;
+    if (!read_u8(reader, pos, &tag))
+        return false;
+
+    if (tag == BIN_STRUCT && !read_varint(reader, pos, &n))
+        return false;
+
+    if (tag != BIN_LIST && tag != BIN_STRUCT && tag != BIN_TABLE) {
+        reader_fail(reader, "path goes into a value that isn't a list or table", start);
+        return false;
+    }
+
+    u32 count, size;
+    if (!read_varint(reader, pos, &count) || !read_u32(reader, pos, &size))
+        return false;
+
+    if (tag == BIN_TABLE) {
+        for (u32 i=0; i < count; i++) {
+            bool match;
+            if (!match_key(reader, pos, key, &match))
+                return false;
+            if (match)
+                return true;
+            if (!skip_value(reader, pos))
+                return false;
+        }
+        reader_fail(reader, "key not found", start);
+        return false;
+    }
+
+    if (!is_int(key) || as_int(key) < 0 || (u32) as_int(key) >= count) {
+        reader_fail(reader, "index out of range", start);
+        return false;
+    }
+
+    for (int i=0; i < as_int(key); i++)
+        if (!skip_value(reader, pos))
+            return false;
+    return true;
+}
+
+static bool seek_path(BinaryReader* reader, const char** pos, Value* path)
+{
+    for (int i=0; i < list_length(path); i++)
+        if (!seek_element(reader, pos, list_get(path, i)))
+            return false;
+    return true;
+}
+
+static bool binary_decode_from(const char* data, u32 size, Value* backing, Value* path,
+    Value* out)
+{
+    BinaryReader reader;
+    const char* pos;
+
+    if (reader_init(&reader, data, size, backing, &pos)
+            && (path == NULL || seek_path(&reader, &pos, path))
+            && decode_value(&reader, &pos, out, 0)
+            && path == NULL && pos != reader.end)
+        reader_fail(&reader, "unexpected data after value", pos);
+
+    reader_cleanup(&reader);
+
+    if (reader.failed) {
+        set_error_string(out, as_cstring(&reader.error));
+        return false;
+    }
+    return true;
+}
+
+bool binary_decode(const char* data, u32 size, Value* out)
+{
+    return binary_decode_from(data, size, NULL, NULL, out);
+}
+
+bool binary_get(const char* data, u32 size, Value* path, Value* out)
+{
+    return binary_decode_from(data, size, NULL, path, out);
+}
+
+int binary_length(const char* data, u32 size, Value* path)
+{
+    BinaryReader reader;
+    const char* pos;
+    int result = -1;
+
+    if (reader_init(&reader, data, size, NULL, &pos) && seek_path(&reader, &pos, path)) {
+        u8 tag;
+        u32 n;
+        if (read_u8(&reader, &pos, &tag)) {
+            if (tag == BIN_STRUCT && !read_varint(&reader, &pos, &n))
+                tag = BIN_NULL;
+            if (tag == BIN_LIST || tag == BIN_STRUCT || tag == BIN_TABLE
+                    || tag == BIN_STRING || tag == BIN_BLOB) {
+                if (read_varint(&reader, &pos, &n))
+                    result = (int) n;
+            }
+        }
+    }
+
+    reader_cleanup(&reader);
+    return result;
+}
+
+// -- Builtins --
+
+void to_binary(VM* vm)
+{
+    binary_encode(vm->input(0), vm->output());
+    if (is_error(vm->output()))
+        vm->throw_str(as_cstring(vm->output()));
+}
+
+void from_binary(VM* vm)
+{
+    Value* blob = vm->input(0);
+    if (!binary_decode_from(blob_data_flat(blob), blob_size(blob), blob, NULL, vm->output()))
+        vm->throw_str(as_cstring(vm->output()));
+}
+
+void binary_get(VM* vm)
+{
+    Value* blob = vm->input(0);
+    if (!binary_decode_from(blob_data_flat(blob), blob_size(blob), blob, vm->input(1),
+            vm->output()))
+        vm->throw_str(as_cstring(vm->output()));
+}
+
+void binary_length(VM* vm)
+{
+    Value* blob = vm->input(0);
+    set_int(vm->output(), binary_length(blob_data_flat(blob), blob_size(blob), vm->input(1)));
+}
+
+void binary_repr_install_functions(NativePatch* patch)
+{
+    circa_patch_function(patch, "to_binary", to_binary);
+    circa_patch_function(patch, "from_binary", from_binary);
+    circa_patch_function(patch, "binary_get", binary_get);
+    circa_patch_function(patch, "binary_length", binary_length);
+}
+
+} // namespace circa
+
+using namespace circa;
+
+CIRCA_EXPORT void circa_to_binary(caValue* value, caValue* blobOut)
+{
+    binary_encode(value, blobOut);
+}
+
+CIRCA_EXPORT void circa_from_binary(const char* data, int len, caValue* out)
+{
+    binary_decode(data, len, out);
+}
+
+CIRCA_EXPORT void circa_binary_get(const char* data, int len, caValue* path, caValue* out)
+{
+    binary_get(data, len, path, out);
+}
+
+CIRCA_EXPORT int circa_binary_length(const char* data, int len, caValue* path)
+{
+    return binary_length(data, len, path);
+}
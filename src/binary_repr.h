@@ -0,0 +1,39 @@
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+#pragma once
+
+namespace circa {
+
+// Growable output buffer for binary_encode. The data is malloc'd, and owned by whoever
+// holds the buffer.
+struct BinaryBuffer {
+    char* data;
+    u32 size;
+    u32 capacity;
+};
+
+void binary_buffer_init(BinaryBuffer* buf);
+
+// Append the encoding of 'value' to 'buf'. Returns false (and writes a message to
+// 'errorOut') if the value contains something with no binary form, such as a function.
+bool binary_encode(Value* value, BinaryBuffer* buf, Value* errorOut);
+
+// Encode 'value' as a Blob. On failure, 'blobOut' is an error value.
+void binary_encode(Value* value, Value* blobOut);
+
+// Decode a whole value. If the data is malformed, 'out' is an error value and this
+// returns false.
+bool binary_decode(const char* data, u32 size, Value* out);
+
+// Decode the value found by following 'path' (a list of list indexes and table keys),
+// without decoding anything else. If the data is malformed or the path isn't found,
+// 'out' is an error value and this returns false.
+bool binary_get(const char* data, u32 size, Value* path, Value* out);
+
+// Number of elements (or bytes, for strings and blobs) of the value at 'path'. Returns
+// -1 if the path isn't found or the value doesn't have a length.
+int binary_length(const char* data, u32 size, Value* path);
+
+void binary_repr_install_functions(NativePatch* patch);
+
+} // namespace circa
@@ -110,7 +110,8 @@ Flat* blob_resize(AbstractBlob* abstract, u32 newSize)
 
     case BLOB_SLICE: {
         Slice* slice = (Slice*) abstract;
-        Flat* flat = alloc_flat_and_fill(newSize, slice->data, slice->header.size);
+        Flat* flat = alloc_flat_and_fill(newSize, slice->data,
+            std::min(newSize, slice->header.size));
         decref(abstract);
         return flat;
     }
@@ -123,7 +124,7 @@ Flat* blob_resize(AbstractBlob* abstract, u32 newSize)
             return flat;
         }
 
-        flat = alloc_flat_and_fill(newSize, flat->data, flat->header.size);
+        flat = alloc_flat_and_fill(newSize, flat->data, std::min(newSize, flat->header.size));
         decref(abstract);
         return flat;
     }
@@ -328,6 +329,15 @@ void blob_slice(Value* blob, int start, int end, Value* sliceOut)
 
     AbstractBlob* abstract = (AbstractBlob*) blob->value_data.ptr;
 
+    if (abstract->type == BLOB_SLICE) {
+        // Slice of a slice: reference the original backing value directly.
+        Slice* slice = (Slice*) abstract;
+        Value backing;
+        copy(&slice->backingValue, &backing);
+        set_blob_slice(sliceOut, &backing, slice->data + start, end - start);
+        return;
+    }
+
     if (abstract->type != BLOB_FLAT)
         internal_error("blob_slice: unimplemented");
 
@@ -825,15 +825,80 @@ void block_set_evaluation_empty(Block* block, bool empty)
     else
         block_remove_property(block, s_EvaluationEmpty);
 }
-bool block_has_effects(Block* block)
+
+// Search for effects with Tarjan's strongly connected components algorithm, so each block
+// is searched once even with mutual recursion. While a block is being searched, its
+// :HasEffects is its position in 'stack'.
+//
+// Returns :yes or :no, or :maybe if the answer depends on a block that's still being
+// searched further up (a recursive call). In that case 'low' is lowered to the position
+// of that block, and this block stays on the stack until the answer is known.
+static Symbol block_has_effects_search(Block* block, Value* stack, int* low)
 {
     Value* prop = block_get_property(block, s_HasEffects);
 
-    if (prop == NULL)
-        return false;
+    if (prop != NULL) {
+        if (is_int(prop)) {
+            *low = std::min(*low, as_int(prop));
+            return s_maybe;
+        }
+        return as_bool(prop) ? s_yes : s_no;
+    }
 
-    return as_bool(prop);
+    if (block_get_bool_prop(block, s_effect, false)) {
+        set_bool(block_insert_property(block, s_HasEffects), true);
+        return s_yes;
+    }
+
+    int position = list_length(stack);
+    set_int(block_insert_property(block, s_HasEffects), position);
+    set_block(list_append(stack), block);
+
+    bool hasEffects = false;
+    int blockLow = position;
+
+    for (int i=0; i < block->length(); i++) {
+        Term* term = block->get(i);
+        if (term == NULL)
+            continue;
+
+        Block* contents = static_dispatch_block(term);
+        if (contents == NULL || contents == block)
+            continue;
+
+        Symbol result = block_has_effects_search(contents, stack, &blockLow);
+        if (result == s_yes) {
+            hasEffects = true;
+            break;
+        }
+    }
+
+    if (!hasEffects && blockLow < position) {
+        *low = std::min(*low, blockLow);
+        return s_maybe;
+    }
+
+    // The answer is known for this block and every block still on the stack above it.
+    // Those all call back into this block (or into a block further down the stack, which
+    // calls this one), so they have effects if this one does.
+    for (int i=position; i < list_length(stack); i++)
+        set_bool(block_insert_property(as_block(stack->index(i)), s_HasEffects), hasEffects);
+    list_resize(stack, position);
+
+    return hasEffects ? s_yes : s_no;
+}
+
+bool block_has_effects(Block* block)
+{
+    // A block has effects if it's annotated with :effect, or if anything that it
+    // statically calls has effects. The result is cached in :HasEffects.
+
+    Value stack;
+    set_list(&stack, 0);
+    int low = 0;
+    return block_has_effects_search(block, &stack, &low) == s_yes;
 }
+
 void block_set_has_effects(Block* block, bool hasEffects)
 {
     if (hasEffects)
@@ -70,7 +70,10 @@ Term* apply(Block* block, Term* function, TermList const& inputs, Value* name)
     // update term->function, change_function will also update the declared type.
     change_function(term, function);
 
-    update_unique_name(term);
+    // A named term already got its unique name from rename(). Otherwise the unique name
+    // is based on the function name.
+    if (has_empty_name(term))
+        update_unique_name(term);
 
     // Post-compile steps
 
@@ -224,23 +227,31 @@ void rename(Term* termToRename, Value* name)
             termToRename->owningBlock->names.remove(termToRename->name());
             set_null(&termToRename->nameValue);
         }
+        // bindName also updates the unique name.
         termToRename->owningBlock->bindName(termToRename, name);
+    } else {
+        copy(name, &termToRename->nameValue);
+        update_unique_name(termToRename);
     }
 
-    copy(name, &termToRename->nameValue);
-    update_unique_name(termToRename);
-
     // Update unique ordinal. If any neighbor term has the same name, then give this
     // term a greater ordinal value.
     termToRename->uniqueOrdinal = 0;
 
     if (block != NULL) {
+        // For a named term, uniqueName.base is a copy of the name, so neighbors with a
+        // different base hash can't have the same name.
+        bool checkHash = !has_empty_name(termToRename);
+        u32 nameHash = termToRename->uniqueName.baseHash;
+
         for (int i=0; i < block->length(); i++) {
             Term* neighbor = block->get(i);
             if (neighbor == termToRename)
                 continue;
             if (neighbor == NULL)
                 continue;
+            if (checkHash && neighbor->uniqueName.baseHash != nameHash)
+                continue;
 
             if (equals(&neighbor->nameValue, name)) {
                 // Check if the neighbor has ordinal value 0 (meaning no name collision).
@@ -5,6 +5,7 @@
 #include "building.h"
 #include "bytecode.h"
 #include "closures.h"
+#include "code_iterators.h"
 #include "debug.h"
 #include "hashtable.h"
 #include "inspection.h"
@@ -22,6 +23,8 @@
 #include "vm.h"
 
 #define DUMP_COMPILED_BYTECODE 0
+#define INLINE_MAX_TERMS       8
+#define INLINE_MAX_DEPTH       3
 #define TRACE_OPTIMIZATIONS    0
 #define TRACE_SLOT_COMPACTION  0
 
@@ -98,6 +101,8 @@ Bytecode* new_bytecode(VM* vm)
     bc->metadataSize = 0;
     bc->slotCount = 0;
     bc->nextFreeSlot = 0;
+    initialize_null(&bc->specialization);
+    initialize_null(&bc->assumedTypes);
     bc->consts.init();
     bc->opCount = 0;
     bc->ops = NULL;
@@ -111,6 +116,8 @@ void free_bytecode(Bytecode* bc)
         return;
     bc->consts.clear();
     set_null(&bc->unresolved);
+    set_null(&bc->specialization);
+    set_null(&bc->assumedTypes);
     free(bc->ops);
     free(bc->metadata);
 }
@@ -390,8 +397,16 @@ bool load_term_static(Bytecode* bc, Term* term, int slot)
     }
 
     if (has_static_value(term)) {
+        Value* value = term_value(term);
+
+        if (is_int(value) && as_int(value) >= 0 && as_int(value) <= 0xffff) {
+            // Small int, fits in the op.
+            append_op(bc, op_load_i, slot, as_int(value));
+            return true;
+        }
+
         int constIndex;
-        copy(term_value(term), append_const(bc, &constIndex));
+        copy(value, append_const(bc, &constIndex));
         append_op(bc, op_load_const, slot, constIndex);
         //set_term_live(bc, term, slot);
         return true;
@@ -584,15 +599,81 @@ static bool type_is_int_or_float(Type* type)
     return type == TYPES.float_type || type == TYPES.int_type;
 }
 
+Type* static_type(Bytecode* bc, Term* term)
+{
+    if (!is_null(&bc->assumedTypes)) {
+        Value key;
+        set_term_ref(&key, term);
+        Value* found = bc->assumedTypes.val_key(&key);
+        if (found != NULL)
+            return as_type(found);
+    }
+
+    return declared_type(term);
+}
+
+void assume_type(Bytecode* bc, Term* term, Type* type)
+{
+    if (is_null(&bc->assumedTypes) || type == NULL || declared_type(term) == type)
+        return;
+
+    Value key;
+    set_term_ref(&key, term);
+    set_type(bc->assumedTypes.insert_val(&key), type);
+}
+
+static bool type_maybe_number(Type* type)
+{
+    return type_is_int_or_float(type) || type == TYPES.any;
+}
+
+static u8 float_opcode_for_function(Term* function)
+{
+    if (function == FUNCS.add || function == FUNCS.add_f)
+        return op_add_f;
+    if (function == FUNCS.sub || function == FUNCS.sub_f)
+        return op_sub_f;
+    if (function == FUNCS.mult)
+        return op_mult_f;
+    if (function == FUNCS.div || function == FUNCS.div_f)
+        return op_div_f;
+    if (function == FUNCS.less_than)
+        return op_lt_f;
+    if (function == FUNCS.less_than_eq)
+        return op_lte_f;
+    if (function == FUNCS.greater_than)
+        return op_gt_f;
+    if (function == FUNCS.greater_than_eq)
+        return op_gte_f;
+    return 0;
+}
+
+void write_guarded_float_op(Bytecode* bc, Term* term, u8 opcode)
+{
+    // The float op is only a guess based on the declared types. It's followed by the
+    // generic call, with the inputs already in place. If the guess was right then the
+    // float op writes the result and skips over the call. Otherwise the call runs.
+
+    Block* function = term->function->nestedContents;
+    int top = reserve_new_frame_slots(bc, 2);
+    append_op(bc, op_precall, top, 2);
+    load_input_term(bc, term, term->input(0), top+1);
+    load_input_term(bc, term, term->input(1), top+2);
+    append_op(bc, opcode, top, top+1, top+2);
+    call(bc, top, 2, function);
+    set_term_live(bc, term, top);
+}
+
 bool use_inline_bytecode(Bytecode* bc, Term* term)
 {
     if (term->numInputs() != 2)
         return false;
 
-    Type* leftType = declared_type(term->input(0));
-    Type* rightType = declared_type(term->input(1));
+    Type* leftType = static_type(bc, term->input(0));
+    Type* rightType = static_type(bc, term->input(1));
     bool bothInts = leftType == TYPES.int_type && rightType == TYPES.int_type;
-    bool bothFloaty = type_is_int_or_float(leftType) && type_is_int_or_float(rightType);
+    bool maybeFloats = (leftType == TYPES.float_type || rightType == TYPES.float_type)
+        && type_maybe_number(leftType) && type_maybe_number(rightType);
 
     u8 opcode = 0;
 
@@ -603,6 +684,14 @@ bool use_inline_bytecode(Bytecode* bc, Term* term)
             opcode = op_sub_i;
         if (term->function == FUNCS.mult)
             opcode = op_mult_i;
+        if (term->function == FUNCS.less_than)
+            opcode = op_lt_i;
+        if (term->function == FUNCS.less_than_eq)
+            opcode = op_lte_i;
+        if (term->function == FUNCS.greater_than)
+            opcode = op_gt_i;
+        if (term->function == FUNCS.greater_than_eq)
+            opcode = op_gte_i;
 
     } else if (term->function == FUNCS.add_i) {
         opcode = op_add_i;
@@ -614,6 +703,20 @@ bool use_inline_bytecode(Bytecode* bc, Term* term)
         opcode = op_div_i;
     }
 
+    if (opcode == 0 && maybeFloats) {
+        opcode = float_opcode_for_function(term->function);
+        if (opcode != 0) {
+            write_guarded_float_op(bc, term, opcode);
+
+            // Both inputs are known numbers, so the guard always passes.
+            bool arithmetic = opcode == op_add_f || opcode == op_sub_f
+                || opcode == op_mult_f || opcode == op_div_f;
+            if (arithmetic && type_is_int_or_float(leftType) && type_is_int_or_float(rightType))
+                assume_type(bc, term, TYPES.float_type);
+            return true;
+        }
+    }
+
     if (opcode == 0)
         return false;
 
@@ -623,6 +726,9 @@ bool use_inline_bytecode(Bytecode* bc, Term* term)
 
     append_op(bc, opcode, top, top+1, top+2);
     set_term_live(bc, term, top);
+
+    if (opcode == op_add_i || opcode == op_sub_i || opcode == op_mult_i || opcode == op_div_i)
+        assume_type(bc, term, TYPES.int_type);
     return true;
 }
 
@@ -641,11 +747,16 @@ void dynamic_method(Bytecode* bc, Term* term)
     comment(bc, &msg);
 #endif
 
+    // The const holds [[name, location], cacheVersion, cacheEntries]. The cache is filled
+    // in by the VM (see op_dyn_method).
     int constIndex;
-    Value* nameLocation = append_const(bc, &constIndex);
-    nameLocation->set_list(2);
+    Value* methodSite = append_const(bc, &constIndex);
+    methodSite->set_list(3);
+    Value* nameLocation = methodSite->index(0)->set_list(2);
     nameLocation->index(0)->set(term->getProp(s_method_name));
     nameLocation->index(1)->set_term(term);
+    methodSite->index(1)->set_int(0);
+    methodSite->index(2)->set_list(0);
 
     int inputCount = term->numInputs();
     int top = reserve_new_frame_slots(bc, inputCount);
@@ -993,6 +1104,154 @@ int count_expected_num_inputs(Block* block)
     return count;
 }
 
+bool is_being_compiled(Bytecode* bc, Block* block, int* inlineDepth)
+{
+    // Check if 'block' is the major block being compiled, or if a call to it is currently
+    // being inlined. Also counts how many inlined calls we're inside of.
+
+    *inlineDepth = 0;
+
+    int maddr = find_active_inline_start(bc, bc->metadataSize - 1);
+    while (maddr != -1) {
+        if (bc->metadata[maddr].block == block)
+            return true;
+        (*inlineDepth)++;
+        maddr = find_active_inline_start(bc, maddr - 1);
+    }
+
+    int majorBlockStart = mop_find_active_mopcode(bc, mop_major_block_start, -1);
+    return majorBlockStart != -1 && bc->metadata[majorBlockStart].block == block;
+}
+
+bool can_inline_term(Term* term)
+{
+    if (term_needs_no_evaluation(term))
+        return true;
+
+    // Control flow, closures and state need a real frame.
+    if (term->nestedContents != NULL
+            || !is_function(term->function)
+            || term->function == FUNCS.return_func
+            || term->function == FUNCS.break_func
+            || term->function == FUNCS.continue_func
+            || term->function == FUNCS.discard
+            || term->function == FUNCS.declared_state
+            || term->function == FUNCS.func_call
+            || term->function == FUNCS.func_call_method
+            || term->function == FUNCS.func_apply
+            || term->function == FUNCS.func_apply_method
+            || term->function == FUNCS.upvalue
+            || term->function == FUNCS.unknown_function_prelude)
+        return false;
+
+    return true;
+}
+
+bool should_inline_call(Bytecode* bc, Term* term, Block* function)
+{
+    if (find_native_func_index(function->world, function) != -1
+            || has_variable_args(function)
+            || count_closure_upvalues(function) != 0
+            || count_output_placeholders(function) != 1
+            || term->numInputs() != count_input_placeholders(function)
+            || block_has_state(function) == s_yes)
+        return false;
+
+    // A callee that might have state through dynamic dispatch is still fine, since it
+    // doesn't push its own state frame. Its calls are keyed by the same terms either way.
+
+    int evaluatedTerms = 0;
+    for (int i=0; i < function->length(); i++) {
+        Term* calleeTerm = function->get(i);
+        if (!can_inline_term(calleeTerm))
+            return false;
+        if (!term_needs_no_evaluation(calleeTerm))
+            evaluatedTerms++;
+    }
+
+    if (evaluatedTerms > INLINE_MAX_TERMS)
+        return false;
+
+    int inlineDepth;
+    if (is_being_compiled(bc, function, &inlineDepth))
+        return false;
+
+    return inlineDepth < INLINE_MAX_DEPTH;
+}
+
+void forget_assumed_types(Bytecode* bc, Block* block)
+{
+    for (int i=0; i < block->length(); i++) {
+        Value key;
+        set_term_ref(&key, block->get(i));
+        hashtable_remove(&bc->assumedTypes, &key);
+    }
+}
+
+void write_inlined_call(Bytecode* bc, Term* term, Block* function)
+{
+    // Write the callee's terms directly into this block. The callee's input placeholders
+    // are made live in new slots, so its terms can find them like they normally would.
+
+#if DEBUG
+    Value commentStr;
+    commentStr.set_string("inlined call to: ");
+    string_append(&commentStr, term_name(term->function));
+    comment(bc, &commentStr);
+#endif
+
+    stat_increment(Bytecode_InlineCall);
+
+    int inputCount = term->numInputs();
+    int firstInput = reserve_slots(bc, inputCount);
+
+    for (int i=0; i < inputCount; i++)
+        load_input_term(bc, term, term->input(i), firstInput + i);
+
+    int inlineStartMaddr = bc->metadataSize;
+    append_metadata(bc, mop_inline_start, 0)->block = function;
+
+    for (int i=0; i < inputCount; i++) {
+        Term* placeholder = get_input_placeholder(function, i);
+        int slot = firstInput + i;
+        set_term_live(bc, placeholder, slot);
+
+        Type* declaredType = declared_type(placeholder);
+        if (declaredType != TYPES.any)
+            cast_fixed_type(bc, slot, declaredType);
+        else
+            assume_type(bc, placeholder, static_type(bc, term->input(i)));
+    }
+
+    for (int i=0; i < function->length(); i++) {
+        Term* calleeTerm = function->get(i);
+        if (!is_input_placeholder(calleeTerm))
+            write_term(bc, calleeTerm);
+    }
+
+    Term* output = get_output_placeholder(function, 0);
+    Term* result = output->input(0);
+    int outputSlot = reserve_slots(bc, 1);
+
+    if (result == NULL) {
+        append_op(bc, op_set_null, outputSlot);
+    } else {
+        load_term(bc, result, outputSlot, false);
+
+        if (declared_type(output) != TYPES.any) {
+            if (declared_type(output) != static_type(bc, result))
+                cast_fixed_type(bc, outputSlot, declared_type(output));
+        } else {
+            assume_type(bc, term, static_type(bc, result));
+        }
+    }
+
+    append_metadata(bc, mop_inline_end, 0)->related_maddr = inlineStartMaddr;
+
+    forget_assumed_types(bc, function);
+    set_term_live(bc, term, outputSlot);
+}
+
 void write_normal_call(Bytecode* bc, Term* term, Block* function)
 {
 #if DEBUG
@@ -1015,6 +1274,11 @@ void write_normal_call(Bytecode* bc, Term* term, Block* function)
     maybe_write_not_enough_inputs_error(bc, function, inputCount);
     maybe_write_too_many_inputs_error(bc, function, inputCount);
 
+    if (should_inline_call(bc, term, function)) {
+        write_inlined_call(bc, term, function);
+        return;
+    }
+
     int minimumInputCount = minimum_input_count_for_call(function);
 
     if (inputCount < minimumInputCount)
@@ -1492,6 +1756,12 @@ void handle_function_inputs(Bytecode* bc, Block* block)
         set_term_live(bc, placeholder, 1 + i);
     }
 
+    if (!is_null(&bc->specialization)) {
+        int constIndex;
+        copy(&bc->specialization, append_const(bc, &constIndex));
+        append_op(bc, op_guard_types, 1, list_length(&bc->specialization) - 1, constIndex);
+    }
+
     for (int i=0;; i++) {
         Term* placeholder = get_input_placeholder(block, i);
         if (placeholder == NULL)
@@ -1636,8 +1906,31 @@ int op_flags(int opcode)
     case op_sub_i:
     case op_mult_i:
     case op_div_i:
+    case op_lt_i:
+    case op_lte_i:
+    case op_gt_i:
+    case op_gte_i:
     case op_make_func:
         return OP_WRITES_SLOT_A | OP_READS_SLOT_B | OP_READS_SLOT_C;
+    case op_add_f:
+    case op_sub_f:
+    case op_mult_f:
+    case op_div_f:
+    case op_lt_f:
+    case op_lte_f:
+    case op_gt_f:
+    case op_gte_f:
+        return OP_WRITES_SLOT_A | OP_READS_SLOT_B | OP_READS_SLOT_C;
+    case op_add_i_imm:
+    case op_sub_i_imm:
+        return OP_WRITES_SLOT_A | OP_READS_SLOT_B;
+    case op_uncompiled_copy_call:
+    case op_uncompiled_move_call:
+    case op_copy_call:
+    case op_move_call:
+        return OP_READS_SLOT_B | OP_WRITES_SLOT_A | OP_PUSHES_FRAME;
+    case op_guard_types:
+        return 0;
     case op_push_state_frame:
         return 0;
     case op_push_state_frame_dkey:
@@ -1684,6 +1977,184 @@ void perform_move_optimization(Bytecode* bc)
 #endif
 }
 
+bool op_is_jump(int opcode)
+{
+    switch (opcode) {
+    case op_jump:
+    case op_jif:
+    case op_jnif:
+    case op_jeq:
+    case op_jneq:
+    case op_jgt:
+    case op_jgte:
+    case op_jlt:
+    case op_jlte:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool* find_jump_targets(Bytecode* bc)
+{
+    bool* isJumpTarget = (bool*) malloc(sizeof(bool) * (bc->opCount + 1));
+    memset(isJumpTarget, 0, sizeof(bool) * (bc->opCount + 1));
+
+    for (int pc=0; pc < bc->opCount; pc++) {
+        Op* op = &bc->ops[pc];
+        if (op_is_jump(op->opcode) && op->c <= bc->opCount)
+            isJumpTarget[op->c] = true;
+    }
+    return isJumpTarget;
+}
+
+int fusion_find_previous_op(Bytecode* bc, bool* isJumpTarget, int pc)
+{
+    // Find the closest op before 'pc' that actually does something. Returns -1 if there
+    // isn't one, or if we would step over a jump target (so the two ops might not always
+    // run in sequence).
+
+    while (true) {
+        if (isJumpTarget[pc])
+            return -1;
+        pc--;
+        if (pc < 0)
+            return -1;
+
+        int opcode = bc->ops[pc].opcode;
+        if (opcode != op_comment && opcode != op_nope)
+            return pc;
+    }
+}
+
+void fuse_load_i_into_arithmetic(Bytecode* bc, bool* isJumpTarget, int pc)
+{
+    // load_i rX value; add_i dest left rX  ->  add_i_imm dest left value
+    //
+    // The constant may have been loaded by either of the two preceding ops, since the
+    // left and right inputs are loaded in order.
+
+    Op* arith = &bc->ops[pc];
+    int searchPc = pc;
+
+    for (int step=0; step < 2; step++) {
+        searchPc = fusion_find_previous_op(bc, isJumpTarget, searchPc);
+        if (searchPc == -1)
+            return;
+
+        Op* load = &bc->ops[searchPc];
+        if (load->opcode != op_load_i)
+            continue;
+
+        Liveness* liveness = get_liveness(bc, load->a);
+        if (liveness->writePc != searchPc || liveness->lastReadPc != pc)
+            continue;
+
+        if (arith->b == arith->c)
+            return;
+
+        if (load->a == arith->c) {
+            arith->c = load->b;
+        } else if (load->a == arith->b && arith->opcode == op_add_i) {
+            arith->b = arith->c;
+            arith->c = load->b;
+        } else {
+            continue;
+        }
+
+        arith->opcode = arith->opcode == op_add_i ? op_add_i_imm : op_sub_i_imm;
+        load->opcode = op_nope;
+        return;
+    }
+}
+
+int compare_jump_opcode(int compareOpcode, bool jumpIfTrue)
+{
+    switch (compareOpcode) {
+    case op_lt_i: return jumpIfTrue ? op_jlt : op_jgte;
+    case op_lte_i: return jumpIfTrue ? op_jlte : op_jgt;
+    case op_gt_i: return jumpIfTrue ? op_jgt : op_jlte;
+    case op_gte_i: return jumpIfTrue ? op_jgte : op_jlt;
+    }
+    return 0;
+}
+
+void fuse_compare_into_jump(Bytecode* bc, bool* isJumpTarget, int pc)
+{
+    // lt_i rX left right; jif rX addr  ->  jlt left right addr
+    //
+    // There might be a move or copy of the comparison result in between (conditions are
+    // loaded into their own slot).
+
+    Op* jump = &bc->ops[pc];
+    int conditionSlot = jump->a;
+    int readerPc = pc;
+
+    int prevPc = fusion_find_previous_op(bc, isJumpTarget, pc);
+    if (prevPc == -1)
+        return;
+
+    Op* prev = &bc->ops[prevPc];
+    Op* transfer = NULL;
+
+    if ((prev->opcode == op_move || prev->opcode == op_copy) && prev->a == conditionSlot) {
+        if (get_liveness(bc, conditionSlot)->lastReadPc != pc)
+            return;
+
+        transfer = prev;
+        conditionSlot = prev->b;
+        readerPc = prevPc;
+
+        prevPc = fusion_find_previous_op(bc, isJumpTarget, prevPc);
+        if (prevPc == -1)
+            return;
+        prev = &bc->ops[prevPc];
+    }
+
+    int opcode = compare_jump_opcode(prev->opcode, jump->opcode == op_jif);
+    if (opcode == 0 || prev->a != conditionSlot)
+        return;
+
+    Liveness* liveness = get_liveness(bc, conditionSlot);
+    if (liveness->writePc != prevPc || liveness->lastReadPc != readerPc)
+        return;
+
+    // The comparison inputs are now read at the jump.
+    get_liveness(bc, prev->b)->lastReadPc = pc;
+    get_liveness(bc, prev->c)->lastReadPc = pc;
+
+    jump->opcode = opcode;
+    jump->a = prev->b;
+    jump->b = prev->c;
+    prev->opcode = op_nope;
+    if (transfer != NULL)
+        transfer->opcode = op_nope;
+}
+
+void perform_superinstruction_fusion(Bytecode* bc)
+{
+    // Fuse common sequences of ops into single ops. This runs while the bytecode is
+    // still in SSA form, so that liveness can tell us when an intermediate slot has no
+    // other readers.
+
+    bool* isJumpTarget = find_jump_targets(bc);
+
+    for (int pc=0; pc < bc->opCount; pc++) {
+        switch (bc->ops[pc].opcode) {
+        case op_add_i:
+        case op_sub_i:
+            fuse_load_i_into_arithmetic(bc, isJumpTarget, pc);
+            break;
+        case op_jif:
+        case op_jnif:
+            fuse_compare_into_jump(bc, isJumpTarget, pc);
+            break;
+        }
+    }
+
+    free(isJumpTarget);
+}
+
 struct SlotCompaction {
 
     Bytecode* bc;
@@ -1751,6 +2222,102 @@ struct SlotCompaction {
         return 0;
     }
 
+    int find_first_frame_write(int precallPc, int callPc, int oldSlot)
+    {
+        for (int pc=precallPc + 1; pc < callPc; pc++) {
+            Op op = bc->ops[pc];
+            if ((op_flags(op.opcode) & OP_WRITES_SLOT_A) && op.a == oldSlot)
+                return pc;
+        }
+        return callPc;
+    }
+
+    bool frame_fits(int precallPc, int callPc, int top)
+    {
+        // Check if the call's frame can start at 'top' (in new slots). Every slot from top-2
+        // and upward must be dead by the time that the frame writes to it. One exception: a
+        // value can die at the same op that moves it into the same slot.
+
+        Op precall = bc->ops[precallPc];
+        int lastFrameSlot = top + precall.b;
+
+        for (int newSlot=top - 2; newSlot < newSlotCount; newSlot++) {
+            int occupant = new_slot_to_old[newSlot];
+            if (occupant == -1)
+                continue;
+
+            Liveness* liveness = get_liveness(bc, occupant);
+            if (!liveness->relocateable || liveness->writePc > precallPc)
+                return false;
+
+            int writePc = callPc;
+            if (newSlot >= top && newSlot <= lastFrameSlot)
+                writePc = find_first_frame_write(precallPc, callPc, precall.a + newSlot - top);
+
+            if (liveness->lastReadPc < writePc)
+                continue;
+
+            Op write = bc->ops[writePc];
+            if (liveness->lastReadPc == writePc && write.opcode == op_move && write.b == occupant)
+                continue;
+
+            return false;
+        }
+        return true;
+    }
+
+    int find_coalesced_frame_top(int precallPc, int defaultTop)
+    {
+        // Look for a lower frame position where one of the call's inputs is already sitting
+        // in the right slot. This happens a lot when the input is the output of a previous
+        // call. Returns -1 if there's no better position than 'defaultTop'.
+
+        Op precall = bc->ops[precallPc];
+        int callPc = -1;
+
+        // Only handle the simple case where the ops between precall and call just load
+        // the frame.
+        for (int pc=precallPc + 1; pc < bc->opCount; pc++) {
+            Op op = bc->ops[pc];
+            int opflags = op_flags(op.opcode);
+
+            if (op.opcode == op_precall || op_is_jump(op.opcode))
+                return -1;
+
+            if (opflags & OP_PUSHES_FRAME) {
+                if (op.a != precall.a)
+                    return -1;
+                callPc = pc;
+                break;
+            }
+
+            if ((opflags & OP_WRITES_SLOT_A) && (op.a < precall.a || op.a > precall.a + precall.b))
+                return -1;
+        }
+
+        if (callPc == -1)
+            return -1;
+
+        int best = -1;
+        for (int pc=precallPc + 1; pc < callPc; pc++) {
+            Op op = bc->ops[pc];
+            if (op.opcode != op_move || op.a <= precall.a || op.a > precall.a + precall.b)
+                continue;
+
+            if (op.b >= bc->slotCount || old_slot_to_new[op.b] == -1)
+                continue;
+
+            int top = old_slot_to_new[op.b] - (op.a - precall.a);
+            if (top < 2 || top >= defaultTop || (best != -1 && top >= best))
+                continue;
+
+            if (frame_fits(precallPc, callPc, top))
+                best = top;
+        }
+
+        return best;
+    }
+
     void do_init_pass()
     {
         // Don't move slots that are not 'relocateable'
@@ -1775,12 +2342,15 @@ struct SlotCompaction {
                 while (validRange > 0 && is_new_slot_unused(validRange-1, pc))
                     validRange--;
 
-                validRange += 2;
+                int top = validRange + 2;
+                int coalescedTop = find_coalesced_frame_top(pc, top);
+                if (coalescedTop != -1)
+                    top = coalescedTop;
 
                 for (int i=0; i < op.b + 1; i++)
-                    save_remap(op.a + i, validRange + i);
+                    save_remap(op.a + i, top + i);
 
-                validRange += op.b + 1;
+                validRange = top + op.b + 1;
                 continue;
             }
 
@@ -1880,12 +2450,95 @@ void perform_ops_prune(Bytecode* bc)
     }
 }
 
-Bytecode* compile_major_block(Block* block, VM* vm)
+void perform_call_fusion(Bytecode* bc)
+{
+    // Fuse a one-input call with the copy or move that loads its input. Runs after slot
+    // compaction, when op_precall has been discarded.
+
+    bool* isJumpTarget = find_jump_targets(bc);
+
+    for (int pc=0; pc < bc->opCount; pc++) {
+        Op* call = &bc->ops[pc];
+
+        if (call->opcode != op_uncompiled_call || call->b != 1)
+            continue;
+
+        int prevPc = fusion_find_previous_op(bc, isJumpTarget, pc);
+        if (prevPc == -1)
+            continue;
+
+        Op* load = &bc->ops[prevPc];
+        if ((load->opcode != op_copy && load->opcode != op_move) || load->a != call->a + 1)
+            continue;
+
+        call->opcode = load->opcode == op_copy ? op_uncompiled_copy_call : op_uncompiled_move_call;
+        call->b = load->b;
+        load->opcode = op_nope;
+    }
+
+    free(isJumpTarget);
+}
+
+void perform_nop_removal(Bytecode* bc)
+{
+    // Remove ops that do nothing, so they don't cost a dispatch. This updates jump
+    // addresses and metadata. Comments are kept in debug builds, for bytecode dumps.
+
+    int* newAddr = (int*) malloc(sizeof(int) * (bc->opCount + 1));
+    int newCount = 0;
+
+    for (int pc=0; pc < bc->opCount; pc++) {
+        newAddr[pc] = newCount;
+
+        int opcode = bc->ops[pc].opcode;
+        bool remove = opcode == op_nope;
+        #if !DEBUG
+            remove = remove || opcode == op_comment;
+        #endif
+
+        if (!remove)
+            bc->ops[newCount++] = bc->ops[pc];
+    }
+    newAddr[bc->opCount] = newCount;
+
+    for (int pc=0; pc < newCount; pc++) {
+        Op* op = &bc->ops[pc];
+        if (op_is_jump(op->opcode) && op->c <= bc->opCount)
+            op->c = newAddr[op->c];
+    }
+
+    for (int i=0; i < bc->metadataSize; i++)
+        bc->metadata[i].addr = newAddr[bc->metadata[i].addr];
+
+    free(newAddr);
+    grow_ops(bc, newCount);
+}
+
+static Type* specialized_input_type(Value* typeId)
+{
+    if (as_int(typeId) == TYPES.int_type->id)
+        return TYPES.int_type;
+    return TYPES.float_type;
+}
+
+Bytecode* compile_major_block(Block* block, VM* vm, Value* specialization)
 {
     Bytecode* bc = new_bytecode(vm);
 
     append_metadata(bc, mop_major_block_start, 0)->block = block;
 
+    set_hashtable(&bc->assumedTypes);
+
+    if (specialization != NULL) {
+        copy(specialization, &bc->specialization);
+
+        for (int i=0; i < list_length(specialization) - 1; i++) {
+            Value* typeId = specialization->index(i + 1);
+            if (!is_null(typeId))
+                assume_type(bc, get_input_placeholder(block, i), specialized_input_type(typeId));
+        }
+    }
+
     #if DEBUG
         Value str;
         str.set_string("Block");
@@ -1893,6 +2546,8 @@ Bytecode* compile_major_block(Block* block, VM* vm)
             string_append(&str, ": ");
             string_append(&str, term_name(block->owningTerm));
         }
+        if (specialization != NULL)
+            string_append(&str, " (specialized)");
         comment(bc, &str);
     #endif
 
@@ -1902,11 +2557,15 @@ Bytecode* compile_major_block(Block* block, VM* vm)
 
     // Optimization
     perform_move_optimization(bc);
+    perform_superinstruction_fusion(bc);
     perform_slot_compaction(bc);
     perform_ops_prune(bc);
+    perform_call_fusion(bc);
 
     bc->ops[growFrameAddr].a = bc->slotCount;
 
+    perform_nop_removal(bc);
+
     #if DEBUG
         comment(bc, "block fin");
     #endif
@@ -1923,7 +2582,13 @@ void relocate(Op* op, int constDelta, int opsDelta)
     case op_dyn_method:
         op->c += constDelta;
         break;
+    case op_uncompiled_copy_call:
+    case op_uncompiled_move_call:
+        op->c += constDelta;
+        break;
     case op_call:
+    case op_copy_call:
+    case op_move_call:
     case op_jump:
     case op_jif:
     case op_jnif:
@@ -1942,6 +2607,7 @@ void relocate(Op* op, int constDelta, int opsDelta)
         op->a += constDelta;
         break;
     case op_cast_fixed_type:
+    case op_guard_types:
         op->c += constDelta;
         break;
     default:
@@ -1968,11 +2634,23 @@ void dump_op(Bytecode* bc, Op op)
         printf("func_apply_d top:r%d count:%d func:r%d\n", op.a, op.b, op.c);
         break;
     case op_dyn_method:
-        printf("dyn_method top:r%d count:%d nameLocationConst:%d\n", op.a, op.b, op.c);
+        printf("dyn_method top:r%d count:%d methodSiteConst:%d\n", op.a, op.b, op.c);
         break;
     case op_precall:
         printf("precall top:r%d count:%d\n", op.a, op.b);
         break;
+    case op_uncompiled_copy_call:
+        printf("uncompiled_copy_call top:r%d source:r%d const:%d\n", op.a, op.b, op.c);
+        break;
+    case op_uncompiled_move_call:
+        printf("uncompiled_move_call top:r%d source:r%d const:%d\n", op.a, op.b, op.c);
+        break;
+    case op_copy_call:
+        printf("copy_call top:r%d source:r%d addr:%d\n", op.a, op.b, op.c);
+        break;
+    case op_move_call:
+        printf("move_call top:r%d source:r%d addr:%d\n", op.a, op.b, op.c);
+        break;
     case op_jump: printf("jump addr:%d\n", op.c); break;
     case op_jif: printf("jif r%d addr:%d\n", op.a, op.c); break;
     case op_jnif: printf("jnif r%d addr:%d\n", op.a, op.c); break;
@@ -1999,6 +2677,21 @@ void dump_op(Bytecode* bc, Op op)
     case op_sub_i: printf("sub_i dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
     case op_mult_i: printf("mult_i dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
     case op_div_i: printf("div_i dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_add_i_imm: printf("add_i_imm dest:r%d r%d value:%d\n", op.a, op.b, op.c); break;
+    case op_sub_i_imm: printf("sub_i_imm dest:r%d r%d value:%d\n", op.a, op.b, op.c); break;
+    case op_lt_i: printf("lt_i dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_lte_i: printf("lte_i dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_gt_i: printf("gt_i dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_gte_i: printf("gte_i dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_add_f: printf("add_f dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_sub_f: printf("sub_f dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_mult_f: printf("mult_f dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_div_f: printf("div_f dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_lt_f: printf("lt_f dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_lte_f: printf("lte_f dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_gt_f: printf("gt_f dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_gte_f: printf("gte_f dest:r%d r%d r%d\n", op.a, op.b, op.c); break;
+    case op_guard_types: printf("guard_types r%d count:%d specialization:%d\n", op.a, op.b, op.c); break;
     case op_push_state_frame: printf("push_state_frame (static key)\n"); break;
     case op_push_state_frame_dkey: printf("push_state_frame_dkey r%d\n", op.a); break;
     case op_pop_state_frame: printf("pop_state_frame\n"); break;
@@ -2033,6 +2726,8 @@ void dump_mop(Bytecode*, BytecodeMetadata mop)
     case mop_term_live: printf("term_live"); break;
     case mop_major_block_start: printf("major_block_start"); break;
     case mop_major_block_end: printf("major_block_end"); break;
+    case mop_inline_start: printf("inline_start"); break;
+    case mop_inline_end: printf("inline_end"); break;
     }
 
     printf(" slot:%d", mop.slot);
@@ -2069,9 +2764,8 @@ void Bytecode::dump_metadata()
     }
 }
 
-int append_compiled_major_block(Bytecode* assembled, Block* block)
+int append_compiled_bytecode(Bytecode* assembled, Bytecode* bc, Value* key)
 {
-    Bytecode* bc = compile_major_block(block, assembled->vm);
     //bc->dump();
 
     int baseSlot = assembled->slotCount;
@@ -2100,10 +2794,7 @@ int append_compiled_major_block(Bytecode* assembled, Block* block)
             assembled->metadata[i].related_maddr += baseMetadata;
     }
 
-    Value blockVal;
-    set_block(&blockVal, block);
-
-    Value* blockRecord = assembled->blockToAddr.insert_val(&blockVal);
+    Value* blockRecord = assembled->blockToAddr.insert_val(key);
     blockRecord->set_list(2);
     blockRecord->index(0)->set_int(baseOp);
     blockRecord->index(1)->set_int(assembled->opCount);
@@ -2117,6 +2808,14 @@ int append_compiled_major_block(Bytecode* assembled, Block* block)
     return baseOp;
 }
 
+int append_compiled_major_block(Bytecode* assembled, Block* block)
+{
+    Value blockVal;
+    set_block(&blockVal, block);
+    return append_compiled_bytecode(assembled, compile_major_block(block, assembled->vm, NULL),
+        &blockVal);
+}
+
 int find_compiled_major_block(Bytecode* bc, Block* block)
 {
     Value blockVal;
@@ -2143,6 +2842,72 @@ int find_or_compile_major_block(Bytecode* bc, Block* block)
         return append_compiled_major_block(bc, block);
 }
 
+static Type* specializable_type(Value* value)
+{
+    // Only numbers are worth specializing on, since they have dedicated ops.
+    if (is_int(value))
+        return TYPES.int_type;
+    if (is_float(value))
+        return TYPES.float_type;
+    return NULL;
+}
+
+static bool is_generic_math_function(Term* function)
+{
+    return function == FUNCS.add || function == FUNCS.sub || function == FUNCS.mult
+        || function == FUNCS.div || function == FUNCS.less_than
+        || function == FUNCS.less_than_eq || function == FUNCS.greater_than
+        || function == FUNCS.greater_than_eq;
+}
+
+static bool input_used_by_inline_op(Block* block, Term* placeholder)
+{
+    for (MinorBlockIterator it(block); it; ++it) {
+        Term* term = *it;
+        if (term->numInputs() == 2 && is_generic_math_function(term->function)
+                && (term->input(0) == placeholder || term->input(1) == placeholder))
+            return true;
+    }
+    return false;
+}
+
+int find_or_compile_specialized_block(Bytecode* bc, Block* block, Value* inputs, int inputCount)
+{
+    // Lazily compile a version of this block that assumes the types of the inputs it was
+    // called with. Each version is keyed in blockToAddr by [block, typeId or null, ...].
+    // Blocks that wouldn't compile any differently use the generic version.
+
+    if (inputCount == 0
+            || inputCount != count_input_placeholders(block)
+            || has_variable_args(block))
+        return find_or_compile_major_block(bc, block);
+
+    Value key;
+    set_list(&key, inputCount + 1);
+    set_block(key.index(0), block);
+    bool anySpecialized = false;
+
+    for (int i=0; i < inputCount; i++) {
+        Term* placeholder = get_input_placeholder(block, i);
+        Type* type = specializable_type(&inputs[i]);
+        if (type != NULL && declared_type(placeholder) == TYPES.any
+                && input_used_by_inline_op(block, placeholder)) {
+            set_int(key.index(i + 1), type->id);
+            anySpecialized = true;
+        }
+    }
+
+    if (!anySpecialized)
+        return find_or_compile_major_block(bc, block);
+
+    Value* found = bc->blockToAddr.val_key(&key);
+    if (found != NULL)
+        return found->index(0)->as_i();
+
+    stat_increment(Bytecode_SpecializeBlock);
+    return append_compiled_bytecode(bc, compile_major_block(block, bc->vm, &key), &key);
+}
+
 void vm_prepare_bytecode(VM* vm, VM* callingVM)
 {
     vm_prepare_env(vm, callingVM);
@@ -2221,7 +2986,8 @@ bool mopcode_uses_related_maddr(int mopcode)
 {
     return mopcode == mop_term_eval_end
         || mopcode == mop_minor_block_end
-        || mopcode == mop_major_block_end;
+        || mopcode == mop_major_block_end
+        || mopcode == mop_inline_end;
 }
 
 Term* find_active_term(Bytecode* bc, int addr)
@@ -2229,14 +2995,21 @@ Term* find_active_term(Bytecode* bc, int addr)
     if (bc == NULL || bc->metadataSize == 0)
         return NULL;
 
-    int maddr = find_metadata_addr_for_addr(bc, addr);
+    return find_active_term_at_maddr(bc, find_metadata_addr_for_addr(bc, addr));
+}
 
+Term* find_active_term_at_maddr(Bytecode* bc, int maddr)
+{
     for (; maddr >= 0; maddr--) {
         BytecodeMetadata md = bc->metadata[maddr];
         switch (md.mopcode) {
         case mop_term_eval_start:
             return md.term;
         //case mop_term_eval_end:
+        case mop_inline_end:
+            // Skip over an inlined call that has finished.
+            maddr = md.related_maddr;
+            break;
         case mop_major_block_start:
             return NULL;
         }
@@ -2244,6 +3017,68 @@ Term* find_active_term(Bytecode* bc, int addr)
     return NULL;
 }
 
+int find_inline_end_addr(Bytecode* bc, int inlineStartMaddr)
+{
+    // Returns the addr just after the inlined call. This is where a real call would have
+    // returned to.
+
+    for (int maddr=inlineStartMaddr + 1; maddr < bc->metadataSize; maddr++) {
+        BytecodeMetadata md = bc->metadata[maddr];
+        if (md.mopcode == mop_inline_end && md.related_maddr == inlineStartMaddr)
+            return md.addr;
+    }
+    return bc->opCount;
+}
+
+int find_return_maddr(Bytecode* bc, int addr)
+{
+    // Like find_metadata_addr_for_addr, for an addr that we will return to (so its ops
+    // haven't run yet). If an inlined call starts exactly at 'addr' then we're not inside
+    // it, so the result is the metadata just before its mop_inline_start.
+
+    int maddr = find_metadata_addr_for_addr(bc, addr);
+    for (int search = maddr; search >= 0 && bc->metadata[search].addr == addr; search--) {
+        if (bc->metadata[search].mopcode == mop_inline_start)
+            maddr = search - 1;
+    }
+    return maddr;
+}
+
+int find_running_maddr(Bytecode* bc, int addr)
+{
+    // Like find_return_maddr, for the pc of a frame that's still running. The op just before
+    // 'addr' is the one that's running (or that made a call). If that op was the last one
+    // of an inlined call then we're still inside it, so the result is the metadata just
+    // before its mop_inline_end.
+
+    int maddr = find_return_maddr(bc, addr);
+    for (int search = maddr; search >= 0 && bc->metadata[search].addr == addr; search--) {
+        if (bc->metadata[search].mopcode == mop_inline_end)
+            maddr = search - 1;
+    }
+    return maddr;
+}
+
+int find_active_inline_start(Bytecode* bc, int maddr)
+{
+    // Finds the innermost inlined call that is active at 'maddr'. Returns the maddr of its
+    // mop_inline_start, or -1 if we're not inside an inlined call.
+
+    for (; maddr >= 0; maddr--) {
+        BytecodeMetadata md = bc->metadata[maddr];
+        switch (md.mopcode) {
+        case mop_inline_start:
+            return maddr;
+        case mop_inline_end:
+            maddr = md.related_maddr;
+            break;
+        case mop_major_block_start:
+            return -1;
+        }
+    }
+    return -1;
+}
+
 Block* find_active_major_block(Bytecode* bc, int addr)
 {
     // Finds the active block at 'addr', by walking backwards to find the nearest
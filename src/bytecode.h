@@ -22,9 +22,20 @@ const char op_call = 0x8;             // a: top, b: count, c: addr.
 const char op_func_call_s = 0x43;     // a: top, b: count, c: addr.
 const char op_func_call_d = 0x2;      // a: top, b: count.
 const char op_func_apply_d = 0x39;    // a: top, b: count. (count is always 2 in this case)
-const char op_dyn_method = 0x38;      // a: top, b: count, c: const index of [name,location]
+const char op_dyn_method = 0x38;      // a: top, b: count, c: const index of [[name,location], cacheVersion, cache]
 const char op_precall = 0x70;         // a: top, b: count. (precall is discarded during optimization)
 
+// Entry guard for a type-specialized block. If an input doesn't have the expected type then
+// execution continues in the generic version of the block.
+const char op_guard_types = 0x19;     // a: firstInputSlot, b: count, c: const index of specialization
+
+// Superinstructions, created by perform_call_fusion. Call with one input: slot b is
+// copied or moved to top+1 before the call.
+const char op_uncompiled_copy_call = 0x48; // a: top, b: sourceSlot, c: const index of block.
+const char op_uncompiled_move_call = 0x49; // a: top, b: sourceSlot, c: const index of block.
+const char op_copy_call = 0x4a;       // a: top, b: sourceSlot, c: addr.
+const char op_move_call = 0x4b;       // a: top, b: sourceSlot, c: addr.
+
 const char op_jump = 0x4;             // c: addr
 const char op_jif = 0x30;             // a: slot, c: addr
 const char op_jnif = 0x31;            // a: slot, c: addr
@@ -35,12 +46,15 @@ const char op_jgte = 0x27;            // a: leftSlot, b: rightSlot, c: addr
 const char op_jlt = 0x28;             // a: leftSlot, b: rightSlot, c: addr
 const char op_jlte = 0x29;            // a: leftSlot, b: rightSlot, c: addr
 
+// The ordered jumps (jgt, jgte, jlt, jlte) compare ints. They are created by
+// perform_superinstruction_fusion from an int comparison followed by jif/jnif.
+
 const char op_ret = 0x5;
 const char op_ret_or_stop = 0x18;
 
 const char op_grow_frame = 0x16;      // a: size
 const char op_load_const = 0x15;      // a: constIndex, b: destSlot
-const char op_load_i = 0x45;          // a: value, b: destSlot
+const char op_load_i = 0x45;          // a: destSlot, b: value
 const char op_varargs_to_list = 0x14; // a: slot & inputIndex
 const char op_splat_upvalues = 0x42;  // a: firstSlot, b: count
 
@@ -56,6 +70,25 @@ const char op_add_i = 0x20;           // a: left, b: right, c: dest
 const char op_sub_i = 0x21;
 const char op_mult_i = 0x22;
 const char op_div_i = 0x23;
+const char op_add_i_imm = 0x2a;       // a: dest, b: left, c: immediate value
+const char op_sub_i_imm = 0x2b;       // a: dest, b: left, c: immediate value
+
+const char op_lt_i = 0x2c;            // a: dest, b: left, c: right
+const char op_lte_i = 0x2d;
+const char op_gt_i = 0x2e;
+const char op_gte_i = 0x2f;
+
+// Float ops are guarded: if both inputs are numbers (and at least one is a float,
+// except for div_f) then the result is written to 'dest' and the following op is
+// skipped. That following op is the generic call, which runs when the guard fails.
+const char op_add_f = 0x50;           // a: dest, b: left, c: right
+const char op_sub_f = 0x51;
+const char op_mult_f = 0x52;
+const char op_div_f = 0x53;
+const char op_lt_f = 0x54;
+const char op_lte_f = 0x55;
+const char op_gt_f = 0x56;
+const char op_gte_f = 0x57;
 
 const char op_push_state_frame = 0x35; // a: frameSlot
 const char op_push_state_frame_dkey = 0x47; // a: frameSlot, b: keySlot
@@ -76,6 +109,11 @@ const char mop_major_block_end = 0x5;
 const char mop_minor_block_start = 0x6;
 const char mop_minor_block_end = 0x7;
 
+// inline_start(block) - the ops that follow were inlined from a call to 'block'.
+// inline_end(mopaddr) - the mopaddr points to the matching inline_start
+const char mop_inline_start = 0xa;
+const char mop_inline_end = 0xb;
+
 struct Op {
     u16 a : 16;
     u16 b : 16;
@@ -146,6 +184,10 @@ struct Bytecode {
     int nextFreeSlot;
     int slotCount;
 
+    // Used when compiling a type-specialized major block:
+    Value specialization; // list of [block, typeId or null for each input]
+    Value assumedTypes; // map of term -> type, for types known to be more specific than declared
+
     // Used for an assembled program:
     Value blockToAddr; // map of major block -> [int start, int fin]
 
@@ -157,8 +199,14 @@ void free_bytecode(Bytecode* bc);
 void exec(Block* block);
 Value* get_const(Bytecode* bc, int index);
 Term* find_active_term(Bytecode* bc, int addr);
+Term* find_active_term_at_maddr(Bytecode* bc, int maddr);
+int find_active_inline_start(Bytecode* bc, int maddr);
+int find_inline_end_addr(Bytecode* bc, int inlineStartMaddr);
+int find_return_maddr(Bytecode* bc, int addr);
+int find_running_maddr(Bytecode* bc, int addr);
 Block* find_active_major_block(Bytecode* bc, int addr);
 int find_or_compile_major_block(Bytecode* bc, Block* block);
+int find_or_compile_specialized_block(Bytecode* bc, Block* block, Value* inputs, int inputCount);
 void vm_prepare_bytecode(VM* vm, VM* callingVM);
 void vm_run(VM* vm, VM* callingVM);
 
@@ -58,6 +58,7 @@ struct FeedbackOperation;
 struct FileWatch;
 struct FileWatchWorld;
 struct GCReferenceList;
+struct JsonStream;
 struct ListData;
 struct LibuvWorld;
 struct NativeFunc;
@@ -69,6 +70,7 @@ struct TermList;
 struct TermMap;
 struct Type;
 struct VM;
+struct WorkerPool;
 
 typedef bool (*TermVisitor)(Term* term, Value* context);
 typedef int Symbol;
@@ -158,6 +160,44 @@ void ca_assert_function(bool result, const char* expr, int line, const char* fil
  #define CIRCA_ENABLE_LIBUV 0
 #endif
 
+// ENABLE_THREADED_DISPATCH - The interpreter loop in vm_run will jump directly between
+// op handlers using a table of label addresses (computed goto), instead of going through
+// a switch statement. Requires the 'labels as values' extension (GCC and Clang).
+#ifndef CIRCA_ENABLE_THREADED_DISPATCH
+ #if defined(__GNUC__)
+  #define CIRCA_ENABLE_THREADED_DISPATCH 1
+ #else
+  #define CIRCA_ENABLE_THREADED_DISPATCH 0
+ #endif
+#endif
+
+// ENABLE_SMALL_STRINGS - Short strings are stored inside the Value's data field, instead
+// of in a separate heap allocation. The first byte of the data field is used as a tag,
+// so this needs a little-endian target.
+#ifndef CIRCA_ENABLE_SMALL_STRINGS
+ #if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+  #define CIRCA_ENABLE_SMALL_STRINGS 1
+ #else
+  #define CIRCA_ENABLE_SMALL_STRINGS 0
+ #endif
+#endif
+
+// ENABLE_SIMD - Allows the use of SSE2 or NEON intrinsics (currently for JSON string
+// scanning), when the target supports them.
+#ifndef CIRCA_ENABLE_SIMD
+ #define CIRCA_ENABLE_SIMD 1
+#endif
+
+// THREAD_LOCAL - Storage for the interpreter's globals (such as the current World, TYPES and
+// FUNCS). Each thread that calls circa_initialize gets its own World, and its own copy of
+// these globals. Uses __thread instead of C++11 thread_local, so that reading one of these
+// doesn't go through an initialization check.
+#if defined(_MSC_VER)
+ #define CIRCA_THREAD_LOCAL __declspec(thread)
+#else
+ #define CIRCA_THREAD_LOCAL __thread
+#endif
+
 // ENABLE_SNEAKY_EQUALS - When enabled, equals() is allowed to combine the
 // internal representation of values (when it's correct to do so).
 #define CIRCA_ENABLE_SNEAKY_EQUALS 1
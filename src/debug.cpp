@@ -21,7 +21,7 @@ bool DEBUG_TRAP_RAISE_ERROR = false;
 
 int DEBUG_BREAK_ON_TERM = -1;
 
-PerfStatList* g_perfStatList;
+CIRCA_THREAD_LOCAL PerfStatList* g_perfStatList;
 
 void dump(Block& block)
 {
@@ -146,8 +146,8 @@ void perf_stat_add(int name, int n)
 #if CIRCA_ENABLE_LOGGING
 
 FILE* g_logFile = NULL;
-int g_logArgCount = 0;
-int g_logInProgress = false;
+CIRCA_THREAD_LOCAL int g_logArgCount = 0;
+CIRCA_THREAD_LOCAL int g_logInProgress = false;
 
 void log_start(int channel, const char* name)
 {
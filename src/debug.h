@@ -47,7 +47,7 @@ void perf_stat_add(int name, int n);
 
 #if CIRCA_ENABLE_PERF_STATS
 
-extern PerfStatList* g_perfStatList;
+extern CIRCA_THREAD_LOCAL PerfStatList* g_perfStatList;
 
 #define stat_increment(x) perf_stat_inc(stat_##x);
 #define stat_add(x,n) perf_stat_add(stat_##x, (n));
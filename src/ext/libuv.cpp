@@ -4,6 +4,9 @@
  
  https://github.com/joyent/libuv/blob/master/test/echo-server.c
 
+ This module isn't built (see CIRCA_ENABLE_LIBUV), and still uses the old Stack API and
+ the libuv 0.10 API. None of it has been run against a real libuv; see BUGS.
+
  */
 #include "common_headers.h"
 
@@ -11,7 +14,9 @@
 #include <http-parser/http_parser.h>
 
 #include "debug.h"
+#include "hashtable.h"
 #include "libuv.h"
+#include "list.h"
 #include "stack.h"
 #include "string_type.h"
 #include "world.h"
@@ -35,17 +40,109 @@ static int http_on_header_value(http_parser* parser, const char* value, size_t l
 static int http_on_body(http_parser* parser, const char* value, size_t len);
 static int http_on_headers_complete(http_parser* parser);
 static int http_on_message_complete(http_parser* parser);
+static int http_request_on_message_begin(http_parser* parser);
+static int http_request_on_url(http_parser* parser, const char* field, size_t len);
+static int http_request_on_body(http_parser* parser, const char* value, size_t len);
+static int http_request_on_message_complete(http_parser* parser);
+static void http_execute(struct Connection* connection, const char* data, size_t len);
+
+// Receive buffer for framed connections. Incoming frames are handed to scripts as blob
+// slices that point into 'data', so a buffer stays alive (through a native_ptr Value)
+// until the connection and every frame sliced out of it have been released. Then it
+// goes back to its world's free list.
+struct ReadBuffer {
+    LibuvWorld* world;
+    ReadBuffer* nextFree;
+    u32 capacity;
+    char data[1];
+};
+
+const u32 READ_BUFFER_SIZE = 64 * 1024;
+
+// When a connection's buffer has less free space than this, the next read goes into
+// a fresh buffer.
+const u32 READ_BUFFER_MIN_SPACE = 4 * 1024;
+
+const int READ_BUFFER_MAX_FREE = 32;
+
+// Larger frames are treated as a protocol error, and the connection is closed.
+const u32 FRAME_MAX_SIZE = 64 * 1024 * 1024;
+
+struct Connection;
+
+// One uv_write covering every message that a connection sent during a tick. Batches
+// (and their buffer arrays) are reused through the world's free list.
+struct WriteBatch {
+    uv_write_t req;
+    Connection* connection;
+
+    // The queued messages. Their bytes are referenced by 'bufs' until the write is done.
+    Value payloads;
+
+    uv_buf_t* bufs;
+    int bufCapacity;
+
+    // Length prefixes for framed connections.
+    char* headers;
+    int headerCapacity;
+
+    u32 bytes;
+    WriteBatch* nextFree;
+
+    WriteBatch() {
+        connection = NULL;
+        bufs = NULL;
+        bufCapacity = 0;
+        headers = NULL;
+        headerCapacity = 0;
+        bytes = 0;
+        nextFree = NULL;
+    }
+};
+
+const int WRITE_BATCH_MAX_FREE = 64;
 
 struct LibuvWorld {
     uv_loop_t* uv_loop;
+
+    ReadBuffer* freeReadBuffers;
+    int freeReadBufferCount;
+
+    WriteBatch* freeWriteBatches;
+    int freeWriteBatchCount;
+
+    // Connections with queued writes, linked through Connection::nextFlush.
+    Connection* flushConnections;
 };
 
-enum ServerType { TCP, WEBSOCK };
+enum ServerType { TCP, WEBSOCK, FRAMES, HTTP };
 
 enum ConnectionState {
     TCP_STATE,
     WEBSOCK_NEGOTIATE_STATE,
-    WEBSOCK_DUPLEX_STATE
+    WEBSOCK_DUPLEX_STATE,
+
+    // Each message is a 4-byte little-endian length followed by that many bytes.
+    FRAMES_STATE,
+
+    // HTTP/1.1 server connection, with keep-alive and pipelining.
+    HTTP_STATE
+};
+
+// Maximum number of requests on one HTTP connection that can be waiting for a
+// response. Past this, the connection stops reading until responses are sent.
+const int HTTP_MAX_PIPELINED = 32;
+
+// Response to one request on an HTTP connection. Responses must go out in request
+// order, so a response to a later request is held in 'pieces' until every earlier one
+// has finished.
+struct HttpResponse {
+    Value pieces;
+    bool started;
+    bool finished;
+    bool chunked;
+    bool keepAlive;
+    bool http10;
 };
 
 struct Server {
@@ -72,8 +169,70 @@ struct Connection {
     ConnectionState state;
     Server* server;
 
+    // FRAMES_STATE only. The native_ptr to the current ReadBuffer, and the range of it
+    // that has been received but not yet delivered as a frame.
+    Value readBuffer;
+    u32 readStart;
+    u32 readEnd;
+
+    // Messages queued since the last flush.
+    Value outgoing;
+
+    // Bytes that are queued or being written. When 'writeLimit' is nonzero, sends are
+    // refused while this is at or above it.
+    u32 pendingBytes;
+    u32 writeLimit;
+
+    bool flushQueued;
+    Connection* nextFlush;
+
+    // Shut down the connection once everything pending has been written.
+    bool closeAfterWrite;
+
+    // Set when the connection starts shutting down or closing. Nothing more is sent.
+    bool closing;
+
+    // Set once the socket is closed. Scripts may still hold the Connection, so it's only
+    // deleted after that and after ConnectionRelease, whichever comes last.
+    bool closed;
+    bool released;
+
+    // HTTP_STATE only. Requests are numbered in arrival order; 'httpNextResponse' is
+    // the oldest one that hasn't been answered. Each unanswered request has a slot in
+    // 'httpResponses', indexed by id % HTTP_MAX_PIPELINED.
+    Value httpUrl;
+    Value httpBody;
+    HttpResponse* httpResponses;
+    int httpNextRequest;
+    int httpNextResponse;
+
+    // When too many requests are unanswered, the parser is paused and reading stops.
+    // Bytes that were read but not parsed yet are kept here.
+    Value httpUnparsed;
+    bool httpReadPaused;
+
+    // Set after a request that doesn't allow keep-alive. No more requests are parsed.
+    bool httpClosing;
+
     Connection() {
         server = NULL;
+        state = TCP_STATE;
+        readStart = 0;
+        readEnd = 0;
+        pendingBytes = 0;
+        writeLimit = 0;
+        flushQueued = false;
+        nextFlush = NULL;
+        closeAfterWrite = false;
+        closing = false;
+        closed = false;
+        released = false;
+        httpResponses = NULL;
+        httpNextRequest = 0;
+        httpNextResponse = 0;
+        httpReadPaused = false;
+        httpClosing = false;
+        circa_set_list(&outgoing, 0);
         circa_set_string(&incomingStr, "");
         circa_set_list(&incomingMsgs, 0);
     }
@@ -83,11 +242,25 @@ void ServerRelease(void* ptr)
 {
 }
 
+static void connection_delete(Connection* connection)
+{
+    delete[] connection->httpResponses;
+    delete connection;
+}
+
 void ConnectionRelease(void* ptr)
 {
-    // Connection* connection = (Connection*) ptr;
-    //uv_close((uv_handle_t*) &connection->uv_connect.handle, NULL);
-    // delete connection;
+    // Scripts can't reach this connection anymore. Close it if it's still open, on_close
+    // deletes it once that's done.
+    Connection* connection = (Connection*) ptr;
+    connection->released = true;
+
+    if (connection->closed) {
+        connection_delete(connection);
+    } else if (!connection->closing) {
+        connection->closing = true;
+        uv_close((uv_handle_t*) &connection->uv_tcp, on_close);
+    }
 }
 
 static uv_loop_t* get_uv_loop(caWorld* world)
@@ -95,45 +268,279 @@ static uv_loop_t* get_uv_loop(caWorld* world)
     return world->libuvWorld->uv_loop;
 }
 
+static ReadBuffer* read_buffer_acquire(LibuvWorld* world, u32 minCapacity)
+{
+    if (minCapacity <= READ_BUFFER_SIZE && world->freeReadBuffers != NULL) {
+        ReadBuffer* buffer = world->freeReadBuffers;
+        world->freeReadBuffers = buffer->nextFree;
+        world->freeReadBufferCount--;
+        return buffer;
+    }
+
+    u32 capacity = minCapacity > READ_BUFFER_SIZE ? minCapacity : READ_BUFFER_SIZE;
+    ReadBuffer* buffer = (ReadBuffer*) malloc(sizeof(ReadBuffer) + capacity);
+    buffer->world = world;
+    buffer->nextFree = NULL;
+    buffer->capacity = capacity;
+    return buffer;
+}
+
+static void read_buffer_release(void* ptr)
+{
+    ReadBuffer* buffer = (ReadBuffer*) ptr;
+    LibuvWorld* world = buffer->world;
+
+    // Oversized buffers (for large frames) aren't kept.
+    if (buffer->capacity != READ_BUFFER_SIZE || world->freeReadBufferCount >= READ_BUFFER_MAX_FREE) {
+        free(buffer);
+        return;
+    }
+
+    buffer->nextFree = world->freeReadBuffers;
+    world->freeReadBuffers = buffer;
+    world->freeReadBufferCount++;
+}
+
+static u32 read_u32_le(const char* data)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((u32) bytes[3] << 24);
+}
+
+static void write_u32_le(char* data, u32 value)
+{
+    data[0] = value & 0xff;
+    data[1] = (value >> 8) & 0xff;
+    data[2] = (value >> 16) & 0xff;
+    data[3] = (value >> 24) & 0xff;
+}
+
+// Read straight into the free tail of the connection's ReadBuffer. A new buffer is only
+// needed when the tail is nearly full, or when the pending frame won't fit; the bytes of
+// a partially received frame are the only ones that ever get copied.
+static uv_buf_t frames_alloc_buffer(Connection* connection, uv_loop_t* loop)
+{
+    ReadBuffer* current = NULL;
+    if (!circa_is_null(&connection->readBuffer))
+        current = (ReadBuffer*) circa_native_ptr(&connection->readBuffer);
+
+    u32 pending = connection->readEnd - connection->readStart;
+    u32 needed = READ_BUFFER_MIN_SPACE;
+
+    if (pending >= 4) {
+        u32 frameSize = 4 + read_u32_le(current->data + connection->readStart);
+        if (frameSize <= 4 + FRAME_MAX_SIZE && frameSize - pending > needed)
+            needed = frameSize - pending;
+    }
+
+    if (current == NULL || current->capacity - connection->readEnd < needed) {
+        LibuvWorld* world = (LibuvWorld*) loop->data;
+        ReadBuffer* next = read_buffer_acquire(world, pending + needed);
+        if (pending > 0)
+            memcpy(next->data, current->data + connection->readStart, pending);
+
+        // Drops the connection's reference to the old buffer. Frames already sliced out
+        // of it keep it alive.
+        circa_set_native_ptr(&connection->readBuffer, next, read_buffer_release);
+        connection->readStart = 0;
+        connection->readEnd = pending;
+        current = next;
+    }
+
+    return uv_buf_init(current->data + connection->readEnd,
+        current->capacity - connection->readEnd);
+}
+
 static uv_buf_t alloc_buffer(uv_handle_t* handle,
                        size_t suggested_size) {
 
+    Connection* connection = (Connection*) handle->data;
+    if (connection != NULL && connection->state == FRAMES_STATE)
+        return frames_alloc_buffer(connection, handle->loop);
+
     return uv_buf_init((char*) malloc(suggested_size), suggested_size);
 }
 
-// Send 'msg' to the stream. 'msg' must be a string value. This function takes ownership
-// of 'msg'.
-static void circa_uv_write(uv_stream_t* stream, Value* msg, bool addNull)
+// Release a buffer that came from alloc_buffer. Framed connections read into their
+// ReadBuffer, which isn't freed here.
+static void free_read_buf(uv_stream_t* stream, uv_buf_t buf)
+{
+    Connection* connection = (Connection*) stream->data;
+    if (connection != NULL && connection->state == FRAMES_STATE)
+        return;
+
+    if (buf.base)
+        free(buf.base);
+}
+
+// Outgoing messages are queued on the connection, and everything queued during one
+// tick is sent with a single vectored uv_write (see libuv_process_events).
+
+// Payload bytes that 'msg' (a queued string or blob) puts on the wire.
+static u32 outgoing_size(Connection* connection, Value* msg)
+{
+    u32 size;
+    if (circa_is_string(msg))
+        size = circa_string_length(msg);
+    else
+        size = circa_blob_size(msg);
+
+    if (connection->state == FRAMES_STATE)
+        size += 4;
+
+    return size;
+}
+
+static bool connection_over_write_limit(Connection* connection)
+{
+    return connection->writeLimit != 0 && connection->pendingBytes >= connection->writeLimit;
+}
+
+// Queue 'msg' (a string or blob) to be sent on the next flush. 'msg' is moved. It's
+// dropped if the connection is closing.
+static void connection_queue_write(Connection* connection, Value* msg)
+{
+    if (connection->closing) {
+        circa_set_null(msg);
+        return;
+    }
+
+    connection->pendingBytes += outgoing_size(connection, msg);
+    circa_move(msg, circa_append(&connection->outgoing));
+
+    if (!connection->flushQueued) {
+        LibuvWorld* world = (LibuvWorld*) connection->uv_tcp.loop->data;
+        connection->flushQueued = true;
+        connection->nextFlush = world->flushConnections;
+        world->flushConnections = connection;
+    }
+}
+
+static void connection_shutdown(uv_stream_t* stream)
+{
+    Connection* connection = (Connection*) stream->data;
+    if (connection->closing)
+        return;
+
+    connection->closing = true;
+    uv_shutdown_t* req = (uv_shutdown_t*) malloc(sizeof *req);
+    uv_shutdown(req, stream, after_shutdown);
+}
+
+static WriteBatch* write_batch_acquire(LibuvWorld* world)
+{
+    if (world->freeWriteBatches != NULL) {
+        WriteBatch* batch = world->freeWriteBatches;
+        world->freeWriteBatches = batch->nextFree;
+        world->freeWriteBatchCount--;
+        return batch;
+    }
+
+    WriteBatch* batch = new WriteBatch();
+    batch->req.data = batch;
+    return batch;
+}
+
+static void write_batch_release(LibuvWorld* world, WriteBatch* batch)
 {
-    uv_write_t *wr = (uv_write_t*) malloc(sizeof *wr);
-    wr->data = msg;
+    circa_set_list(&batch->payloads, 0);
+    batch->connection = NULL;
 
-    uv_buf_t outgoing_buf;
-    outgoing_buf.base = (char*) circa_string(msg);
-    outgoing_buf.len = circa_string_length(msg);
-    if (addNull)
-        outgoing_buf.len++;
+    if (world->freeWriteBatchCount >= WRITE_BATCH_MAX_FREE) {
+        free(batch->bufs);
+        free(batch->headers);
+        delete batch;
+        return;
+    }
+
+    batch->nextFree = world->freeWriteBatches;
+    world->freeWriteBatches = batch;
+    world->freeWriteBatchCount++;
+}
+
+// Send everything in the connection's outgoing queue with one uv_write. The queued
+// values are moved into the batch, which keeps them alive until the write finishes, so
+// their bytes are handed to the kernel without being copied.
+static void connection_flush(Connection* connection)
+{
+    int count = circa_length(&connection->outgoing);
+    if (count == 0)
+        return;
+
+    LibuvWorld* world = (LibuvWorld*) connection->uv_tcp.loop->data;
+    WriteBatch* batch = write_batch_acquire(world);
+    batch->connection = connection;
+    circa_move(&connection->outgoing, &batch->payloads);
+    circa_set_list(&connection->outgoing, 0);
+
+    bool framed = connection->state == FRAMES_STATE;
+    int bufCount = framed ? count * 2 : count;
+
+    if (bufCount > batch->bufCapacity) {
+        batch->bufCapacity = bufCount;
+        batch->bufs = (uv_buf_t*) realloc(batch->bufs, sizeof(uv_buf_t) * bufCount);
+    }
+    if (framed && count * 4 > batch->headerCapacity) {
+        batch->headerCapacity = count * 4;
+        batch->headers = (char*) realloc(batch->headers, batch->headerCapacity);
+    }
+
+    u32 bytes = 0;
+    int buf = 0;
+    for (int i=0; i < count; i++) {
+        Value* msg = circa_index(&batch->payloads, i);
+        u32 size = outgoing_size(connection, msg);
+        bytes += size;
+
+        if (framed) {
+            char* header = batch->headers + i * 4;
+            size -= 4;
+            write_u32_le(header, size);
+            batch->bufs[buf++] = uv_buf_init(header, 4);
+        }
+
+        // Short strings are stored inside the Value, so this points into batch->payloads,
+        // which is left alone until after_write.
+        if (circa_is_string(msg))
+            batch->bufs[buf++] = uv_buf_init((char*) circa_string(msg), size);
+        else
+            batch->bufs[buf++] = uv_buf_init(circa_blob(msg), size);
+    }
+
+    batch->bytes = bytes;
 
-    if (uv_write(wr, stream, &outgoing_buf, 1, after_write)) {
+    if (uv_write(&batch->req, (uv_stream_t*) &connection->uv_tcp, batch->bufs, bufCount, after_write)) {
         printf("uv_write failed\n");
+        connection->pendingBytes -= bytes;
+        write_batch_release(world, batch);
     }
 }
 
 static void after_write(uv_write_t* req, int status) {
 
-    Value* msg = (Value*) req->data;
-    circa_dealloc_value(msg);
-    req->data = NULL;
+    WriteBatch* batch = (WriteBatch*) req->data;
+    uv_stream_t* stream = req->handle;
+    LibuvWorld* world = (LibuvWorld*) stream->loop->data;
+    Connection* connection = batch->connection;
+    connection->pendingBytes -= batch->bytes;
+
+    // 'req' is part of the batch, which may be freed or reused after this.
+    write_batch_release(world, batch);
+
+    if (connection->closeAfterWrite && connection->pendingBytes == 0) {
+        connection->closeAfterWrite = false;
+        connection_shutdown(stream);
+    }
 
     if (status == 0)
         return;
 
-    printf("uv_write error: %s\n", uv_err_name(uv_last_error(req->handle->loop)));
+    printf("uv_write error: %s\n", uv_err_name(uv_last_error(stream->loop)));
 
     if (status == UV_ECANCELED)
         return;
 #if 0
-    uv_close((uv_handle_t*)req->handle, on_close);
+    uv_close((uv_handle_t*)stream, on_close);
 #endif
 }
 
@@ -147,6 +554,8 @@ void make_server(Stack* stack)
 
     if (circa_string_equals(type, ":tcp")) {
         server->serverType = TCP;
+    } else if (circa_string_equals(type, ":frames")) {
+        server->serverType = FRAMES;
     } else if (circa_string_equals(type, ":websock")) {
         server->serverType = WEBSOCK;
         memset(&server->parser_settings, 0, sizeof(server->parser_settings));
@@ -159,6 +568,17 @@ void make_server(Stack* stack)
         server->parser_settings.on_body = http_on_body;
         server->parser_settings.on_message_complete = http_on_message_complete;
 
+    } else if (circa_string_equals(type, ":http")) {
+        server->serverType = HTTP;
+        memset(&server->parser_settings, 0, sizeof(server->parser_settings));
+        server->parser_settings.on_message_begin = http_request_on_message_begin;
+        server->parser_settings.on_url = http_request_on_url;
+        server->parser_settings.on_header_field = http_on_header_field;
+        server->parser_settings.on_header_value = http_on_header_value;
+        server->parser_settings.on_headers_complete = http_on_headers_complete;
+        server->parser_settings.on_body = http_request_on_body;
+        server->parser_settings.on_message_complete = http_request_on_message_complete;
+
     } else {
         Value msg;
         circa_set_string(&msg, "Unrecognized server type: ");
@@ -215,6 +635,19 @@ static void server_on_connect(uv_stream_t *uv_server, int status)
     case TCP:
         connection->state = TCP_STATE;
         break;
+    case FRAMES:
+        connection->state = FRAMES_STATE;
+        break;
+    case HTTP:
+        http_parser_init(&connection->parser, HTTP_REQUEST);
+        connection->parser.data = connection;
+        connection->state = HTTP_STATE;
+        connection->httpResponses = new HttpResponse[HTTP_MAX_PIPELINED];
+        circa_set_string(&connection->httpUrl, "");
+        circa_set_string(&connection->httpBody, "");
+        circa_set_map(&connection->httpHeaders);
+        circa_set_string(&connection->httpUnparsed, "");
+        break;
     }
 
     if (uv_accept(uv_server, (uv_stream_t*) &connection->uv_tcp) != 0)
@@ -262,41 +695,59 @@ static void try_parse(Value* str, Value* msgList)
         string_slice(str, msgStart, -1);
 }
 
+// Deliver every complete frame in the connection's ReadBuffer. Each one becomes a blob
+// slice over the buffer, no bytes are copied. Returns false if the stream has a frame
+// that is too large, in which case the connection should be closed.
+static bool frames_parse(Connection* connection)
+{
+    ReadBuffer* buffer = (ReadBuffer*) circa_native_ptr(&connection->readBuffer);
+
+    while (connection->readEnd - connection->readStart >= 4) {
+        u32 size = read_u32_le(buffer->data + connection->readStart);
+
+        if (size > FRAME_MAX_SIZE)
+            return false;
+
+        if (connection->readEnd - connection->readStart - 4 < size)
+            break;
+
+        Value* msg = circa_append(&connection->incomingMsgs);
+        circa_set_blob_slice(msg, &connection->readBuffer,
+            buffer->data + connection->readStart + 4, size);
+        connection->readStart += 4 + size;
+    }
+
+    return true;
+}
+
 static void http_write_upgrade_response(uv_stream_t* stream)
 {
-    Value* msg = circa_alloc_value();
+    Value msg;
 
-    circa_set_string(msg, "HTTP/1.1 101 Switching Protocols\r\n"
+    circa_set_string(&msg, "HTTP/1.1 101 Switching Protocols\r\n"
         "Upgrade: websocket\r\n"
         "Connection: Upgrade\r\n"
         "Sec-WebSocket-Accept: ");
     
-    circa_string_append(msg, "(responseKey)");
-    circa_string_append(msg, "\r\n\r\n");
+    circa_string_append(&msg, "(responseKey)");
+    circa_string_append(&msg, "\r\n\r\n");
 
-    circa_uv_write(stream, msg, false);
+    connection_queue_write((Connection*) stream->data, &msg);
 }
 
 static void on_read(uv_stream_t* stream,
                        ssize_t nread,
                        uv_buf_t buf)
 {
-    printf("on_read: <<%.*s\n>>", (int) nread, buf.base);
-
     if (nread < 0) {
-        if (buf.base)
-            free(buf.base);
-
-        printf("uv_shutdown\n");
-        uv_shutdown_t* req = (uv_shutdown_t*) malloc(sizeof *req);
-        uv_shutdown(req, stream, after_shutdown);
-
+        free_read_buf(stream, buf);
+        connection_shutdown(stream);
         return;
     }
 
     if (nread == 0) {
         /* Everything OK, but nothing read. */
-        free(buf.base);
+        free_read_buf(stream, buf);
         return;
     }
 
@@ -304,38 +755,57 @@ static void on_read(uv_stream_t* stream,
         internal_error("stream->data is null in on_read");
 
     Connection* connection = (Connection*) stream->data;
-    if (connection->server != NULL && connection->server->serverType == WEBSOCK) {
-
-        http_parser* parser = &connection->parser;
-
-        printf("parsing as http\n");
 
-        int parsed = http_parser_execute(parser,
-            &connection->server->parser_settings,
-            buf.base,
-            nread);
+    if (connection->state == FRAMES_STATE) {
+        // 'buf' is the free tail of connection->readBuffer.
+        connection->readEnd += nread;
 
-        if (parser->upgrade) {
-            connection->state = WEBSOCK_DUPLEX_STATE;
-            return;
+        // A frame that's too large means the stream can't be trusted, so drop it.
+        if (!frames_parse(connection)) {
+            uv_read_stop(stream);
+            connection_shutdown(stream);
         }
+        return;
+    }
 
-        if (HTTP_PARSER_ERRNO(parser) != HPE_OK) { 
+    if (connection->state == HTTP_STATE) {
+        if (connection->httpReadPaused)
+            circa_string_append_len(&connection->httpUnparsed, buf.base, nread);
+        else
+            http_execute(connection, buf.base, nread);
+        free(buf.base);
+        return;
+    }
 
-            printf("http parse error: [%s] %s\n",
-                http_errno_name(HTTP_PARSER_ERRNO(parser)),
-                http_errno_description(HTTP_PARSER_ERRNO(parser))
-            );
-            // handle parse error 
-            return; 
-        } 
+    if (connection->state == WEBSOCK_NEGOTIATE_STATE) {
+        http_parser* parser = &connection->parser;
+        const char* data = buf.base;
+        size_t remaining = nread;
+
+        // One read can hold more than one message, so keep parsing until every byte is
+        // used up.
+        while (remaining > 0) {
+            size_t parsed = http_parser_execute(parser,
+                &connection->server->parser_settings, data, remaining);
+            data += parsed;
+            remaining -= parsed;
+
+            if (parser->upgrade) {
+                // Anything after the handshake is already websocket data.
+                connection->state = WEBSOCK_DUPLEX_STATE;
+                circa_string_append_len(&connection->incomingStr, data, remaining);
+                try_parse(&connection->incomingStr, &connection->incomingMsgs);
+                break;
+            }
 
-        if (parsed < nread) {
-            printf("TODO: Handle second message?\n");
+            if (HTTP_PARSER_ERRNO(parser) != HPE_OK || parsed == 0) {
+                uv_read_stop(stream);
+                connection_shutdown(stream);
+                break;
+            }
         }
 
     } else {
-
         circa_string_append_len(&connection->incomingStr, buf.base, nread);
         try_parse(&connection->incomingStr, &connection->incomingMsgs);
     }
@@ -344,7 +814,39 @@ static void on_read(uv_stream_t* stream,
 }
 
 static void on_close(uv_handle_t* peer) {
-    free(peer);
+    // 'peer' is the uv_tcp at the start of a Connection. Take it off the flush list, its
+    // queued writes can't be sent anymore.
+    Connection* connection = (Connection*) peer->data;
+    LibuvWorld* world = (LibuvWorld*) peer->loop->data;
+
+    if (connection->flushQueued) {
+        Connection** link = &world->flushConnections;
+        while (*link != connection)
+            link = &(*link)->nextFlush;
+        *link = connection->nextFlush;
+        connection->flushQueued = false;
+    }
+
+    connection->closed = true;
+    circa_set_list(&connection->outgoing, 0);
+
+    if (connection->released) {
+        connection_delete(connection);
+        return;
+    }
+
+    // Drop the server's reference. If scripts aren't holding the connection either, this
+    // releases it (and deletes it), so it's the last thing done here.
+    if (connection->server != NULL) {
+        Value* connections = &connection->server->connections;
+        for (int i=0; i < circa_length(connections); i++) {
+            Value* wrapped = circa_index(connections, i);
+            if (circa_native_ptr(circa_index(wrapped, 0)) == connection) {
+                list_remove_index(connections, i);
+                break;
+            }
+        }
+    }
 }
 
 static void after_shutdown(uv_shutdown_t* req, int status) {
@@ -379,7 +881,15 @@ static int http_on_header_field(http_parser* parser, const char* field, size_t l
     Connection* connection = (Connection*) parser->data;
     if (!circa_is_null(&connection->httpPendingHeaderValue))
         http_flush_finished_header(connection);
-    circa_string_append_len(&connection->httpPendingHeaderField, field, len);
+
+    // Requests on an HTTP server have their header names lowercased, so scripts can
+    // look them up directly.
+    if (connection->state == HTTP_STATE) {
+        for (size_t i=0; i < len; i++)
+            circa_string_append_char(&connection->httpPendingHeaderField, tolower(field[i]));
+    } else {
+        circa_string_append_len(&connection->httpPendingHeaderField, field, len);
+    }
     return 0;
 }
 
@@ -405,6 +915,387 @@ static int http_on_message_complete(http_parser* parser) {
     return 0;
 }
 
+static Value* http_request_field(Value* request, const char* name)
+{
+    Value key;
+    circa_set_symbol(&key, name);
+    return circa_map_insert_move(request, &key);
+}
+
+static HttpResponse* http_response_slot(Connection* connection, int id)
+{
+    return &connection->httpResponses[id % HTTP_MAX_PIPELINED];
+}
+
+static int http_request_on_message_begin(http_parser* parser) {
+    Connection* connection = (Connection*) parser->data;
+    circa_set_string(&connection->httpUrl, "");
+    circa_set_string(&connection->httpBody, "");
+    circa_set_map(&connection->httpHeaders);
+    circa_set_null(&connection->httpPendingHeaderField);
+    circa_set_null(&connection->httpPendingHeaderValue);
+    return 0;
+}
+
+static int http_request_on_url(http_parser* parser, const char* field, size_t len) {
+    Connection* connection = (Connection*) parser->data;
+    circa_string_append_len(&connection->httpUrl, field, len);
+    return 0;
+}
+
+static int http_request_on_body(http_parser* parser, const char* value, size_t len) {
+    Connection* connection = (Connection*) parser->data;
+    circa_string_append_len(&connection->httpBody, value, len);
+    return 0;
+}
+
+// A whole request has been parsed. It's delivered to scripts (through Connection.receive)
+// as a Map with :id, :method, :url, :headers, :body and :keep_alive.
+static int http_request_on_message_complete(http_parser* parser) {
+    Connection* connection = (Connection*) parser->data;
+    int id = connection->httpNextRequest++;
+    bool keepAlive = http_should_keep_alive(parser) != 0;
+
+    HttpResponse* response = http_response_slot(connection, id);
+    circa_set_list(&response->pieces, 0);
+    response->started = false;
+    response->finished = false;
+    response->chunked = false;
+    response->keepAlive = keepAlive;
+    response->http10 = parser->http_major == 1 && parser->http_minor == 0;
+
+    Value* request = circa_append(&connection->incomingMsgs);
+    circa_set_map(request);
+    circa_set_int(http_request_field(request, "id"), id);
+    circa_set_string(http_request_field(request, "method"),
+        http_method_str((enum http_method) parser->method));
+    circa_move(&connection->httpUrl, http_request_field(request, "url"));
+    circa_move(&connection->httpHeaders, http_request_field(request, "headers"));
+    circa_move(&connection->httpBody, http_request_field(request, "body"));
+    circa_set_bool(http_request_field(request, "keep_alive"), keepAlive);
+
+    // Anything pipelined after a request that closes the connection is ignored.
+    if (!keepAlive)
+        connection->httpClosing = true;
+
+    if (!keepAlive || connection->httpNextRequest - connection->httpNextResponse >= HTTP_MAX_PIPELINED)
+        http_parser_pause(parser, 1);
+
+    return 0;
+}
+
+// Parse incoming bytes on an HTTP connection. If the parser pauses (see
+// http_request_on_message_complete), the rest is saved in httpUnparsed and reading stops.
+static void http_execute(Connection* connection, const char* data, size_t len)
+{
+    uv_stream_t* stream = (uv_stream_t*) &connection->uv_tcp;
+    size_t parsed = http_parser_execute(&connection->parser,
+        &connection->server->parser_settings, data, len);
+
+    enum http_errno err = HTTP_PARSER_ERRNO(&connection->parser);
+
+    if (err == HPE_PAUSED) {
+        if (!connection->httpClosing)
+            circa_string_append_len(&connection->httpUnparsed, data + parsed, len - parsed);
+
+        if (!connection->httpReadPaused) {
+            connection->httpReadPaused = true;
+            uv_read_stop(stream);
+        }
+        return;
+    }
+
+    // A malformed request can't be answered, so the connection is closed.
+    if (err != HPE_OK) {
+        uv_read_stop(stream);
+        connection_shutdown(stream);
+    }
+}
+
+// Called as responses finish. Once there is room for more pipelined requests, parse
+// whatever was held back and start reading again.
+static void http_resume_reading(Connection* connection)
+{
+    if (!connection->httpReadPaused || connection->httpClosing || connection->closing)
+        return;
+
+    if (connection->httpNextRequest - connection->httpNextResponse >= HTTP_MAX_PIPELINED)
+        return;
+
+    connection->httpReadPaused = false;
+    http_parser_pause(&connection->parser, 0);
+
+    Value unparsed;
+    circa_move(&connection->httpUnparsed, &unparsed);
+    circa_set_string(&connection->httpUnparsed, "");
+
+    http_execute(connection, circa_string(&unparsed), circa_string_length(&unparsed));
+
+    if (!connection->httpReadPaused)
+        uv_read_start((uv_stream_t*) &connection->uv_tcp, alloc_buffer, on_read);
+}
+
+static const char* http_status_text(int status)
+{
+    switch (status) {
+    case 100: return "Continue";
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    case 429: return "Too Many Requests";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    }
+    return "Unknown";
+}
+
+static void http_append_header_part(Value* out, Value* part)
+{
+    if (circa_is_string(part))
+        circa_string_append_val(out, part);
+    else if (circa_is_symbol(part))
+        circa_string_append(out, circa_symbol_text(part));
+    else {
+        Value str;
+        circa_to_string(part, &str);
+        circa_string_append_val(out, &str);
+    }
+}
+
+// Status line and headers. 'contentLength' is -1 for a streamed response.
+static void http_response_head(HttpResponse* response, int status, Value* headers,
+    int contentLength, Value* out)
+{
+    char line[64];
+    sprintf(line, "HTTP/1.1 %d ", status);
+    circa_set_string(out, line);
+    circa_string_append(out, http_status_text(status));
+    circa_string_append(out, "\r\n");
+
+    for (int i=0; i < hashtable_slot_count(headers); i++) {
+        Value* key = hashtable_key_by_index(headers, i);
+        if (key == NULL || circa_is_null(key))
+            continue;
+        http_append_header_part(out, key);
+        circa_string_append(out, ": ");
+        http_append_header_part(out, hashtable_value_by_index(headers, i));
+        circa_string_append(out, "\r\n");
+    }
+
+    if (contentLength >= 0) {
+        sprintf(line, "Content-Length: %d\r\n", contentLength);
+        circa_string_append(out, line);
+    } else if (response->chunked) {
+        circa_string_append(out, "Transfer-Encoding: chunked\r\n");
+    }
+
+    if (!response->keepAlive)
+        circa_string_append(out, "Connection: close\r\n");
+    else if (response->http10)
+        circa_string_append(out, "Connection: keep-alive\r\n");
+
+    circa_string_append(out, "\r\n");
+}
+
+// Send part of the response to request 'id', or hold it if an earlier response is
+// still in progress. 'piece' is moved.
+static void http_response_append(Connection* connection, int id, Value* piece)
+{
+    if (id == connection->httpNextResponse)
+        connection_queue_write(connection, piece);
+    else
+        circa_move(piece, circa_append(&http_response_slot(connection, id)->pieces));
+}
+
+static void http_response_finish(Connection* connection, int id)
+{
+    http_response_slot(connection, id)->finished = true;
+
+    // Retire finished responses at the head of the line, and start sending whatever the
+    // next one has produced so far.
+    while (connection->httpNextResponse < connection->httpNextRequest) {
+        HttpResponse* head = http_response_slot(connection, connection->httpNextResponse);
+        if (!head->finished)
+            break;
+
+        connection->httpNextResponse++;
+        circa_set_list(&head->pieces, 0);
+
+        if (!head->keepAlive) {
+            // If everything has already been written (like the earlier pieces of a streamed
+            // HTTP/1.0 response), there's no write left to finish, so shut down now.
+            if (connection->pendingBytes == 0)
+                connection_shutdown((uv_stream_t*) &connection->uv_tcp);
+            else
+                connection->closeAfterWrite = true;
+            return;
+        }
+
+        if (connection->httpNextResponse == connection->httpNextRequest)
+            break;
+
+        HttpResponse* next = http_response_slot(connection, connection->httpNextResponse);
+        for (int i=0; i < circa_length(&next->pieces); i++)
+            connection_queue_write(connection, circa_index(&next->pieces, i));
+        circa_set_list(&next->pieces, 0);
+    }
+
+    http_resume_reading(connection);
+}
+
+// Find the response for request 'id', which must not have been started yet (or must
+// have been, if 'started' is true). Raises an error and returns NULL if not.
+static HttpResponse* http_response_for(Stack* stack, Connection* connection, int id, bool started)
+{
+    if (connection->closing) {
+        circa_output_error(stack, "Connection is closed");
+        return NULL;
+    }
+
+    if (connection->state != HTTP_STATE) {
+        circa_output_error(stack, "Not an HTTP connection");
+        return NULL;
+    }
+
+    if (id < connection->httpNextResponse || id >= connection->httpNextRequest) {
+        circa_output_error(stack, "No pending HTTP request with that id");
+        return NULL;
+    }
+
+    HttpResponse* response = http_response_slot(connection, id);
+    if (response->finished || response->started != started) {
+        circa_output_error(stack, started
+            ? "HTTP response was not started with respond_start"
+            : "HTTP response was already started");
+        return NULL;
+    }
+
+    return response;
+}
+
+// Payload as a string or blob that can be written as-is.
+static void http_body_payload(Value* body, Value* payload)
+{
+    if (circa_is_string(body) || circa_is_blob(body))
+        circa_copy(body, payload);
+    else if (circa_is_null(body))
+        circa_set_string(payload, "");
+    else
+        circa_to_string(body, payload);
+}
+
+static int payload_size(Value* payload)
+{
+    if (circa_is_string(payload))
+        return circa_string_length(payload);
+    return circa_blob_size(payload);
+}
+
+void Connection__respond(Stack* stack)
+{
+    Connection* connection = (Connection*) circa_native_ptr(circa_index(circa_input(stack, 0), 0));
+    int id = circa_int(circa_input(stack, 1));
+    HttpResponse* response = http_response_for(stack, connection, id, false);
+    if (response == NULL)
+        return;
+
+    Value body;
+    http_body_payload(circa_input(stack, 4), &body);
+
+    Value head;
+    http_response_head(response, circa_int(circa_input(stack, 2)), circa_input(stack, 3),
+        payload_size(&body), &head);
+
+    // Head and body are separate buffers in the same write.
+    http_response_append(connection, id, &head);
+    if (payload_size(&body) > 0)
+        http_response_append(connection, id, &body);
+    http_response_finish(connection, id);
+}
+
+void Connection__respond_start(Stack* stack)
+{
+    Connection* connection = (Connection*) circa_native_ptr(circa_index(circa_input(stack, 0), 0));
+    int id = circa_int(circa_input(stack, 1));
+    HttpResponse* response = http_response_for(stack, connection, id, false);
+    if (response == NULL)
+        return;
+
+    // HTTP/1.0 has no chunked encoding; the body is sent raw and ended by closing the
+    // connection.
+    response->started = true;
+    if (response->http10)
+        response->keepAlive = false;
+    else
+        response->chunked = true;
+
+    Value head;
+    http_response_head(response, circa_int(circa_input(stack, 2)), circa_input(stack, 3),
+        -1, &head);
+    http_response_append(connection, id, &head);
+}
+
+void Connection__respond_chunk(Stack* stack)
+{
+    Connection* connection = (Connection*) circa_native_ptr(circa_index(circa_input(stack, 0), 0));
+    int id = circa_int(circa_input(stack, 1));
+    HttpResponse* response = http_response_for(stack, connection, id, true);
+    if (response == NULL)
+        return;
+
+    Value data;
+    http_body_payload(circa_input(stack, 2), &data);
+
+    // An empty chunk would end the response.
+    int size = payload_size(&data);
+    if (size == 0)
+        return;
+
+    if (!response->chunked) {
+        http_response_append(connection, id, &data);
+        return;
+    }
+
+    char line[16];
+    sprintf(line, "%x\r\n", size);
+
+    Value prefix;
+    Value suffix;
+    circa_set_string(&prefix, line);
+    circa_set_string(&suffix, "\r\n");
+    http_response_append(connection, id, &prefix);
+    http_response_append(connection, id, &data);
+    http_response_append(connection, id, &suffix);
+}
+
+void Connection__respond_end(Stack* stack)
+{
+    Connection* connection = (Connection*) circa_native_ptr(circa_index(circa_input(stack, 0), 0));
+    int id = circa_int(circa_input(stack, 1));
+    HttpResponse* response = http_response_for(stack, connection, id, true);
+    if (response == NULL)
+        return;
+
+    if (response->chunked) {
+        Value last;
+        circa_set_string(&last, "0\r\n\r\n");
+        http_response_append(connection, id, &last);
+    }
+    http_response_finish(connection, id);
+}
+
 void Server__connections(Stack* stack)
 {
     Server* server = (Server*) circa_native_ptr(circa_index(circa_input(stack, 0), 0));
@@ -435,6 +1326,10 @@ void make_client(Stack* stack)
 
     Value* ip = circa_input(stack, 0);
     Value* port = circa_input(stack, 1);
+    Value* type = circa_input(stack, 2);
+
+    if (circa_string_equals(type, ":frames"))
+        connection->state = FRAMES_STATE;
 
     sockaddr_in bind_addr = uv_ip4_addr(circa_string(ip), circa_int(port));
 #if 0
@@ -459,9 +1354,61 @@ void Connection__send(Stack* stack)
 {
     Connection* connection = (Connection*) circa_native_ptr(circa_index(circa_input(stack, 0), 0));
 
-    Value* asStr = circa_alloc_value();
-    circa_to_string(circa_input(stack, 1), asStr);
-    circa_uv_write((uv_stream_t*) &connection->uv_tcp, asStr, true);
+    Value* msg = circa_input(stack, 1);
+
+    // Framed connections send strings and blobs as-is, and anything else in the binary
+    // format (see circa_to_binary). Other connections send the string repr, followed by
+    // a NUL that separates messages (as try_parse expects on the other end). Raw
+    // protocol writes, like the websocket handshake and HTTP responses, don't go
+    // through here and aren't NUL-terminated.
+    Value payload;
+    if (connection->state != FRAMES_STATE) {
+        circa_to_string(msg, &payload);
+        if (connection->state != HTTP_STATE)
+            circa_string_append_len(&payload, "", 1);
+    } else if (circa_is_string(msg) || circa_is_blob(msg))
+        circa_copy(msg, &payload);
+    else {
+        circa_to_binary(msg, &payload);
+        if (!circa_is_blob(&payload)) {
+            circa_output_error_val(stack, &payload);
+            return;
+        }
+    }
+
+    if (connection->closing || connection_over_write_limit(connection)) {
+        circa_set_bool(circa_output(stack, 0), false);
+        return;
+    }
+
+    connection_queue_write(connection, &payload);
+    circa_set_bool(circa_output(stack, 0), true);
+}
+
+void Connection__outgoing_queue(Stack* stack)
+{
+    Connection* connection = (Connection*) circa_native_ptr(circa_index(circa_input(stack, 0), 0));
+    circa_copy(&connection->outgoing, circa_output(stack, 0));
+}
+
+void Connection__pending_bytes(Stack* stack)
+{
+    Connection* connection = (Connection*) circa_native_ptr(circa_index(circa_input(stack, 0), 0));
+    circa_set_int(circa_output(stack, 0), connection->pendingBytes);
+}
+
+void Connection__set_write_limit(Stack* stack)
+{
+    Connection* connection = (Connection*) circa_native_ptr(circa_index(circa_input(stack, 0), 0));
+    int limit = circa_int(circa_input(stack, 1));
+    connection->writeLimit = limit > 0 ? limit : 0;
+}
+
+void Connection__writable(Stack* stack)
+{
+    Connection* connection = (Connection*) circa_native_ptr(circa_index(circa_input(stack, 0), 0));
+    circa_set_bool(circa_output(stack, 0),
+        !connection->closing && !connection_over_write_limit(connection));
 }
 
 void Connection__receive(Stack* stack)
@@ -477,6 +1424,12 @@ LibuvWorld* alloc_libuv_world()
 {
     LibuvWorld* state = new LibuvWorld();
     state->uv_loop = uv_loop_new();
+    state->uv_loop->data = state;
+    state->freeReadBuffers = NULL;
+    state->freeReadBufferCount = 0;
+    state->freeWriteBatches = NULL;
+    state->freeWriteBatchCount = 0;
+    state->flushConnections = NULL;
     return state;
 }
 
@@ -485,15 +1438,34 @@ void libuv_native_patch(caWorld* world)
     caNativePatch* socket = circa_create_native_patch(world, "socket");
     circa_patch_function(socket, "make_server", make_server);
     circa_patch_function(socket, "Server.connections", Server__connections);
-    circa_patch_function(socket, "make_tcp_client", make_client);
-    circa_patch_function(socket, "make_tcp_client", make_client);
+    circa_patch_function(socket, "make_client", make_client);
     circa_patch_function(socket, "Connection.send", Connection__send);
     circa_patch_function(socket, "Connection.receive", Connection__receive);
+    circa_patch_function(socket, "Connection.outgoing_queue", Connection__outgoing_queue);
+    circa_patch_function(socket, "Connection.pending_bytes", Connection__pending_bytes);
+    circa_patch_function(socket, "Connection.set_write_limit", Connection__set_write_limit);
+    circa_patch_function(socket, "Connection.writable", Connection__writable);
+    circa_patch_function(socket, "Connection.respond", Connection__respond);
+    circa_patch_function(socket, "Connection.respond_start", Connection__respond_start);
+    circa_patch_function(socket, "Connection.respond_chunk", Connection__respond_chunk);
+    circa_patch_function(socket, "Connection.respond_end", Connection__respond_end);
     circa_finish_native_patch(socket);
 }
 
 void libuv_process_events(LibuvWorld* libuvWorld)
 {
+    // Send everything that scripts queued since the last tick.
+    Connection* connection = libuvWorld->flushConnections;
+    libuvWorld->flushConnections = NULL;
+
+    while (connection != NULL) {
+        Connection* next = connection->nextFlush;
+        connection->flushQueued = false;
+        connection->nextFlush = NULL;
+        connection_flush(connection);
+        connection = next;
+    }
+
     uv_run(libuvWorld->uv_loop, UV_RUN_NOWAIT);
 }
 
@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <mutex>
 
 #include "perlin.h"
 #include "rand.h"
@@ -23,9 +24,12 @@ void init_permutation_table()
     }
 }
 
+static std::once_flag g_permsInitialized;
+
 void perlin_init()
 {
-    init_permutation_table();
+    // Every World calls this, possibly from different threads.
+    std::call_once(g_permsInitialized, init_permutation_table);
 }
 
 static inline float fade( float t ) { return t * t * t * (t * (t * 6 - 15) + 10); }
@@ -5,6 +5,8 @@
 
 #include "blob.h"
 #include "debug.h"
+#include "hashtable.h"
+#include "list.h"
 #include "string_type.h"
 #include "tagged_value.h"
 #include "read_tar.h"
@@ -61,14 +63,6 @@ static const char* file_name(char* data)
     return header->name;
 }
 
-static void file_copy_contents(char* data, Value* out)
-{
-    int size = file_size(data);
-    char* file = data + 512;
-    set_blob(out, size);
-    memcpy(blob_data_flat(out), file, size);
-}
-
 static void advance_to_next_file(char** data)
 {
     int size = file_size(*data);
@@ -84,47 +78,106 @@ static bool eof(char* data)
     return file_name(data)[0] == 0;
 }
 
-void tar_read_file(Value* tarBlob, const char* filename, Value* fileOut)
+// Full name of the entry at 'data'. Names of exactly 100 characters aren't
+// NULL-terminated, and ustar archives can store a path prefix separately.
+static void file_full_name(char* data, Value* nameOut)
 {
-    ca_assert(is_string(tarBlob));
-    char* data = blob_data_flat(tarBlob);
+    TarHeader* header = (TarHeader*) data;
 
-    while (!eof(data)) {
-        if (strcmp(file_name(data), filename) == 0) {
-            file_copy_contents(data, fileOut);
-            return;
+    if (memcmp(header->magic, "ustar", 5) == 0 && header->prefix[0] != 0) {
+        set_string(nameOut, header->prefix, strnlen(header->prefix, sizeof(header->prefix)));
+        string_append(nameOut, "/");
+        string_append_len(nameOut, header->name, strnlen(header->name, sizeof(header->name)));
+    } else {
+        set_string(nameOut, header->name, strnlen(header->name, sizeof(header->name)));
+    }
+}
+
+static bool is_regular_file(char* data)
+{
+    char type = ((TarHeader*) data)->typeflag;
+    return type == '0' || type == 0 || type == '7';
+}
+
+void tar_build_index(Value* tarBlob, Value* indexOut)
+{
+    set_hashtable(indexOut);
+
+    char* start = blob_data_flat(tarBlob);
+    u32 size = blob_size(tarBlob);
+    u32 offset = 0;
+
+    // Set by a GNU long name entry ('L'), for the entry that follows it.
+    Value longName;
+
+    while (offset + 512 <= size && !eof(start + offset)) {
+        char* header = start + offset;
+        u32 contentsSize = file_size(header);
+
+        // Stop at a truncated archive rather than reading past the end.
+        if (contentsSize > size - offset - 512)
+            break;
+
+        char type = ((TarHeader*) header)->typeflag;
+
+        if (type == 'L') {
+            set_string(&longName, header + 512, strnlen(header + 512, contentsSize));
+        } else {
+            if (is_regular_file(header)) {
+                Value name;
+                if (is_null(&longName))
+                    file_full_name(header, &name);
+                else
+                    move(&longName, &name);
+
+                // Like the old linear search, the first entry with a given name wins.
+                if (hashtable_get(indexOut, &name) == NULL) {
+                    Value* entry = hashtable_insert(indexOut, &name, true);
+                    set_list(entry, 2);
+                    set_int(list_get(entry, 0), offset + 512);
+                    set_int(list_get(entry, 1), contentsSize);
+                }
+            }
+            set_null(&longName);
         }
 
-        advance_to_next_file(&data);
+        advance_to_next_file(&header);
+        offset = header - start;
     }
-
-    set_null(fileOut);
 }
 
-bool tar_file_exists(Value* tarBlob, const char* filename)
+void tar_read_file(Value* tarBlob, Value* index, Value* filename, Value* fileOut)
 {
-    char* data = blob_data_flat(tarBlob);
-    while (!eof(data)) {
-        if (strcmp(file_name(data), filename) == 0)
-            return true;
-        advance_to_next_file(&data);
+    Value* entry = hashtable_get(index, filename);
+    if (entry == NULL) {
+        set_null(fileOut);
+        return;
     }
-    return false;
+
+    // The contents are a slice that keeps the tarball alive, nothing is copied.
+    char* data = blob_data_flat(tarBlob) + as_int(list_get(entry, 0));
+    set_blob_slice(fileOut, tarBlob, data, as_int(list_get(entry, 1)));
+}
+
+bool tar_file_exists(Value* index, Value* filename)
+{
+    return hashtable_get(index, filename) != NULL;
 }
 
 CIRCA_EXPORT void circa_load_tar_in_memory(World* world, char* data, uint32_t numBytes)
 {
-    char* dataStart = data;
+    // The caller keeps ownership of 'data', so it's copied once, and each file is a
+    // slice of the copy.
+    Value tarball;
+    set_blob_flat(&tarball, data, numBytes);
 
-    while (!eof(data) && (data - dataStart) < numBytes) {
-        Value filename;
-        set_string(&filename, file_name(data));
+    Value index;
+    tar_build_index(&tarball, &index);
 
+    for (HashtableIterator it(&index); it; ++it) {
         Value contents;
-        file_copy_contents(data, &contents);
-
-        circa_load_file_in_memory(world, &filename, &contents);
-        advance_to_next_file(&data);
+        tar_read_file(&tarball, &index, it.key(), &contents);
+        circa_load_file_in_memory(world, it.key(), &contents);
     }
 }
 
@@ -4,8 +4,13 @@
 
 namespace circa {
 
-void tar_read_file(Value* tarBlob, const char* filename, Value* fileOut);
-bool tar_file_exists(Value* tarBlob, const char* filename);
+// Build a map from each file name in the tarball to its [offset, size]. Lookups
+// with the functions below use this index, instead of scanning the archive.
+void tar_build_index(Value* tarBlob, Value* indexOut);
+
+// Contents are returned as a Blob slice that references 'tarBlob'.
+void tar_read_file(Value* tarBlob, Value* index, Value* filename, Value* fileOut);
+bool tar_file_exists(Value* index, Value* filename);
 void tar_debug_dump_listing(Value* tarBlob);
 
 } // namespace circa
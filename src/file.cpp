@@ -7,8 +7,15 @@
 #include <fstream>
 #include <sys/stat.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "blob.h"
 #include "list.h"
+#include "native_ptr.h"
 #include "string_type.h"
 #include "tagged_value.h"
 #include "type.h"
@@ -219,4 +226,70 @@ void read_text_file(const char* filename, Value* contentsOut)
     fclose(fp);
 }
 
+#ifndef _WIN32
+
+struct FileMapping {
+    void* addr;
+    size_t size;
+};
+
+static void file_mapping_release(void* ptr)
+{
+    FileMapping* mapping = (FileMapping*) ptr;
+    munmap(mapping->addr, mapping->size);
+    delete mapping;
+}
+
+void read_file_mapped(const char* filename, Value* contentsOut)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        set_null(contentsOut);
+        return;
+    }
+
+    struct stat s;
+    if (fstat(fd, &s) != 0 || !S_ISREG(s.st_mode) || (u64) s.st_size > 0xffffffff) {
+        close(fd);
+        set_null(contentsOut);
+        return;
+    }
+
+    // mmap can't map an empty file.
+    if (s.st_size == 0) {
+        close(fd);
+        set_blob(contentsOut, 0);
+        return;
+    }
+
+    void* addr = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    // Some filesystems don't support mapping.
+    if (addr == MAP_FAILED) {
+        read_text_file(filename, contentsOut);
+        return;
+    }
+
+    FileMapping* mapping = new FileMapping();
+    mapping->addr = addr;
+    mapping->size = s.st_size;
+
+    // The mapping is owned by a native_ptr, which the slice holds on to. It's unmapped
+    // when the last value referencing it is released.
+    Value owner;
+    set_native_ptr(&owner, mapping, file_mapping_release);
+    set_blob_slice(contentsOut, &owner, (char*) addr, (u32) s.st_size);
+}
+
+#else
+
+void read_file_mapped(const char* filename, Value* contentsOut)
+{
+    // Future: Windows support, with CreateFileMapping.
+    read_text_file(filename, contentsOut);
+}
+
+#endif
+
 } // namespace "circa"
@@ -6,6 +6,13 @@ namespace circa {
 
 // File reading
 void read_text_file(const char* filename, Value* contentsOut);
+
+// Map the file into memory. 'contentsOut' is a Blob slice over the mapping, which is
+// unmapped once every value referencing it is released. If the file is truncated on
+// disk while mapped, reading past the new end will crash, so this is meant for data
+// files that aren't rewritten in place.
+void read_file_mapped(const char* filename, Value* contentsOut);
+
 int file_get_mtime(const char* filename);
 bool file_exists(const char* filename);
 
@@ -26,7 +26,7 @@ namespace circa {
 //   [:filesystem, rootDir : String]
 //
 // Tarball backed:
-//   [:tarball, contents : Blob]
+//   [:tarball, contents : Blob, index : Hashtable(filename : String -> [offset, size])]
 
 
 static bool file_source_is_map(Value* file_source)
@@ -50,7 +50,10 @@ static bool file_source_is_tarball_backed(Value* file_source)
         && (as_symbol(list_get(file_source, 0)) == s_Tarball);
 }
 
-void file_source_read_file(Value* file_source, Value* name, Value* contents)
+// If 'mapped' is set, then a filesystem-backed source maps the file instead of reading it.
+// That's only done when the caller asks, since truncating a mapped file (such as a script
+// being rewritten by an editor) makes later reads of the mapping fault.
+static void file_source_read(Value* file_source, Value* name, Value* contents, bool mapped)
 {
     if (file_source_is_map(file_source)) {
         Value* entry = hashtable_get(file_source, name);
@@ -66,18 +69,32 @@ void file_source_read_file(Value* file_source, Value* name, Value* contents)
         Value* rootDir = list_get(file_source, 1);
         copy(rootDir, &fullPath);
         join_path(&fullPath, name);
-        read_text_file(as_cstring(&fullPath), contents);
+
+        if (mapped)
+            read_file_mapped(as_cstring(&fullPath), contents);
+        else
+            read_text_file(as_cstring(&fullPath), contents);
         return;
     }
 
     else if (file_source_is_tarball_backed(file_source)) {
         Value* tarball = list_get(file_source, 1);
-        tar_read_file(tarball, as_cstring(name), contents);
+        tar_read_file(tarball, list_get(file_source, 2), name, contents);
         return;
     }
     internal_error("file_source_read_file: file_source type not recognized");
 }
 
+void file_source_read_file(Value* file_source, Value* name, Value* contents)
+{
+    file_source_read(file_source, name, contents, false);
+}
+
+void file_source_read_file_mapped(Value* file_source, Value* name, Value* contents)
+{
+    file_source_read(file_source, name, contents, true);
+}
+
 bool file_source_does_file_exist(Value* file_source, Value* name)
 {
     if (file_source_is_map(file_source)) {
@@ -91,8 +108,7 @@ bool file_source_does_file_exist(Value* file_source, Value* name)
         return file_exists(as_cstring(&fullPath));
     }
     else if (file_source_is_tarball_backed(file_source)) {
-        Value* tarball = list_get(file_source, 1);
-        return tar_file_exists(tarball, as_cstring(name));
+        return tar_file_exists(list_get(file_source, 2), name);
     }
     internal_error("file_source_does_file_exist: file_source type not recognized");
     return false;
@@ -131,12 +147,14 @@ void file_source_create_using_filesystem(Value* file_source, const char* rootDir
 
 void file_source_create_from_tarball(Value* file_source, Value* blob)
 {
-    set_list(file_source, 2);
+    set_list(file_source, 3);
     set_symbol(list_get(file_source, 0), s_Tarball);
     set_value(list_get(file_source, 1), blob);
+    tar_build_index(blob, list_get(file_source, 2));
 }
 
-CIRCA_EXPORT void circa_read_file(caWorld* world, const char* filename, Value* contentsOut)
+static void read_file_from_sources(caWorld* world, const char* filename, Value* contentsOut,
+    bool mapped)
 {
     Value name;
     set_string(&name, filename);
@@ -150,7 +168,7 @@ CIRCA_EXPORT void circa_read_file(caWorld* world, const char* filename, Value* c
     Value* fileSources = &world->fileSources;
     for (int i=list_length(fileSources) - 1; i >= 0; i--) {
         Value* file_source = list_get(fileSources, i);
-        file_source_read_file(file_source, &name, contentsOut);
+        file_source_read(file_source, &name, contentsOut, mapped);
         if (!is_null(contentsOut))
             return;
     }
@@ -158,6 +176,16 @@ CIRCA_EXPORT void circa_read_file(caWorld* world, const char* filename, Value* c
     set_null(contentsOut);
 }
 
+CIRCA_EXPORT void circa_read_file(caWorld* world, const char* filename, Value* contentsOut)
+{
+    read_file_from_sources(world, filename, contentsOut, false);
+}
+
+CIRCA_EXPORT void circa_read_file_mapped(caWorld* world, const char* filename, Value* contentsOut)
+{
+    read_file_from_sources(world, filename, contentsOut, true);
+}
+
 CIRCA_EXPORT void circa_read_file_with_vm(VM* vm, const char* filename, Value* contentsOut)
 {
     return ::circa_read_file(vm->world, filename, contentsOut);
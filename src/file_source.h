@@ -5,10 +5,14 @@
 namespace circa {
 
 // FileSource reading.
-Value* file_source_read_file(Value* file_source, Value* name);
+void file_source_read_file(Value* file_source, Value* name, Value* contents);
 bool file_source_does_file_exist(Value* file_source, Value* name);
 int file_source_get_file_version(Value* file_source, Value* name);
 
+// Like file_source_read_file, but filesystem-backed sources map the file instead of
+// copying it. Only for files that won't be truncated while the result is alive.
+void file_source_read_file_mapped(Value* file_source, Value* name, Value* contents);
+
 // FileSource creation.
 void file_source_create_using_filesystem(Value* file_source, const char* rootDir);
 void file_source_create_from_tarball(Value* file_source, Value* tarball);
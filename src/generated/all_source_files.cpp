@@ -1,3 +1,4 @@
+#include "../binary_repr.cpp"
 #include "../blob.cpp"
 #include "../block.cpp"
 #include "../building.cpp"
@@ -43,6 +44,7 @@
 #include "../type.cpp"
 #include "../type_inference.cpp"
 #include "../vm.cpp"
+#include "../worker_pool.cpp"
 #include "../world.cpp"
 #include "../command_line/command_line.cpp"
 #include "../command_line/command_line_main.cpp"
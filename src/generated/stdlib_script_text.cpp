@@ -66,6 +66,11 @@ const char* find_builtin_file(const char* filename) {
         "    case 0x2 :func_call_d\n"
         "    case 0x39 :func_apply_d\n"
         "    case 0x38 :dyn_method\n"
+        "    case 0x48 :uncompiled_copy_call\n"
+        "    case 0x49 :uncompiled_move_call\n"
+        "    case 0x4a :copy_call\n"
+        "    case 0x4b :move_call\n"
+        "    case 0x19 :guard_types\n"
         "    case 0x4 :jump\n"
         "    case 0x30 :jif\n"
         "    case 0x31 :jnif\n"
@@ -93,6 +98,20 @@ const char* find_builtin_file(const char* filename) {
         "    case 0x21 :sub_i\n"
         "    case 0x22 :mult_i\n"
         "    case 0x23 :div_i\n"
+        "    case 0x2a :add_i_imm\n"
+        "    case 0x2b :sub_i_imm\n"
+        "    case 0x2c :lt_i\n"
+        "    case 0x2d :lte_i\n"
+        "    case 0x2e :gt_i\n"
+        "    case 0x2f :gte_i\n"
+        "    case 0x50 :add_f\n"
+        "    case 0x51 :sub_f\n"
+        "    case 0x52 :mult_f\n"
+        "    case 0x53 :div_f\n"
+        "    case 0x54 :lt_f\n"
+        "    case 0x55 :lte_f\n"
+        "    case 0x56 :gt_f\n"
+        "    case 0x57 :gte_f\n"
         "    case 0x35 :push_state_frame\n"
         "    case 0x47 :push_state_frame_dkey\n"
         "    case 0x36 :pop_state_frame\n"
@@ -114,6 +133,8 @@ const char* find_builtin_file(const char* filename) {
         "    case 7 :minor_block_end\n"
         "    case 8 :state_key\n"
         "    case 9 :state_header\n"
+        "    case 10 :inline_start\n"
+        "    case 11 :inline_end\n"
         "    else\n"
         "      error('mopcode not found: ' mopcode)\n"
         "\n"
@@ -992,11 +1013,29 @@ const char* find_builtin_file(const char* filename) {
         "def ServerRequest.reply(self, msg)\n"
         "  self.conn.send(msg)\n"
         "\n"
+        "-- For HTTP servers, 'data' is the request Map (see make_http_server).\n"
+        "def ServerRequest.respond(self, int status, Table headers, any body)\n"
+        "  self.conn.respond(self.data.id status headers body)\n"
+        "def ServerRequest.respond_start(self, int status, Table headers)\n"
+        "  self.conn.respond_start(self.data.id status headers)\n"
+        "def ServerRequest.respond_chunk(self, any data)\n"
+        "  self.conn.respond_chunk(self.data.id data)\n"
+        "def ServerRequest.respond_end(self)\n"
+        "  self.conn.respond_end(self.data.id)\n"
+        "\n"
         "def make_server(String ip, int port, Symbol t) -> Server\n"
         "def make_tcp_server(String ip, int port) -> Server\n"
         "  make_server(ip port :tcp)\n"
         "def make_websock_server(String ip, int port) -> Server\n"
         "  make_server(ip port :websock)\n"
+        "def make_frame_server(String ip, int port) -> Server\n"
+        "  -- Connections use length-prefixed frames. Received messages are Blobs.\n"
+        "  make_server(ip port :frames)\n"
+        "def make_http_server(String ip, int port) -> Server\n"
+        "  -- HTTP/1.1 with keep-alive and pipelining. Each received message is a request Map\n"
+        "  -- with :id, :method, :url, :headers (names lowercased), :body and :keep_alive.\n"
+        "  -- Responses can be given in any order, and are sent in request order.\n"
+        "  make_server(ip port :http)\n"
         "\n"
         "def Server.connections(self) -> List\n"
         "\n"
@@ -1008,9 +1047,27 @@ const char* find_builtin_file(const char* filename) {
         "      @reqs.append(ServerRequest.make(c msg))\n"
         "  reqs\n"
         "\n"
+        "def make_client(String ip, int port, Symbol t) -> Connection\n"
         "def make_tcp_client(String ip, int port) -> Connection\n"
-        "def Connection.send(self, any msg)\n"
+        "  make_client(ip port :tcp)\n"
+        "def make_frame_client(String ip, int port) -> Connection\n"
+        "  make_client(ip port :frames)\n"
+        "def Connection.send(self, any msg) -> bool\n"
+        "  -- Messages are queued and sent together at the end of the tick. Returns false (and\n"
+        "  -- drops the message) if the connection is over its write limit.\n"
         "def Connection.outgoing_queue(self) -> List\n"
+        "def Connection.pending_bytes(self) -> int\n"
+        "  -- Bytes that are queued or still being written.\n"
+        "def Connection.set_write_limit(self, int bytes)\n"
+        "  -- Refuse sends while pending_bytes is at or above 'bytes'. 0 means no limit.\n"
+        "def Connection.writable(self) -> bool\n"
+        "\n"
+        "def Connection.respond(self, int id, int status, Table headers, any body)\n"
+        "  -- Complete HTTP response, with a Content-Length.\n"
+        "def Connection.respond_start(self, int id, int status, Table headers)\n"
+        "  -- Start a chunked HTTP response. Follow with respond_chunk calls and respond_end.\n"
+        "def Connection.respond_chunk(self, int id, any data)\n"
+        "def Connection.respond_end(self, int id)\n"
         "def Connection.receive(self) -> List\n"
         "def Connection.is_open(self) -> bool\n"
         ;
@@ -2546,14 +2603,60 @@ const char* find_builtin_file(const char* filename) {
         "def file_exists(String filename) -> bool\n"
         "def file_version(String filename) -> int\n"
         "def file_read_text(String filename) -> String\n"
+        "def file_read_mapped(String filename) -> Blob\n"
+        "  -- Memory-map the file. The Blob reads straight from the mapping, without copying.\n"
         "def file_changed(String filename) -> bool\n"
         "  ver = file_version(filename)\n"
         "  changed([filename ver])\n"
+        "def tar_index(Blob tarball) -> Table\n"
+        "  -- Map each regular file in the tarball to its [offset, size].\n"
+        "def tar_read(Blob tarball, Table index, String filename) -> Blob\n"
+        "  -- The file's contents, as a slice of the tarball.\n"
         "\n"
         "-- Sys module\n"
         "def sys_arg(int index) -> String\n"
         "def sys_module_search_paths() -> List\n"
         "\n"
+        "-- Worker pools\n"
+        "struct WorkerPool {\n"
+        "  native_ptr native\n"
+        "}\n"
+        "\n"
+        "def worker_pool(int threadCount) -> WorkerPool\n"
+        "  -- Start a pool of worker threads. Each thread has its own World, so values are\n"
+        "  -- copied when they are sent to or from a worker.\n"
+        "def WorkerPool.spawn(self, String filename, String functionName) -> int\n"
+        "  -- Create an instance that runs the given function, on one of the pool's threads.\n"
+        "  -- Returns the instance id.\n"
+        "def WorkerPool.call(self, int instance, List inputs)\n"
+        "  -- Queue a call to an instance. The result is fetched with receive().\n"
+        "def WorkerPool.receive(self) -> any\n"
+        "  -- Wait for a call to finish. Returns [instance, :success, output] or\n"
+        "  -- [instance, :error, message]. Returns nil if no calls are pending.\n"
+        "def WorkerPool.kill(self, int instance)\n"
+        "def on_worker_thread() -> bool\n"
+        "  -- True when running on one of a worker pool's threads.\n"
+        "\n"
+        "-- JSON\n"
+        "def parse_json(String text) -> any\n"
+        "  -- Objects become Tables with String keys, and numbers are ints when they have no\n"
+        "  -- fraction or exponent.\n"
+        "def to_json(any val) -> String\n"
+        "\n"
+        "struct JsonStream {\n"
+        "  native_ptr native\n"
+        "}\n"
+        "\n"
+        "def json_stream(bool arrayElements) -> JsonStream\n"
+        "  -- Start an incremental JSON parser, for input that arrives in chunks. If arrayElements\n"
+        "  -- is true then the input is one or more arrays, and each element is returned on its\n"
+        "  -- own. Otherwise each top-level value is returned.\n"
+        "def JsonStream.push(self, any chunk) -> List\n"
+        "  -- Add a String or Blob of input. Returns the values that this chunk completed.\n"
+        "def JsonStream.finish(self) -> List\n"
+        "  -- Mark the end of the input. Returns any values completed by the end, such as a\n"
+        "  -- trailing number. Afterwards the stream can be used for new input.\n"
+        "\n"
         "def make_blob(int size) -> Blob\n"
         "def Blob.size(self) -> int\n"
         "def Blob.resize(self, int len) -> Blob\n"
@@ -2583,6 +2686,19 @@ const char* find_builtin_file(const char* filename) {
         "def Blob.f32(self, int offset) -> number\n"
         "def Blob.f64(self, int offset) -> number\n"
         "\n"
+        "-- Binary format\n"
+        "def to_binary(any value) -> Blob\n"
+        "  -- Encode a value (made of numbers, bools, strings, symbols, blobs, lists, tables and\n"
+        "  -- structs) in a compact binary form.\n"
+        "def from_binary(Blob blob) -> any\n"
+        "  -- Decode a value that was encoded with to_binary.\n"
+        "def binary_get(Blob blob, List path) -> any\n"
+        "  -- Decode just the value found by following 'path' (a list of list indexes and table\n"
+        "  -- keys) into an encoded value. The rest of the encoding isn't decoded.\n"
+        "def binary_length(Blob blob, List path) -> int\n"
+        "  -- Length of the list, table, string or blob at 'path' in an encoded value, without\n"
+        "  -- decoding it. Returns -1 if there isn't one.\n"
+        "\n"
         "def Blob.from_string(self, String s) -> Blob\n"
         "  -- TODO: Propertly handle encoding\n"
         "  blob = make_blob(0)\n"
@@ -2832,6 +2948,9 @@ const char* find_builtin_file(const char* filename) {
         "def VM.toString(self) -> String\n"
         "\n"
         "def VM.perf_stats(self) -> Table\n"
+        "def perf_stats_enabled() -> bool\n"
+        "  -- False if this build doesn't track perf stats (release builds, by default). Then\n"
+        "  -- VM.perf_stats is always empty.\n"
         "\n"
         "def make_vm(Func func) -> VM\n"
         "  -- Create a new VM\n"
@@ -3007,6 +3126,41 @@ const char* find_builtin_file(const char* filename) {
         "      @result.append(i)\n"
         "  result\n"
         "\n"
+        "def List._par_apply(self, Func func, Symbol op) -> List\n"
+        "  -- Runs map/filter/reduce over chunks of the list on worker threads. Returns [result],\n"
+        "  -- or [] if the call should run sequentially.\n"
+        "\n"
+        "def List.par_map(self, Func func) -> List\n"
+        "  -- Like map(), but the list is split into chunks which run on worker threads. Runs\n"
+        "  -- sequentially if the list is small, or if 'func' has state or effects.\n"
+        "  result = self._par_apply(func :map)\n"
+        "  if result.empty\n"
+        "    self.map(func)\n"
+        "  else\n"
+        "    result.first\n"
+        "\n"
+        "def List.par_filter(self, Func func) -> List\n"
+        "  -- Like filter(), but the list is split into chunks which run on worker threads.\n"
+        "  result = self._par_apply(func :filter)\n"
+        "  if result.empty\n"
+        "    self.filter(func)\n"
+        "  else\n"
+        "    result.first\n"
+        "\n"
+        "def List.par_reduce(self, Func func, initial) -> any\n"
+        "  -- Combine the items with func(accumulated, item), starting with 'initial'. The chunks\n"
+        "  -- are reduced on worker threads and then combined in order, so 'func' should be\n"
+        "  -- associative.\n"
+        "  items = self\n"
+        "  partials = self._par_apply(func :reduce)\n"
+        "  if not(partials.empty)\n"
+        "    items = partials.first\n"
+        "\n"
+        "  result = initial\n"
+        "  for item in items\n"
+        "    result = func.call(result item)\n"
+        "  result\n"
+        "\n"
         "def List.flatten(self) -> List\n"
         "  -- Take a list of lists, and concat them all into one list.\n"
         "  out = []\n"
@@ -3140,6 +3294,10 @@ const char* find_builtin_file(const char* filename) {
         "\n"
         "def String.to_number(self) -> number\n"
         "def String.to_int(self) -> int\n"
+        "def String.to_symbol(self) -> Symbol\n"
+        "\n"
+        "def Symbol.id(self) -> int\n"
+        "  -- The symbol's number. Symbols with the same text have the same id, in every thread.\n"
         "\n"
         "def String.characters(self) -> List\n"
         "    out = for i in 0..(self.length)\n"
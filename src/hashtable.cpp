@@ -1,693 +1,1175 @@
-// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
-
-#include "common_headers.h"
-
-#include "circa/circa.h"
-
-#include "hashtable.h"
-#include "kernel.h"
-#include "list.h"
-#include "names.h"
-#include "string_type.h"
-#include "symbols.h"
-#include "tagged_value.h"
-#include "type.h"
-
-namespace circa {
-
-struct Slot {
-    u32 hash;
-    int next;
-    Value key;
-    Value value;
-};
-
-struct Hashtable {
-    int refCount;
-    bool mut;
-    int capacity;
-    int count;
-    int buckets[0];
-    // buckets has size [capacity].
-    // after buckets is Slot[capacity]
-};
-
-int hashtable_insert(Hashtable** dataPtr, Value* key, bool moveKey);
-int hashtable_find_key_index(Hashtable* table, Value* key, u32 keyHash);
-Value* hashtable_get(Hashtable* table, Value* key);
-
-// How many slots to create for a brand new table.
-const int INITIAL_SIZE = 8;
-
-// When reallocating a table, how many slots should initially be filled.
-const float INITIAL_LOAD_FACTOR = 0.3f;
-
-// The load at which we'll trigger a reallocation.
-const float MAX_LOAD_FACTOR = 0.75f;
-
-static Slot* get_slot(Hashtable* table, int index)
-{
-    ca_assert(index < table->capacity);
-    Slot* firstSlot = (Slot*) &table->buckets[table->capacity];
-    return &firstSlot[index];
-}
-
-Hashtable* create_table(int capacity)
-{
-    ca_assert(capacity > 0);
-    size_t size = sizeof(Hashtable) + capacity * (sizeof(int) + sizeof(Slot));
-    Hashtable* table = (Hashtable*) malloc(size);
-    memset(table, 0, size);
-    table->refCount = 1;
-    table->mut = false;
-    table->capacity = capacity;
-    for (int i=0; i < capacity; i++) {
-        table->buckets[i] = -1;
-        Slot* slot = get_slot(table, i);
-        initialize_null(&slot->key);
-        initialize_null(&slot->value);
-    }
-    return table;
-}
-
-Hashtable* create_table()
-{
-    return create_table(INITIAL_SIZE);
-}
-
-void free_table(Hashtable* table)
-{
-    if (table == NULL)
-        return;
-
-    for (int i=0; i < table->count; i++) {
-        Slot* slot = get_slot(table, i);
-        set_null(&slot->key);
-        set_null(&slot->value);
-    }
-    free(table);
-}
-
-void hashtable_decref(Hashtable* table)
-{
-    ca_assert(table->refCount > 0);
-    table->refCount--;
-
-    if (table->refCount == 0)
-        free_table(table);
-}
-
-void hashtable_incref(Hashtable* table)
-{
-    ca_assert(table->refCount > 0);
-    table->refCount++;
-}
-
-static Hashtable* grow(Hashtable* table)
-{
-    int newCapacity = INITIAL_SIZE;
-    int existingCount = 0;
-    if (table != NULL) {
-        newCapacity = table->count / INITIAL_LOAD_FACTOR;
-        existingCount = table->count;
-    }
-
-    Hashtable* newTable = create_table(newCapacity);
-    newTable->refCount = table->refCount;
-    newTable->mut = table->mut;
-
-    // Move all existing keys & values over.
-    for (int i=0; i < existingCount; i++) {
-        Slot* oldSlot = get_slot(table, i);
-        int index = hashtable_insert(&newTable, &oldSlot->key, true);
-        Slot* newSlot = get_slot(newTable, index);
-        move(&oldSlot->value, &newSlot->value);
-    }
-
-    free(table);
-    return newTable;
-}
-
-Hashtable* duplicate(Hashtable* original)
-{
-    if (original == NULL)
-        return NULL;
-
-    stat_increment(HashtableDuplicate);
-
-    int new_capacity = int(original->count / INITIAL_LOAD_FACTOR);
-    if (new_capacity < INITIAL_SIZE)
-        new_capacity = INITIAL_SIZE;
-
-    Hashtable* dupe = create_table(new_capacity);
-
-    dupe->mut = original->mut;
-
-    // Copy all items
-    for (int i=0; i < original->count; i++) {
-        Slot* slot = get_slot(original, i);
-        int index = hashtable_insert(&dupe, &slot->key, false);
-        Slot* dupeSlot = get_slot(dupe, index);
-        copy(&slot->value, &dupeSlot->value);
-        stat_increment(HashtableDuplicate_Copy);
-    }
-    return dupe;
-}
-
-void hashtable_copy(Value* sourceVal, Value* destVal)
-{
-    Hashtable* source = (Hashtable*) sourceVal->value_data.ptr;
-
-    make_no_initialize(sourceVal->value_type, destVal);
-
-    if (source != NULL)
-        hashtable_incref(source);
-
-    destVal->value_data.ptr = source;
-}
-
-void hashtable_touch(Value* value)
-{
-    Hashtable* table = (Hashtable*) value->value_data.ptr;
-    if (table == NULL || table->mut || table->refCount == 1)
-        return;
-
-    Hashtable* copy = duplicate(table);
-    hashtable_decref(table);
-    value->value_data.ptr = copy;
-}
-
-bool hashtable_touch_is_necessary(Value* value)
-{
-    Hashtable* table = (Hashtable*) value->value_data.ptr;
-    return !(table == NULL || table->mut || table->refCount == 1);
-}
-
-int hashtable_find_key_index(Hashtable* table, Value* key, u32 keyHash)
-{
-    if (table == NULL)
-        return -1;
-
-    int bucket = keyHash % table->capacity;
-
-    int slotIndex = table->buckets[bucket];
-
-    while (true) {
-        if (slotIndex == -1)
-            return -1;
-
-        Slot* slot = get_slot(table, slotIndex);
-        if (keyHash == slot->hash && strict_equals(key, &slot->key))
-            return slotIndex;
-
-        slotIndex = slot->next;
-    }
-    
-    return -1; // Unreachable
-}
-
-// Insert the given key into the dictionary, returns the index.
-// This may create a new Hashtable* object, so don't use the old Hashtable* pointer after
-// calling this.
-int hashtable_insert(Hashtable** dataPtr, Value* key, bool moveKey)
-{
-    if (*dataPtr == NULL)
-        *dataPtr = create_table();
-
-    u32 hash = get_hash_value(key);
-
-    // Check if this key is already here.
-    int existing = hashtable_find_key_index(*dataPtr, key, hash);
-    if (existing != -1)
-        return existing;
-
-    // Check if it is time to reallocate
-    if ((*dataPtr)->count >= MAX_LOAD_FACTOR * ((*dataPtr)->capacity))
-        *dataPtr = grow(*dataPtr);
-
-    Hashtable* table = *dataPtr;
-
-    // Allocate slot
-    int newSlotIndex = table->count++;
-    Slot* slot = get_slot(table, newSlotIndex);
-    slot->next = -1;
-    slot->hash = hash;
-
-    if (moveKey)
-        move(key, &slot->key);
-    else
-        copy(key, &slot->key);
-
-    // Add slot to bucket list
-    int bucket = hash % table->capacity;
-
-    if (table->buckets[bucket] == -1) {
-        // First key in bucket.
-        table->buckets[bucket] = newSlotIndex;
-    } else {
-        Slot* searchSlot = get_slot(table, table->buckets[bucket]);
-        while (searchSlot->next != -1)
-            searchSlot = get_slot(table, searchSlot->next);
-
-        searchSlot->next = newSlotIndex;
-    }
-
-    return newSlotIndex;
-}
-
-void insert_value(Hashtable** dataPtr, Value* key, Value* value)
-{
-    int index = hashtable_insert(dataPtr, key, false);
-    Slot* slot = get_slot(*dataPtr, index);
-    copy(value, &slot->value);
-}
-
-Value* hashtable_get(Hashtable* table, Value* key)
-{
-    int index = hashtable_find_key_index(table, key, get_hash_value(key));
-    if (index == -1)
-        return NULL;
-    Slot* slot = get_slot(table, index);
-    return &slot->value;
-}
-
-Value* get_index(Hashtable* data, int index)
-{
-    ca_assert(index < data->capacity);
-    Slot* slot = get_slot(data, index);
-    return &slot->value;
-}
-
-void move_slot(Hashtable* table, int fromIndex, int toIndex)
-{
-    if (fromIndex == toIndex)
-        return;
-
-    Slot* from = get_slot(table, fromIndex);
-    Slot* to = get_slot(table, toIndex);
-
-    move(&from->key, &to->key);
-    move(&from->value, &to->value);
-    to->hash = from->hash;
-    to->next = from->next;
-
-    // Linear search: find and update whathever was pointing to 'from'
-    for (int i=0; i < table->capacity; i++) {
-        if (table->buckets[i] == fromIndex) {
-            table->buckets[i] = toIndex;
-            return;
-        }
-    }
-    for (int i=0; i < table->count; i++) {
-        if (get_slot(table, i)->next == fromIndex) {
-            get_slot(table, i)->next = toIndex;
-            return;
-        }
-    }
-}
-
-void remove(Hashtable* table, Value* key)
-{
-    if (table == NULL)
-        return;
-
-    u32 hash = get_hash_value(key);
-    int bucket = hash % table->capacity;
-
-    Slot* previousSlot = NULL;
-    int searchIndex = table->buckets[bucket];
-
-    while (true) {
-        if (searchIndex == -1)
-            return;
-
-        Slot* searchSlot = get_slot(table, searchIndex);
-
-        if (searchSlot->hash == hash && strict_equals(&searchSlot->key, key)) {
-            // Found key.
-
-            set_null(&searchSlot->key);
-            set_null(&searchSlot->value);
-
-            if (previousSlot == NULL)
-                table->buckets[bucket] = searchSlot->next;
-            else
-                previousSlot->next = searchSlot->next;
-
-            // Fill in the open slot
-            table->count--;
-            move_slot(table, table->count, searchIndex);
-
-            return;
-        }
-
-        previousSlot = searchSlot;
-        searchIndex = searchSlot->next;
-    }
-}
-
-bool is_empty(Hashtable* data)
-{
-    if (data == NULL)
-        return true;
-
-    return data->count == 0;
-}
-
-int count(Hashtable* data)
-{
-    return data->count;
-}
-
-void clear(Hashtable* table)
-{
-    for (int i=0; i < table->count; i++) {
-        Slot* slot = get_slot(table, i);
-        set_null(&slot->key);
-        set_null(&slot->value);
-    }
-    table->count = 0;
-}
-
-static void hashtable_to_string(Value* table, Value* out)
-{
-    if (table == NULL || hashtable_count(table) == 0) {
-        string_append(out, "{}");
-        return;
-    }
-
-    Value keys;
-    hashtable_get_keys(table, &keys);
-    list_sort(&keys, NULL, NULL);
-
-    string_append(out, "{");
-
-    for (int i=0; i < list_length(&keys); i++) {
-        if (i > 0)
-            string_append(out, ", ");
-
-        Value* key = list_get(&keys, i);
-
-        Value* value = hashtable_get(table, key);
-
-        Value keyAsString;
-        to_string(key, &keyAsString);
-        string_append(out, &keyAsString);
-
-        Value valueAsString;
-        to_string(value, &valueAsString);
-
-        string_append(out, " => ");
-        string_append(out, &valueAsString);
-    }
-
-    string_append(out, "}");
-}
-
-namespace tagged_value_wrappers {
-
-    void initialize(Type* type, Value* value)
-    {
-        value->value_data.ptr = NULL;
-    }
-    void release(Value* value)
-    {
-        Hashtable* table = (Hashtable*) value->value_data.ptr;
-        if (table == NULL)
-            return;
-
-        hashtable_decref(table);
-    }
-} // namespace tagged_value_wrappers
-
-void set_mutable_hashtable(Value* value)
-{
-    make_no_initialize(TYPES.table, value);
-    Hashtable* table = create_table();
-    table->mut = true;
-    value->value_data.ptr = table;
-}
-
-Value* hashtable_get(Value* table, Value* key)
-{
-    ca_assert(table->value_type->storageType == s_StorageTypeHashtable);
-    return hashtable_get((Hashtable*) table->value_data.ptr, key);
-}
-
-Value* hashtable_get(Value* table, const char* keystr)
-{
-    Value str;
-    set_string(&str, keystr);
-    return hashtable_get(table, &str);
-}
-
-Value* hashtable_insert(Value* tableTv, Value* key, bool moveKey)
-{
-    ca_assert(is_hashtable(tableTv));
-    hashtable_touch(tableTv);
-    Hashtable*& table = (Hashtable*&) tableTv->value_data.ptr;
-    int index = hashtable_insert(&table, key, moveKey);
-
-    return &get_slot(table, index)->value;
-}
-
-Value* hashtable_insert(Value* table, Value* key)
-{
-    return hashtable_insert(table, key, false);
-}
-
-Value* hashtable_get_int_key(Value* table, int key)
-{
-    // Future: Optimize by not creating a Value.
-    Value boxedKey;
-    set_int(&boxedKey, key);
-    return hashtable_get(table, &boxedKey);
-}
-
-Value* hashtable_insert_term_key(Value* table, Term* term)
-{
-    Value boxedKey;
-    set_term_ref(&boxedKey, term);
-    return hashtable_insert(table, &boxedKey);
-}
-
-Value* hashtable_get_term_key(Value* table, Term* term)
-{
-    Value boxedKey;
-    set_term_ref(&boxedKey, term);
-    return hashtable_get(table, &boxedKey);
-}
-
-Value* hashtable_insert_int_key(Value* table, int key)
-{
-    Value boxedKey;
-    set_int(&boxedKey, key);
-    return hashtable_insert(table, &boxedKey);
-}
-
-Value* hashtable_get_symbol_key(Value* table, Symbol key)
-{
-    Value boxedKey;
-    set_symbol(&boxedKey, key);
-    return hashtable_get(table, &boxedKey);
-}
-
-Value* hashtable_insert_symbol_key(Value* table, Symbol key)
-{
-    Value boxedKey;
-    set_symbol(&boxedKey, key);
-    return hashtable_insert(table, &boxedKey);
-}
-
-void hashtable_remove_symbol_key(Value* table, Symbol key)
-{
-    Value boxedKey;
-    set_symbol(&boxedKey, key);
-    hashtable_remove(table, &boxedKey);
-}
-
-void hashtable_remove_int_key(Value* table, int key)
-{
-    Value boxedKey;
-    set_int(&boxedKey, key);
-    hashtable_remove(table, &boxedKey);
-}
-
-void hashtable_remove(Value* tableTv, Value* key)
-{
-    ca_assert(is_hashtable(tableTv));
-    hashtable_touch(tableTv);
-    Hashtable*& table = (Hashtable*&) tableTv->value_data.ptr;
-    remove(table, key);
-}
-
-bool hashtable_is_empty(Value* value)
-{
-    ca_assert(is_hashtable(value));
-    Hashtable* table = (Hashtable*) value->value_data.ptr;
-    return is_empty(table);
-}
-
-void hashtable_get_keys(Value* tableVal, Value* keysOut)
-{
-    set_list(keysOut);
-
-    ca_assert(is_hashtable(tableVal));
-    Hashtable* table = (Hashtable*) tableVal->value_data.ptr;
-    if (table == NULL)
-        return;
-
-    for (int i=0; i < table->count; i++) {
-        Slot* slot = get_slot(table, i);
-        copy(&slot->key, list_append(keysOut));
-    }
-}
-
-int hashtable_count(Value* tableVal)
-{
-    ca_assert(is_hashtable(tableVal));
-    Hashtable* table = (Hashtable*) tableVal->value_data.ptr;
-    if (table == NULL)
-        return 0;
-    return table->count;
-}
-
-int hashtable_slot_count(Value* tableVal)
-{
-    ca_assert(is_hashtable(tableVal));
-    if (hashtable_is_empty(tableVal))
-        return 0;
-    return ((Hashtable*) tableVal->value_data.ptr)->capacity;
-}
-Value* hashtable_key_by_index(Value* tableVal, int index)
-{
-    ca_assert(is_hashtable(tableVal));
-    Hashtable* table = (Hashtable*) tableVal->value_data.ptr;
-    return &get_slot(table, index)->key;
-}
-Value* hashtable_value_by_index(Value* tableVal, int index)
-{
-    ca_assert(is_hashtable(tableVal));
-    Hashtable* table = (Hashtable*) tableVal->value_data.ptr;
-    return &get_slot(table, index)->value;
-}
-
-bool hashtable_equals(Value* left, Value* right)
-{
-    if (!is_hashtable(right))
-        return false;
-    if (hashtable_count(left) != hashtable_count(right))
-        return false;
-
-    Hashtable* leftTable = (Hashtable*) left->value_data.ptr;
-
-    if (leftTable == NULL)
-        return true; // already verified that counts are equal
-
-    for (int i=0; i < leftTable->count; i++) {
-        Slot* leftSlot = get_slot(leftTable, i);
-        Value* rightValue = hashtable_get(right, &leftSlot->key);
-        if (rightValue == NULL)
-            return false;
-        if (!equals(&leftSlot->value, rightValue))
-            return false;
-    }
-    return true;
-}
-
-u32 circular_shift(u32 value, int shift)
-{
-    shift = shift % 32;
-    if (shift == 0)
-        return value;
-    else
-        return (value << shift) | (value >> (32 - shift));
-}
-
-int hashtable_hash(Value* value)
-{
-    int hash = 0;
-    Hashtable* table = (Hashtable*) value->value_data.ptr;
-    if (table == NULL)
-        return 0;
-
-    for (int i=0; i < table->count; i++) {
-        Slot* slot = get_slot(table, i);
-        int itemHash = get_hash_value(&slot->key);
-        itemHash ^= circular_shift(get_hash_value(&slot->value), 16);
-        hash ^= circular_shift(itemHash, i);
-    }
-    return hash;
-}
-
-void hashtable_setup_type(Type* type)
-{
-    set_string(&type->name, "Table");
-    type->initialize = tagged_value_wrappers::initialize;
-    type->release = tagged_value_wrappers::release;
-    type->copy = hashtable_copy;
-    type->equals = hashtable_equals;
-    type->hashFunc = hashtable_hash;
-    type->toString = hashtable_to_string;
-    type->storageType = s_StorageTypeHashtable;
-}
-
-HashtableIterator::HashtableIterator(Value* _table)
-  : table(_table), index(0)
-{
-    _advanceWhileInvalid();
-}
-
-Value* HashtableIterator::currentKey()
-{
-    return hashtable_key_by_index(table, index);
-}
-
-Value* HashtableIterator::current()
-{
-    return hashtable_value_by_index(table, index);
-}
-
-void HashtableIterator::advance()
-{
-    index++;
-    _advanceWhileInvalid();
-}
-
-bool HashtableIterator::finished()
-{
-    return index >= hashtable_count(table);
-}
-
-void HashtableIterator::_advanceWhileInvalid()
-{
-}
-
-CIRCA_EXPORT Value* circa_map_insert(Value* map, Value* key)
-{
-    return hashtable_insert(map, key, false);
-}
-
-CIRCA_EXPORT Value* circa_map_get(Value* map, Value* key)
-{
-    return hashtable_get(map, key);
-}
-
-CIRCA_EXPORT Value* circa_map_insert_move(Value* map, Value* key)
-{
-    return hashtable_insert(map, key, true);
-}
-
-CIRCA_EXPORT void circa_map_set_int(Value* map, Value* key, int val)
-{
-    Value wrapped;
-    set_int(&wrapped, val);
-    move(&wrapped, circa_map_insert(map, key));
-}
-
-CIRCA_EXPORT void circa_set_map(Value* value)
-{
-    set_hashtable(value);
-}
-
-} // namespace circa
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+#include "common_headers.h"
+
+#include "circa/circa.h"
+
+#include "hashtable.h"
+#include "kernel.h"
+#include "list.h"
+#include "names.h"
+#include "string_type.h"
+#include "symbols.h"
+#include "tagged_value.h"
+#include "type.h"
+
+namespace circa {
+
+struct Slot {
+    u32 hash;
+    int next;
+    Value key;
+    Value value;
+};
+
+struct HamtNode;
+
+struct Hashtable {
+    int refCount;
+    bool mut;
+    int capacity;
+    int count;
+
+    // When non-NULL, the table is stored as a HAMT (see below), and capacity is 0.
+    HamtNode* hamt;
+
+    int buckets[0];
+    // buckets has size [capacity].
+    // after buckets is Slot[capacity]
+};
+
+int hashtable_insert(Hashtable** dataPtr, Value* key, bool moveKey);
+int hashtable_find_key_index(Hashtable* table, Value* key, u32 keyHash);
+Value* hashtable_get(Hashtable* table, Value* key);
+
+// How many slots to create for a brand new table.
+const int INITIAL_SIZE = 8;
+
+// When reallocating a table, how many slots should initially be filled.
+const float INITIAL_LOAD_FACTOR = 0.3f;
+
+// The load at which we'll trigger a reallocation.
+const float MAX_LOAD_FACTOR = 0.75f;
+
+static Slot* get_slot(Hashtable* table, int index)
+{
+    ca_assert(index < table->capacity);
+    Slot* firstSlot = (Slot*) &table->buckets[table->capacity];
+    return &firstSlot[index];
+}
+
+/*
+ HAMT tables
+
+ A flat table has to copy every slot when a shared table is touched. So when a large
+ table is duplicated, the copy is stored as a hash array mapped trie instead. Duplicating
+ a HAMT table only creates a new Hashtable that shares the root node. Inserting, removing,
+ or writing to a value copies just the nodes on the path to that key, and only the ones
+ that are still shared.
+
+ Each node uses HAMT_BITS of the key's hash to pick one of HAMT_WIDTH positions. The
+ 'bitmap' says which positions are used, and the node only stores slots for those. A slot
+ holds either one entry, or a child node (when more than one key shares that position).
+ Below the last level of hash bits, nodes hold colliding keys in a plain array.
+
+ Like a flat table, lookups on a table that isn't shared (refCount is 1) make the path to
+ the key unique before returning, since the caller may write to the value.
+
+ Entries are indexed (for hashtable_key_by_index) in trie order, using the per-node
+ counts. Access by index is read-only, so it never copies nodes. HashtableIterator keeps a
+ cursor with the path to the current entry, instead of looking up each index from the
+ root. Mutable tables (set_mutable_hashtable) always stay flat.
+*/
+
+#define HASHTABLE_HAMT_MIN_COUNT 32
+#define HAMT_BITS 5
+#define HAMT_WIDTH (1 << HAMT_BITS)
+#define HAMT_MASK (HAMT_WIDTH - 1)
+
+struct HamtSlot {
+    HamtNode* child; // If non-NULL then this slot holds a child node instead of an entry.
+    u32 hash;
+    Value key;
+    Value value;
+};
+
+struct HamtNode {
+    int refCount;
+    int count; // Number of entries in this subtree.
+    u32 bitmap;
+    int slotCount;
+    HamtSlot slots[0];
+};
+
+static HamtNode* hamt_new_node(int slotCount)
+{
+    size_t size = sizeof(HamtNode) + slotCount * sizeof(HamtSlot);
+    HamtNode* node = (HamtNode*) malloc(size);
+    memset(node, 0, size);
+    node->refCount = 1;
+    node->slotCount = slotCount;
+    for (int i=0; i < slotCount; i++) {
+        initialize_null(&node->slots[i].key);
+        initialize_null(&node->slots[i].value);
+    }
+    return node;
+}
+
+static void hamt_decref(HamtNode* node)
+{
+    if (node == NULL)
+        return;
+
+    ca_assert(node->refCount > 0);
+    node->refCount--;
+    if (node->refCount > 0)
+        return;
+
+    for (int i=0; i < node->slotCount; i++) {
+        HamtSlot* slot = &node->slots[i];
+        hamt_decref(slot->child);
+        set_null(&slot->key);
+        set_null(&slot->value);
+    }
+    free(node);
+}
+
+static bool hamt_is_collision_level(int shift)
+{
+    return shift >= 32;
+}
+
+static u32 hamt_bit(u32 hash, int shift)
+{
+    return 1u << ((hash >> shift) & HAMT_MASK);
+}
+
+static int hamt_position(u32 bitmap, u32 bit)
+{
+    // Population count of the bits below 'bit'.
+    u32 x = bitmap & (bit - 1);
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    return (((x + (x >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+}
+
+static int hamt_collision_position(HamtNode* node, Value* key, u32 hash)
+{
+    for (int i=0; i < node->slotCount; i++) {
+        HamtSlot* slot = &node->slots[i];
+        if (slot->hash == hash && strict_equals(&slot->key, key))
+            return i;
+    }
+    return -1;
+}
+
+// Returns a new node with the contents of 'node', plus an empty slot at 'insertAt', and
+// minus the slot at 'removeAt' (either may be -1). Consumes the caller's reference to
+// 'node'. If that was the only reference then the slots are moved instead of copied.
+static HamtNode* hamt_rebuild(HamtNode* node, int insertAt, int removeAt)
+{
+    int slotCount = node->slotCount + (insertAt != -1 ? 1 : 0) - (removeAt != -1 ? 1 : 0);
+    HamtNode* result = hamt_new_node(slotCount);
+    result->count = node->count;
+    result->bitmap = node->bitmap;
+
+    bool steal = node->refCount == 1;
+    if (!steal)
+        stat_increment(HashtableHamtNodeCopy);
+
+    int out = 0;
+    for (int i=0; i < node->slotCount; i++) {
+        if (i == removeAt)
+            continue;
+        if (out == insertAt)
+            out++;
+
+        HamtSlot* from = &node->slots[i];
+        HamtSlot* to = &result->slots[out++];
+        to->hash = from->hash;
+        to->child = from->child;
+
+        if (steal) {
+            from->child = NULL;
+            move(&from->key, &to->key);
+            move(&from->value, &to->value);
+        } else {
+            if (to->child != NULL)
+                to->child->refCount++;
+            copy(&from->key, &to->key);
+            copy(&from->value, &to->value);
+        }
+    }
+
+    hamt_decref(node);
+    return result;
+}
+
+static void hamt_touch(HamtNode** nodePtr)
+{
+    if ((*nodePtr)->refCount > 1)
+        *nodePtr = hamt_rebuild(*nodePtr, -1, -1);
+}
+
+static HamtSlot* hamt_find(HamtNode* node, Value* key, u32 hash)
+{
+    int shift = 0;
+    while (node != NULL) {
+        if (hamt_is_collision_level(shift)) {
+            int pos = hamt_collision_position(node, key, hash);
+            return pos == -1 ? NULL : &node->slots[pos];
+        }
+
+        u32 bit = hamt_bit(hash, shift);
+        if ((node->bitmap & bit) == 0)
+            return NULL;
+
+        HamtSlot* slot = &node->slots[hamt_position(node->bitmap, bit)];
+
+        if (slot->child == NULL) {
+            if (slot->hash == hash && strict_equals(&slot->key, key))
+                return slot;
+            return NULL;
+        }
+
+        node = slot->child;
+        shift += HAMT_BITS;
+    }
+    return NULL;
+}
+
+// Like hamt_find, but the nodes on the path to the key are made unique.
+static HamtSlot* hamt_find_for_write(HamtNode** nodePtr, Value* key, u32 hash)
+{
+    if (hamt_find(*nodePtr, key, hash) == NULL)
+        return NULL;
+
+    int shift = 0;
+    while (true) {
+        hamt_touch(nodePtr);
+        HamtNode* node = *nodePtr;
+        HamtSlot* slot;
+        if (hamt_is_collision_level(shift))
+            slot = &node->slots[hamt_collision_position(node, key, hash)];
+        else
+            slot = &node->slots[hamt_position(node->bitmap, hamt_bit(hash, shift))];
+
+        if (slot->child == NULL)
+            return slot;
+
+        nodePtr = &slot->child;
+        shift += HAMT_BITS;
+    }
+}
+
+// Find or add the key, making the nodes on its path unique. *nodePtr may be NULL.
+static HamtSlot* hamt_insert(HamtNode** nodePtr, Value* key, u32 hash, int shift,
+        bool moveKey, bool* added)
+{
+    if (*nodePtr == NULL)
+        *nodePtr = hamt_new_node(0);
+
+    hamt_touch(nodePtr);
+    HamtNode* node = *nodePtr;
+
+    int pos;
+    u32 bit = 0;
+
+    if (hamt_is_collision_level(shift)) {
+        int existing = hamt_collision_position(node, key, hash);
+        if (existing != -1)
+            return &node->slots[existing];
+        pos = node->slotCount;
+    } else {
+        bit = hamt_bit(hash, shift);
+        pos = hamt_position(node->bitmap, bit);
+
+        if (node->bitmap & bit) {
+            HamtSlot* slot = &node->slots[pos];
+
+            if (slot->child == NULL) {
+                if (slot->hash == hash && strict_equals(&slot->key, key))
+                    return slot;
+
+                // Push the existing entry down into a new child node.
+                HamtNode* child = NULL;
+                bool unused;
+                HamtSlot* moved = hamt_insert(&child, &slot->key, slot->hash,
+                    shift + HAMT_BITS, true, &unused);
+                move(&slot->value, &moved->value);
+                slot->child = child;
+            }
+
+            HamtSlot* result = hamt_insert(&slot->child, key, hash, shift + HAMT_BITS,
+                moveKey, added);
+            if (*added)
+                node->count++;
+            return result;
+        }
+    }
+
+    node = hamt_rebuild(node, pos, -1);
+    *nodePtr = node;
+    node->bitmap |= bit;
+    node->count++;
+    *added = true;
+
+    HamtSlot* slot = &node->slots[pos];
+    slot->hash = hash;
+    if (moveKey)
+        move(key, &slot->key);
+    else
+        copy(key, &slot->key);
+    return slot;
+}
+
+// Remove a key that is known to be in the trie.
+static void hamt_remove(HamtNode** nodePtr, Value* key, u32 hash, int shift)
+{
+    hamt_touch(nodePtr);
+    HamtNode* node = *nodePtr;
+
+    int pos;
+    u32 bit = 0;
+
+    if (hamt_is_collision_level(shift)) {
+        pos = hamt_collision_position(node, key, hash);
+    } else {
+        bit = hamt_bit(hash, shift);
+        pos = hamt_position(node->bitmap, bit);
+        HamtSlot* slot = &node->slots[pos];
+
+        if (slot->child != NULL) {
+            hamt_remove(&slot->child, key, hash, shift + HAMT_BITS);
+
+            HamtNode* child = slot->child;
+            if (child->count > 0) {
+                node->count--;
+                if (child->slotCount == 1 && child->slots[0].child == NULL) {
+                    // Only one entry left below this slot, pull it up.
+                    slot->hash = child->slots[0].hash;
+                    move(&child->slots[0].key, &slot->key);
+                    move(&child->slots[0].value, &slot->value);
+                    slot->child = NULL;
+                    hamt_decref(child);
+                }
+                return;
+            }
+
+            // The child is empty, drop its slot.
+        }
+    }
+
+    ca_assert(pos != -1);
+    node = hamt_rebuild(node, -1, pos);
+    *nodePtr = node;
+    node->bitmap &= ~bit;
+    node->count--;
+}
+
+static HamtSlot* hamt_slot_by_index(HamtNode* node, int index)
+{
+    while (true) {
+        ca_assert(index < node->count);
+        for (int i=0; i < node->slotCount; i++) {
+            HamtSlot* slot = &node->slots[i];
+            int size = slot->child == NULL ? 1 : slot->child->count;
+            if (index < size) {
+                if (slot->child == NULL)
+                    return slot;
+                node = slot->child;
+                break;
+            }
+            index -= size;
+        }
+    }
+}
+
+static void hamt_append_keys(HamtNode* node, Value* keysOut)
+{
+    for (int i=0; i < node->slotCount; i++) {
+        HamtSlot* slot = &node->slots[i];
+        if (slot->child != NULL)
+            hamt_append_keys(slot->child, keysOut);
+        else
+            copy(&slot->key, list_append(keysOut));
+    }
+}
+
+static bool hamt_is_writable(Hashtable* table)
+{
+    return table->mut || table->refCount == 1;
+}
+
+static Hashtable* create_hamt_table()
+{
+    Hashtable* table = (Hashtable*) malloc(sizeof(Hashtable));
+    memset(table, 0, sizeof(Hashtable));
+    table->refCount = 1;
+    return table;
+}
+
+static Value* hamt_table_insert(Hashtable* table, Value* key, bool moveKey)
+{
+    bool added = false;
+    HamtSlot* slot = hamt_insert(&table->hamt, key, get_hash_value(key), 0, moveKey, &added);
+    table->count = table->hamt->count;
+    return &slot->value;
+}
+
+static Value* hamt_table_get(Hashtable* table, Value* key)
+{
+    u32 hash = get_hash_value(key);
+    HamtSlot* slot;
+    if (hamt_is_writable(table))
+        slot = hamt_find_for_write(&table->hamt, key, hash);
+    else
+        slot = hamt_find(table->hamt, key, hash);
+    return slot == NULL ? NULL : &slot->value;
+}
+
+// Read-only access to the entry at slot 'index', for either form.
+static void table_entry(Hashtable* table, int index, Value** key, Value** value)
+{
+    if (table->hamt != NULL) {
+        HamtSlot* slot = hamt_slot_by_index(table->hamt, index);
+        *key = &slot->key;
+        *value = &slot->value;
+    } else {
+        Slot* slot = get_slot(table, index);
+        *key = &slot->key;
+        *value = &slot->value;
+    }
+}
+
+Hashtable* create_table(int capacity)
+{
+    ca_assert(capacity > 0);
+    size_t size = sizeof(Hashtable) + capacity * (sizeof(int) + sizeof(Slot));
+    Hashtable* table = (Hashtable*) malloc(size);
+    memset(table, 0, size);
+    table->refCount = 1;
+    table->mut = false;
+    table->capacity = capacity;
+    for (int i=0; i < capacity; i++) {
+        table->buckets[i] = -1;
+        Slot* slot = get_slot(table, i);
+        initialize_null(&slot->key);
+        initialize_null(&slot->value);
+    }
+    return table;
+}
+
+Hashtable* create_table()
+{
+    return create_table(INITIAL_SIZE);
+}
+
+void free_table(Hashtable* table)
+{
+    if (table == NULL)
+        return;
+
+    if (table->hamt != NULL) {
+        hamt_decref(table->hamt);
+        free(table);
+        return;
+    }
+
+    for (int i=0; i < table->count; i++) {
+        Slot* slot = get_slot(table, i);
+        set_null(&slot->key);
+        set_null(&slot->value);
+    }
+    free(table);
+}
+
+void hashtable_decref(Hashtable* table)
+{
+    ca_assert(table->refCount > 0);
+    table->refCount--;
+
+    if (table->refCount == 0)
+        free_table(table);
+}
+
+void hashtable_incref(Hashtable* table)
+{
+    ca_assert(table->refCount > 0);
+    table->refCount++;
+}
+
+static Hashtable* grow(Hashtable* table)
+{
+    int newCapacity = INITIAL_SIZE;
+    int existingCount = 0;
+    if (table != NULL) {
+        newCapacity = table->count / INITIAL_LOAD_FACTOR;
+        existingCount = table->count;
+    }
+
+    Hashtable* newTable = create_table(newCapacity);
+    newTable->refCount = table->refCount;
+    newTable->mut = table->mut;
+
+    // Move all existing keys & values over.
+    for (int i=0; i < existingCount; i++) {
+        Slot* oldSlot = get_slot(table, i);
+        int index = hashtable_insert(&newTable, &oldSlot->key, true);
+        Slot* newSlot = get_slot(newTable, index);
+        move(&oldSlot->value, &newSlot->value);
+    }
+
+    free(table);
+    return newTable;
+}
+
+Hashtable* duplicate(Hashtable* original)
+{
+    if (original == NULL)
+        return NULL;
+
+    stat_increment(HashtableDuplicate);
+
+    if (original->hamt != NULL) {
+        // Share the root node.
+        stat_increment(HashtableDuplicate_Hamt);
+        Hashtable* dupe = create_hamt_table();
+        dupe->mut = original->mut;
+        dupe->count = original->count;
+        dupe->hamt = original->hamt;
+        dupe->hamt->refCount++;
+        return dupe;
+    }
+
+    if (original->count >= HASHTABLE_HAMT_MIN_COUNT && !original->mut) {
+        Hashtable* dupe = create_hamt_table();
+        for (int i=0; i < original->count; i++) {
+            Slot* slot = get_slot(original, i);
+            copy(&slot->value, hamt_table_insert(dupe, &slot->key, false));
+            stat_increment(HashtableDuplicate_Copy);
+        }
+        return dupe;
+    }
+
+    int new_capacity = int(original->count / INITIAL_LOAD_FACTOR);
+    if (new_capacity < INITIAL_SIZE)
+        new_capacity = INITIAL_SIZE;
+
+    Hashtable* dupe = create_table(new_capacity);
+
+    dupe->mut = original->mut;
+
+    // Copy all items
+    for (int i=0; i < original->count; i++) {
+        Slot* slot = get_slot(original, i);
+        int index = hashtable_insert(&dupe, &slot->key, false);
+        Slot* dupeSlot = get_slot(dupe, index);
+        copy(&slot->value, &dupeSlot->value);
+        stat_increment(HashtableDuplicate_Copy);
+    }
+    return dupe;
+}
+
+void hashtable_copy(Value* sourceVal, Value* destVal)
+{
+    Hashtable* source = (Hashtable*) sourceVal->value_data.ptr;
+
+    make_no_initialize(sourceVal->value_type, destVal);
+
+    if (source != NULL)
+        hashtable_incref(source);
+
+    destVal->value_data.ptr = source;
+}
+
+void hashtable_touch(Value* value)
+{
+    Hashtable* table = (Hashtable*) value->value_data.ptr;
+    if (table == NULL || table->mut || table->refCount == 1)
+        return;
+
+    Hashtable* copy = duplicate(table);
+    hashtable_decref(table);
+    value->value_data.ptr = copy;
+}
+
+bool hashtable_touch_is_necessary(Value* value)
+{
+    Hashtable* table = (Hashtable*) value->value_data.ptr;
+    return !(table == NULL || table->mut || table->refCount == 1);
+}
+
+int hashtable_find_key_index(Hashtable* table, Value* key, u32 keyHash)
+{
+    if (table == NULL)
+        return -1;
+
+    int bucket = keyHash % table->capacity;
+
+    int slotIndex = table->buckets[bucket];
+
+    while (true) {
+        if (slotIndex == -1)
+            return -1;
+
+        Slot* slot = get_slot(table, slotIndex);
+        if (keyHash == slot->hash && strict_equals(key, &slot->key))
+            return slotIndex;
+
+        slotIndex = slot->next;
+    }
+    
+    return -1; // Unreachable
+}
+
+// Insert the given key into the dictionary, returns the index.
+// This may create a new Hashtable* object, so don't use the old Hashtable* pointer after
+// calling this.
+int hashtable_insert(Hashtable** dataPtr, Value* key, bool moveKey)
+{
+    if (*dataPtr == NULL)
+        *dataPtr = create_table();
+
+    ca_assert((*dataPtr)->hamt == NULL);
+
+    u32 hash = get_hash_value(key);
+
+    // Check if this key is already here.
+    int existing = hashtable_find_key_index(*dataPtr, key, hash);
+    if (existing != -1)
+        return existing;
+
+    // Check if it is time to reallocate
+    if ((*dataPtr)->count >= MAX_LOAD_FACTOR * ((*dataPtr)->capacity))
+        *dataPtr = grow(*dataPtr);
+
+    Hashtable* table = *dataPtr;
+
+    // Allocate slot
+    int newSlotIndex = table->count++;
+    Slot* slot = get_slot(table, newSlotIndex);
+    slot->next = -1;
+    slot->hash = hash;
+
+    if (moveKey)
+        move(key, &slot->key);
+    else
+        copy(key, &slot->key);
+
+    // Add slot to bucket list
+    int bucket = hash % table->capacity;
+
+    if (table->buckets[bucket] == -1) {
+        // First key in bucket.
+        table->buckets[bucket] = newSlotIndex;
+    } else {
+        Slot* searchSlot = get_slot(table, table->buckets[bucket]);
+        while (searchSlot->next != -1)
+            searchSlot = get_slot(table, searchSlot->next);
+
+        searchSlot->next = newSlotIndex;
+    }
+
+    return newSlotIndex;
+}
+
+void insert_value(Hashtable** dataPtr, Value* key, Value* value)
+{
+    int index = hashtable_insert(dataPtr, key, false);
+    Slot* slot = get_slot(*dataPtr, index);
+    copy(value, &slot->value);
+}
+
+Value* hashtable_get(Hashtable* table, Value* key)
+{
+    if (table != NULL && table->hamt != NULL)
+        return hamt_table_get(table, key);
+
+    int index = hashtable_find_key_index(table, key, get_hash_value(key));
+    if (index == -1)
+        return NULL;
+    Slot* slot = get_slot(table, index);
+    return &slot->value;
+}
+
+Value* get_index(Hashtable* data, int index)
+{
+    ca_assert(index < data->capacity);
+    Slot* slot = get_slot(data, index);
+    return &slot->value;
+}
+
+void move_slot(Hashtable* table, int fromIndex, int toIndex)
+{
+    if (fromIndex == toIndex)
+        return;
+
+    Slot* from = get_slot(table, fromIndex);
+    Slot* to = get_slot(table, toIndex);
+
+    move(&from->key, &to->key);
+    move(&from->value, &to->value);
+    to->hash = from->hash;
+    to->next = from->next;
+
+    // Update whatever was pointing to 'from'. That's either its bucket or a slot earlier
+    // in the same chain.
+    int* link = &table->buckets[to->hash % table->capacity];
+    while (*link != fromIndex)
+        link = &get_slot(table, *link)->next;
+    *link = toIndex;
+}
+
+void remove(Hashtable* table, Value* key)
+{
+    if (table == NULL)
+        return;
+
+    if (table->hamt != NULL) {
+        u32 hash = get_hash_value(key);
+        if (hamt_find(table->hamt, key, hash) == NULL)
+            return;
+        hamt_remove(&table->hamt, key, hash, 0);
+        table->count = table->hamt->count;
+        return;
+    }
+
+    u32 hash = get_hash_value(key);
+    int bucket = hash % table->capacity;
+
+    Slot* previousSlot = NULL;
+    int searchIndex = table->buckets[bucket];
+
+    while (true) {
+        if (searchIndex == -1)
+            return;
+
+        Slot* searchSlot = get_slot(table, searchIndex);
+
+        if (searchSlot->hash == hash && strict_equals(&searchSlot->key, key)) {
+            // Found key.
+
+            set_null(&searchSlot->key);
+            set_null(&searchSlot->value);
+
+            if (previousSlot == NULL)
+                table->buckets[bucket] = searchSlot->next;
+            else
+                previousSlot->next = searchSlot->next;
+
+            // Fill in the open slot
+            table->count--;
+            move_slot(table, table->count, searchIndex);
+
+            return;
+        }
+
+        previousSlot = searchSlot;
+        searchIndex = searchSlot->next;
+    }
+}
+
+bool is_empty(Hashtable* data)
+{
+    if (data == NULL)
+        return true;
+
+    return data->count == 0;
+}
+
+int count(Hashtable* data)
+{
+    return data->count;
+}
+
+void clear(Hashtable* table)
+{
+    if (table->hamt != NULL) {
+        hamt_decref(table->hamt);
+        table->hamt = hamt_new_node(0);
+        table->count = 0;
+        return;
+    }
+
+    for (int i=0; i < table->count; i++) {
+        Slot* slot = get_slot(table, i);
+        set_null(&slot->key);
+        set_null(&slot->value);
+    }
+    for (int i=0; i < table->capacity; i++)
+        table->buckets[i] = -1;
+    table->count = 0;
+}
+
+static void hashtable_to_string(Value* table, Value* out)
+{
+    if (table == NULL || hashtable_count(table) == 0) {
+        string_append(out, "{}");
+        return;
+    }
+
+    Value keys;
+    hashtable_get_keys(table, &keys);
+    list_sort(&keys, NULL, NULL);
+
+    string_append(out, "{");
+
+    for (int i=0; i < list_length(&keys); i++) {
+        if (i > 0)
+            string_append(out, ", ");
+
+        Value* key = list_get(&keys, i);
+
+        Value* value = hashtable_get(table, key);
+
+        Value keyAsString;
+        to_string(key, &keyAsString);
+        string_append(out, &keyAsString);
+
+        Value valueAsString;
+        to_string(value, &valueAsString);
+
+        string_append(out, " => ");
+        string_append(out, &valueAsString);
+    }
+
+    string_append(out, "}");
+}
+
+namespace tagged_value_wrappers {
+
+    void initialize(Type* type, Value* value)
+    {
+        value->value_data.ptr = NULL;
+    }
+    void release(Value* value)
+    {
+        Hashtable* table = (Hashtable*) value->value_data.ptr;
+        if (table == NULL)
+            return;
+
+        hashtable_decref(table);
+    }
+} // namespace tagged_value_wrappers
+
+void set_mutable_hashtable(Value* value)
+{
+    make_no_initialize(TYPES.table, value);
+    Hashtable* table = create_table();
+    table->mut = true;
+    value->value_data.ptr = table;
+}
+
+Value* hashtable_get(Value* table, Value* key)
+{
+    ca_assert(table->value_type->storageType == s_StorageTypeHashtable);
+    return hashtable_get((Hashtable*) table->value_data.ptr, key);
+}
+
+Value* hashtable_get(Value* table, const char* keystr)
+{
+    Value str;
+    set_string(&str, keystr);
+    return hashtable_get(table, &str);
+}
+
+Value* hashtable_insert(Value* tableTv, Value* key, bool moveKey)
+{
+    ca_assert(is_hashtable(tableTv));
+    hashtable_touch(tableTv);
+    Hashtable*& table = (Hashtable*&) tableTv->value_data.ptr;
+
+    if (table != NULL && table->hamt != NULL)
+        return hamt_table_insert(table, key, moveKey);
+
+    int index = hashtable_insert(&table, key, moveKey);
+
+    return &get_slot(table, index)->value;
+}
+
+Value* hashtable_insert(Value* table, Value* key)
+{
+    return hashtable_insert(table, key, false);
+}
+
+Value* hashtable_get_int_key(Value* table, int key)
+{
+    // Future: Optimize by not creating a Value.
+    Value boxedKey;
+    set_int(&boxedKey, key);
+    return hashtable_get(table, &boxedKey);
+}
+
+Value* hashtable_insert_term_key(Value* table, Term* term)
+{
+    Value boxedKey;
+    set_term_ref(&boxedKey, term);
+    return hashtable_insert(table, &boxedKey);
+}
+
+Value* hashtable_get_term_key(Value* table, Term* term)
+{
+    Value boxedKey;
+    set_term_ref(&boxedKey, term);
+    return hashtable_get(table, &boxedKey);
+}
+
+Value* hashtable_insert_int_key(Value* table, int key)
+{
+    Value boxedKey;
+    set_int(&boxedKey, key);
+    return hashtable_insert(table, &boxedKey);
+}
+
+Value* hashtable_get_symbol_key(Value* table, Symbol key)
+{
+    Value boxedKey;
+    set_symbol(&boxedKey, key);
+    return hashtable_get(table, &boxedKey);
+}
+
+Value* hashtable_insert_symbol_key(Value* table, Symbol key)
+{
+    Value boxedKey;
+    set_symbol(&boxedKey, key);
+    return hashtable_insert(table, &boxedKey);
+}
+
+void hashtable_remove_symbol_key(Value* table, Symbol key)
+{
+    Value boxedKey;
+    set_symbol(&boxedKey, key);
+    hashtable_remove(table, &boxedKey);
+}
+
+void hashtable_remove_int_key(Value* table, int key)
+{
+    Value boxedKey;
+    set_int(&boxedKey, key);
+    hashtable_remove(table, &boxedKey);
+}
+
+void hashtable_remove(Value* tableTv, Value* key)
+{
+    ca_assert(is_hashtable(tableTv));
+    hashtable_touch(tableTv);
+    Hashtable*& table = (Hashtable*&) tableTv->value_data.ptr;
+    remove(table, key);
+}
+
+bool hashtable_is_empty(Value* value)
+{
+    ca_assert(is_hashtable(value));
+    Hashtable* table = (Hashtable*) value->value_data.ptr;
+    return is_empty(table);
+}
+
+void hashtable_get_keys(Value* tableVal, Value* keysOut)
+{
+    set_list(keysOut);
+
+    ca_assert(is_hashtable(tableVal));
+    Hashtable* table = (Hashtable*) tableVal->value_data.ptr;
+    if (table == NULL)
+        return;
+
+    if (table->hamt != NULL) {
+        hamt_append_keys(table->hamt, keysOut);
+        return;
+    }
+
+    for (int i=0; i < table->count; i++) {
+        Slot* slot = get_slot(table, i);
+        copy(&slot->key, list_append(keysOut));
+    }
+}
+
+int hashtable_count(Value* tableVal)
+{
+    ca_assert(is_hashtable(tableVal));
+    Hashtable* table = (Hashtable*) tableVal->value_data.ptr;
+    if (table == NULL)
+        return 0;
+    return table->count;
+}
+
+int hashtable_slot_count(Value* tableVal)
+{
+    ca_assert(is_hashtable(tableVal));
+    if (hashtable_is_empty(tableVal))
+        return 0;
+    Hashtable* table = (Hashtable*) tableVal->value_data.ptr;
+    if (table->hamt != NULL)
+        return table->count;
+    return table->capacity;
+}
+Value* hashtable_key_by_index(Value* tableVal, int index)
+{
+    ca_assert(is_hashtable(tableVal));
+    Hashtable* table = (Hashtable*) tableVal->value_data.ptr;
+    if (table->hamt != NULL)
+        return &hamt_slot_by_index(table->hamt, index)->key;
+    return &get_slot(table, index)->key;
+}
+Value* hashtable_value_by_index(Value* tableVal, int index)
+{
+    ca_assert(is_hashtable(tableVal));
+    Hashtable* table = (Hashtable*) tableVal->value_data.ptr;
+    if (table->hamt != NULL)
+        return &hamt_slot_by_index(table->hamt, index)->value;
+    return &get_slot(table, index)->value;
+}
+
+bool hashtable_equals(Value* left, Value* right)
+{
+    if (!is_hashtable(right))
+        return false;
+    if (hashtable_count(left) != hashtable_count(right))
+        return false;
+
+    Hashtable* leftTable = (Hashtable*) left->value_data.ptr;
+
+    if (leftTable == NULL)
+        return true; // already verified that counts are equal
+
+    for (int i=0; i < leftTable->count; i++) {
+        Value* leftKey;
+        Value* leftValue;
+        table_entry(leftTable, i, &leftKey, &leftValue);
+        Value* rightValue = hashtable_get(right, leftKey);
+        if (rightValue == NULL)
+            return false;
+        if (!equals(leftValue, rightValue))
+            return false;
+    }
+    return true;
+}
+
+u32 circular_shift(u32 value, int shift)
+{
+    shift = shift % 32;
+    if (shift == 0)
+        return value;
+    else
+        return (value << shift) | (value >> (32 - shift));
+}
+
+int hashtable_hash(Value* value)
+{
+    int hash = 0;
+    Hashtable* table = (Hashtable*) value->value_data.ptr;
+    if (table == NULL)
+        return 0;
+
+    // Combine the items in an order-independent way, since equal tables can store their
+    // entries in different orders (including a flat table and its HAMT copy).
+    for (int i=0; i < table->count; i++) {
+        Value* key;
+        Value* itemValue;
+        table_entry(table, i, &key, &itemValue);
+        int itemHash = get_hash_value(key);
+        itemHash ^= circular_shift(get_hash_value(itemValue), 16);
+        hash ^= itemHash;
+    }
+    return hash;
+}
+
+void hashtable_setup_type(Type* type)
+{
+    set_string(&type->name, "Table");
+    type->initialize = tagged_value_wrappers::initialize;
+    type->release = tagged_value_wrappers::release;
+    type->copy = hashtable_copy;
+    type->equals = hashtable_equals;
+    type->hashFunc = hashtable_hash;
+    type->toString = hashtable_to_string;
+    type->storageType = s_StorageTypeHashtable;
+}
+
+HashtableIterator::HashtableIterator(Value* _table)
+  : table(_table), index(-1), _key(NULL), _value(NULL), _depth(0)
+{
+    Hashtable* data = (Hashtable*) table->value_data.ptr;
+    if (data != NULL && data->hamt != NULL) {
+        _nodes[0] = data->hamt;
+        _positions[0] = -1;
+        _depth = 1;
+    }
+    advance();
+}
+
+void HashtableIterator::advance()
+{
+    _key = NULL;
+    _value = NULL;
+
+    Hashtable* data = (Hashtable*) table->value_data.ptr;
+    if (data == NULL)
+        return;
+
+    index++;
+
+    if (data->hamt == NULL) {
+        if (index < data->count) {
+            Slot* slot = get_slot(data, index);
+            _key = &slot->key;
+            _value = &slot->value;
+        }
+        return;
+    }
+
+    // Step to the next slot in trie order, going down into children and back up out of
+    // finished nodes.
+    while (_depth > 0) {
+        HamtNode* node = _nodes[_depth - 1];
+        int pos = ++_positions[_depth - 1];
+
+        if (pos >= node->slotCount) {
+            _depth--;
+            continue;
+        }
+
+        HamtSlot* slot = &node->slots[pos];
+        if (slot->child != NULL) {
+            ca_assert(_depth < MAX_DEPTH);
+            _nodes[_depth] = slot->child;
+            _positions[_depth] = -1;
+            _depth++;
+            continue;
+        }
+
+        _key = &slot->key;
+        _value = &slot->value;
+        return;
+    }
+}
+
+CIRCA_EXPORT Value* circa_map_insert(Value* map, Value* key)
+{
+    return hashtable_insert(map, key, false);
+}
+
+CIRCA_EXPORT Value* circa_map_get(Value* map, Value* key)
+{
+    return hashtable_get(map, key);
+}
+
+CIRCA_EXPORT Value* circa_map_insert_move(Value* map, Value* key)
+{
+    return hashtable_insert(map, key, true);
+}
+
+CIRCA_EXPORT void circa_map_set_int(Value* map, Value* key, int val)
+{
+    Value wrapped;
+    set_int(&wrapped, val);
+    move(&wrapped, circa_map_insert(map, key));
+}
+
+CIRCA_EXPORT void circa_set_map(Value* value)
+{
+    set_hashtable(value);
+}
+
+} // namespace circa
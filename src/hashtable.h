@@ -4,6 +4,8 @@
 
 namespace circa {
 
+struct HamtNode;
+
 void set_mutable_hashtable(Value* value);
 void hashtable_touch(Value* value);
 bool hashtable_touch_is_necessary(Value* value);
@@ -33,30 +35,45 @@ void hashtable_get_keys(Value* table, Value* keysOut);
 
 int hashtable_count(Value* table);
 int hashtable_slot_count(Value* table);
+
+// Read-only access by slot index. For a large table each call walks down from the root,
+// so use HashtableIterator to visit every entry.
 Value* hashtable_key_by_index(Value* table, int index);
 Value* hashtable_value_by_index(Value* table, int index);
 
 void hashtable_setup_type(Type* type);
 
+// Visits each entry once. The key and value are read-only, and the table must not be
+// modified during iteration.
 struct HashtableIterator
 {
+    // Deep enough for every level of hash bits, plus a collision node.
+    static const int MAX_DEPTH = 8;
+
     Value* table;
     int index;
 
+    Value* _key;
+    Value* _value;
+
+    // For a HAMT table: the nodes from the root down to the current entry, and the slot
+    // position in each.
+    HamtNode* _nodes[MAX_DEPTH];
+    int _positions[MAX_DEPTH];
+    int _depth;
+
     HashtableIterator(Value* table);
 
-    Value* currentKey();
-    Value* current();
+    Value* currentKey() { return _key; }
+    Value* current() { return _value; }
     void advance();
-    bool finished();
+    bool finished() { return _key == NULL; }
 
     Value* key() { return currentKey(); }
     Value* value() { return current(); }
 
     operator bool() { return !finished(); }
     void operator++() { advance(); }
-
-    void _advanceWhileInvalid();
 };
 
 } // namespace circa
@@ -1,149 +1,1325 @@
-// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
-
-#include "common_headers.h"
-
-#include "circa/circa.h"
-
-#include "list.h"
-#include "names.h"
-#include "parser.h"
-#include "string_type.h"
-#include "tagged_value.h"
-#include "token.h"
-#include "type.h"
-
-namespace circa {
-
-struct ParseContext
-{
-    TokenStream* tokens;
-    Value* out;
-};
-
-static void drop_whitespace(TokenStream* tokens)
-{
-    while (tokens->nextIs(tok_Whitespace))
-        tokens->consume();
-}
-
-static void parse_value(TokenStream* tokens, Value* out)
-{
-    set_null(out);
-
-    // ignore leading whitespace
-    drop_whitespace(tokens);
-
-    if (tokens->finished()) {
-        set_string(out, "unexpected end of string");
-
-    } else if (tokens->nextIs(tok_Integer)) {
-        Value nextStr;
-        tokens->getNextStr(&nextStr);
-        set_int(out, atoi(as_cstring(&nextStr)));
-        tokens->consume(tok_Integer);
-    } else if (tokens->nextIs(tok_Float)) {
-        Value nextStr;
-        tokens->getNextStr(&nextStr);
-        set_float(out, (float) atof(as_cstring(&nextStr)));
-        tokens->consume(tok_Float);
-    } else if (tokens->nextIs(tok_String)) {
-        tokens->consumeStr(out, tok_String);
-        string_unquote_and_unescape(out);
-    } else if (tokens->nextIs(tok_LSquare)) {
-        tokens->consume(tok_LSquare);
-        drop_whitespace(tokens);
-
-        set_list(out, 0);
-
-        while (!tokens->nextIs(tok_RSquare) && !tokens->finished()) {
-            Value* element = list_append(out);
-            parse_value(tokens, element);
-
-            if (tokens->nextIs(tok_Comma))
-                tokens->consume(tok_Comma);
-            drop_whitespace(tokens);
-        }
-
-        if (!tokens->finished())
-            tokens->consume(tok_RSquare);
-    } else if (tokens->nextIs(tok_True)) {
-        set_bool(out, true);
-        tokens->consume();
-    } else if (tokens->nextIs(tok_False)) {
-        set_bool(out, false);
-        tokens->consume();
-    } else if (tokens->nextIs(tok_Minus)) {
-        tokens->consume(tok_Minus);
-
-        parse_value(tokens, out);
-
-        if (is_int(out)) {
-            set_int(out, -1 * as_int(out));
-        } else if (is_float(out)) {
-            set_float(out, -1 * as_float(out));
-        } else {
-            set_string(out, "error, minus sign must preceed number");
-        }
-
-    } else {
-        set_string(out, "unrecognized token: ");
-        Value next;
-        tokens->getNextStr(&next);
-        string_append(out, &next);
-        tokens->consume();
-    }
-
-    // ignore trailing whitespace
-    drop_whitespace(tokens);
-}
-
-void json_parse(const char* in, Value* out)
-{
-    Value inStr;
-    set_string(&inStr, in);
-    TokenStream tokens(&inStr);
-    parse_value(&tokens, out);
-}
-
-void json_write(Value* in, Value* out)
-{
-    if (!is_string(out))
-        set_string(out, "");
-
-    // For certain types, just use to_string
-    if (is_int(in) || is_float(in) || is_bool(in)) {
-        string_append(out, in);
-    } else if (is_list(in)) {
-        set_string(out, "");
-        string_append(out, "[");
-
-        for (int i=0; i < list_length(in); i++) {
-            if (i > 0)
-                string_append(out, ", ");
-
-            Value elementStr;
-            json_write(list_get(in, i), &elementStr);
-            string_append(out, &elementStr);
-        }
-
-        string_append(out, "]");
-    } else if (is_string(in)) {
-        copy(in, out);
-        string_quote_and_escape(out);
-    } else {
-        set_string(out, "error: no string repr for type ");
-        string_append(out, as_cstring(&in->value_type->name));
-    }
-}
-
-CIRCA_EXPORT void circa_parse_json(Value* in, Value* out)
-{
-    json_parse(as_cstring(in), out);
-}
-
-CIRCA_EXPORT void circa_to_json(Value* in, Value* out)
-{
-    json_write(in, out);
-}
-
-} // namespace circa
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+#include "common_headers.h"
+
+#include "circa/circa.h"
+
+#include "blob.h"
+#include "hashtable.h"
+#include "json.h"
+#include "kernel.h"
+#include "list.h"
+#include "native_patch.h"
+#include "native_ptr.h"
+#include "string_type.h"
+#include "symbols.h"
+#include "tagged_value.h"
+#include "type.h"
+#include "vm.h"
+
+#if CIRCA_ENABLE_SIMD && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+ #define CIRCA_JSON_SSE2 1
+ #include <emmintrin.h>
+#elif CIRCA_ENABLE_SIMD && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+ #define CIRCA_JSON_NEON 1
+ #include <arm_neon.h>
+#endif
+
+namespace circa {
+
+/*
+ JSON
+
+ The parser makes a single pass over the input, and builds Lists, Tables, Strings and
+ numbers directly as it goes. Whitespace runs and the plain parts of strings are skipped
+ SCAN_WIDTH bytes at a time (using SSE2 or NEON when available). A string without escapes
+ is copied straight out of the input.
+
+ JSON objects become Tables with String keys. Integers that fit in an int become ints,
+ and other numbers become floats. null becomes nil.
+
+ The writer appends to a growable buffer, and copies it into the output String once at
+ the end. It writes Tables and struct values as objects, Lists as arrays, and Symbols
+ as strings.
+*/
+
+const int SCAN_WIDTH = 16;
+
+// Objects and arrays nested deeper than this are rejected, instead of overflowing the
+// C stack.
+const int JSON_MAX_DEPTH = 512;
+
+// A ScanMask has one bit set for each matching byte in a SCAN_WIDTH block. Use
+// scan_mask_first to find the first match.
+typedef u64 ScanMask;
+
+static int scan_mask_first(ScanMask mask)
+{
+#if defined(__GNUC__)
+    int bit = __builtin_ctzll(mask);
+#else
+    int bit = 0;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        bit++;
+    }
+#endif
+#if CIRCA_JSON_NEON
+    return bit >> 2;
+#else
+    return bit;
+#endif
+}
+
+static bool is_json_whitespace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static bool is_string_special(char c)
+{
+    return c == '"' || c == '\\' || (u8) c < 0x20;
+}
+
+#if CIRCA_JSON_NEON
+static ScanMask neon_mask(uint8x16_t matches)
+{
+    // Narrow to 4 bits per byte, and keep one bit of each.
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) & 0x8888888888888888ull;
+}
+#endif
+
+// Bytes in the block that are not whitespace.
+static ScanMask scan_non_whitespace(const char* block)
+{
+#if CIRCA_JSON_SSE2
+    __m128i bytes = _mm_loadu_si128((const __m128i*) block);
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))),
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')),
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t'))));
+    return ~(u32) _mm_movemask_epi8(ws) & 0xffff;
+#elif CIRCA_JSON_NEON
+    uint8x16_t bytes = vld1q_u8((const u8*) block);
+    uint8x16_t ws = vorrq_u8(
+        vorrq_u8(vceqq_u8(bytes, vdupq_n_u8(' ')), vceqq_u8(bytes, vdupq_n_u8('\n'))),
+        vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('\r')), vceqq_u8(bytes, vdupq_n_u8('\t'))));
+    return neon_mask(vmvnq_u8(ws));
+#else
+    ScanMask mask = 0;
+    for (int i=0; i < SCAN_WIDTH; i++)
+        if (!is_json_whitespace(block[i]))
+            mask |= (ScanMask) 1 << i;
+    return mask;
+#endif
+}
+
+// Bytes in the block that end a plain run of string contents: a quote, a backslash,
+// or a control character.
+static ScanMask scan_string_special(const char* block)
+{
+#if CIRCA_JSON_SSE2
+    __m128i bytes = _mm_loadu_si128((const __m128i*) block);
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8(0x1f)), bytes);
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))),
+        control);
+    return (u32) _mm_movemask_epi8(special);
+#elif CIRCA_JSON_NEON
+    uint8x16_t bytes = vld1q_u8((const u8*) block);
+    uint8x16_t special = vorrq_u8(
+        vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('"')), vceqq_u8(bytes, vdupq_n_u8('\\'))),
+        vcltq_u8(bytes, vdupq_n_u8(0x20)));
+    return neon_mask(special);
+#else
+    ScanMask mask = 0;
+    for (int i=0; i < SCAN_WIDTH; i++)
+        if (is_string_special(block[i]))
+            mask |= (ScanMask) 1 << i;
+    return mask;
+#endif
+}
+
+static bool is_structural(char c)
+{
+    return c == '"' || c == '[' || c == ']' || c == '{' || c == '}';
+}
+
+// Bytes in the block that can change the nesting depth outside of a string: quotes,
+// brackets and braces.
+static ScanMask scan_structural(const char* block)
+{
+#if CIRCA_JSON_SSE2
+    __m128i bytes = _mm_loadu_si128((const __m128i*) block);
+    __m128i brackets = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('[')),
+        _mm_cmpeq_epi8(bytes, _mm_set1_epi8(']')));
+    __m128i braces = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('{')),
+        _mm_cmpeq_epi8(bytes, _mm_set1_epi8('}')));
+    __m128i structural = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+        _mm_or_si128(brackets, braces));
+    return (u32) _mm_movemask_epi8(structural);
+#elif CIRCA_JSON_NEON
+    uint8x16_t bytes = vld1q_u8((const u8*) block);
+    uint8x16_t brackets = vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('[')),
+        vceqq_u8(bytes, vdupq_n_u8(']')));
+    uint8x16_t braces = vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('{')),
+        vceqq_u8(bytes, vdupq_n_u8('}')));
+    uint8x16_t structural = vorrq_u8(vceqq_u8(bytes, vdupq_n_u8('"')),
+        vorrq_u8(brackets, braces));
+    return neon_mask(structural);
+#else
+    ScanMask mask = 0;
+    for (int i=0; i < SCAN_WIDTH; i++)
+        if (is_structural(block[i]))
+            mask |= (ScanMask) 1 << i;
+    return mask;
+#endif
+}
+
+// Powers of 10 that are exactly representable as doubles.
+const int POWERS_OF_10_MAX = 22;
+
+static const double g_powersOf10[POWERS_OF_10_MAX + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// -- Parsing --
+
+struct JsonParser {
+    const char* start;
+    const char* pos;
+    const char* end;
+
+    // Scratch space for strings with escapes.
+    char* buffer;
+    int bufferCapacity;
+
+    // Offset of 'start' in the whole input, for error messages.
+    i64 baseOffset;
+
+    bool failed;
+    Value error;
+};
+
+static void set_parse_error(Value* error, const char* message, i64 offset)
+{
+    char buf[32];
+    sprintf(buf, " at offset %lld", (long long) offset);
+    set_string(error, "json: ");
+    string_append(error, message);
+    string_append(error, buf);
+}
+
+static void parse_fail(JsonParser* parser, const char* message)
+{
+    if (parser->failed)
+        return;
+
+    parser->failed = true;
+    set_parse_error(&parser->error, message, parser->baseOffset + (parser->pos - parser->start));
+}
+
+static void skip_whitespace(JsonParser* parser)
+{
+    const char* pos = parser->pos;
+    const char* end = parser->end;
+
+    // Most values are separated by at most one space.
+    if (pos < end && !is_json_whitespace(*pos))
+        return;
+
+    while (end - pos >= SCAN_WIDTH) {
+        ScanMask mask = scan_non_whitespace(pos);
+        if (mask != 0) {
+            parser->pos = pos + scan_mask_first(mask);
+            return;
+        }
+        pos += SCAN_WIDTH;
+    }
+
+    while (pos < end && is_json_whitespace(*pos))
+        pos++;
+    parser->pos = pos;
+}
+
+// Find the next quote, backslash or control character, starting at 'pos'. Returns 'end'
+// if there isn't one.
+static const char* find_string_special(const char* pos, const char* end)
+{
+    while (end - pos >= SCAN_WIDTH) {
+        ScanMask mask = scan_string_special(pos);
+        if (mask != 0)
+            return pos + scan_mask_first(mask);
+        pos += SCAN_WIDTH;
+    }
+
+    while (pos < end && !is_string_special(*pos))
+        pos++;
+    return pos;
+}
+
+static char* parser_reserve(JsonParser* parser, int size)
+{
+    if (size > parser->bufferCapacity) {
+        int capacity = parser->bufferCapacity < 64 ? 64 : parser->bufferCapacity;
+        while (capacity < size)
+            capacity *= 2;
+        parser->buffer = (char*) ca_realloc(parser->buffer, capacity);
+        parser->bufferCapacity = capacity;
+    }
+    return parser->buffer;
+}
+
+static int parse_hex4(const char* pos)
+{
+    int result = 0;
+    for (int i=0; i < 4; i++) {
+        char c = pos[i];
+        result <<= 4;
+        if (c >= '0' && c <= '9')
+            result |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+            result |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            result |= c - 'A' + 10;
+        else
+            return -1;
+    }
+    return result;
+}
+
+static int write_utf8(char* out, int codepoint)
+{
+    if (codepoint < 0x80) {
+        out[0] = (char) codepoint;
+        return 1;
+    } else if (codepoint < 0x800) {
+        out[0] = (char) (0xc0 | (codepoint >> 6));
+        out[1] = (char) (0x80 | (codepoint & 0x3f));
+        return 2;
+    } else if (codepoint < 0x10000) {
+        out[0] = (char) (0xe0 | (codepoint >> 12));
+        out[1] = (char) (0x80 | ((codepoint >> 6) & 0x3f));
+        out[2] = (char) (0x80 | (codepoint & 0x3f));
+        return 3;
+    } else {
+        out[0] = (char) (0xf0 | (codepoint >> 18));
+        out[1] = (char) (0x80 | ((codepoint >> 12) & 0x3f));
+        out[2] = (char) (0x80 | ((codepoint >> 6) & 0x3f));
+        out[3] = (char) (0x80 | (codepoint & 0x3f));
+        return 4;
+    }
+}
+
+// Parse a \u escape, with 'pos' pointing after the 'u'. Handles surrogate pairs. Returns
+// the codepoint, or -1 if the escape is invalid.
+static int parse_unicode_escape(JsonParser* parser)
+{
+    if (parser->end - parser->pos < 4)
+        return -1;
+
+    int codepoint = parse_hex4(parser->pos);
+    if (codepoint < 0)
+        return -1;
+    parser->pos += 4;
+
+    if (codepoint >= 0xd800 && codepoint < 0xdc00) {
+        const char* pos = parser->pos;
+        if (parser->end - pos < 6 || pos[0] != '\\' || pos[1] != 'u')
+            return -1;
+        int low = parse_hex4(pos + 2);
+        if (low < 0xdc00 || low >= 0xe000)
+            return -1;
+        parser->pos += 6;
+        codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+    } else if (codepoint >= 0xdc00 && codepoint < 0xe000) {
+        return -1;
+    }
+
+    return codepoint;
+}
+
+// Parse a string, with 'pos' pointing after the opening quote.
+static void parse_string(JsonParser* parser, Value* out)
+{
+    const char* runStart = parser->pos;
+    const char* special = find_string_special(runStart, parser->end);
+
+    // Common case: no escapes.
+    if (special < parser->end && *special == '"') {
+        set_string(out, runStart, (int) (special - runStart));
+        parser->pos = special + 1;
+        return;
+    }
+
+    int length = 0;
+
+    while (true) {
+        if (special >= parser->end) {
+            parser->pos = special;
+            return parse_fail(parser, "unterminated string");
+        }
+
+        int runLength = (int) (special - runStart);
+        char* buffer = parser_reserve(parser, length + runLength + 4);
+        memcpy(buffer + length, runStart, runLength);
+        length += runLength;
+        parser->pos = special;
+
+        char c = *special;
+        if (c == '"') {
+            parser->pos++;
+            break;
+        }
+
+        if (c != '\\')
+            return parse_fail(parser, "control character in string");
+
+        if (parser->end - parser->pos < 2)
+            return parse_fail(parser, "unterminated string");
+
+        char escaped = parser->pos[1];
+        parser->pos += 2;
+
+        switch (escaped) {
+        case '"': buffer[length++] = '"'; break;
+        case '\\': buffer[length++] = '\\'; break;
+        case '/': buffer[length++] = '/'; break;
+        case 'b': buffer[length++] = '\b'; break;
+        case 'f': buffer[length++] = '\f'; break;
+        case 'n': buffer[length++] = '\n'; break;
+        case 'r': buffer[length++] = '\r'; break;
+        case 't': buffer[length++] = '\t'; break;
+        case 'u': {
+            int codepoint = parse_unicode_escape(parser);
+            if (codepoint < 0)
+                return parse_fail(parser, "invalid unicode escape");
+            length += write_utf8(buffer + length, codepoint);
+            break;
+        }
+        default:
+            parser->pos -= 2;
+            return parse_fail(parser, "invalid escape");
+        }
+
+        runStart = parser->pos;
+        special = find_string_special(runStart, parser->end);
+    }
+
+    set_string(out, parser->buffer, length);
+}
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static void parse_number(JsonParser* parser, Value* out)
+{
+    const char* start = parser->pos;
+    const char* pos = start;
+    const char* end = parser->end;
+
+    bool negative = pos < end && *pos == '-';
+    if (negative)
+        pos++;
+
+    if (pos >= end || !is_digit(*pos))
+        return parse_fail(parser, "invalid number");
+
+    // Digits of the integer and fraction parts, as long as they fit.
+    u64 mantissa = 0;
+    int digits = 0;
+    int fractionDigits = 0;
+
+    // Integer part. Leading zeros aren't allowed.
+    if (*pos == '0') {
+        pos++;
+    } else {
+        while (pos < end && is_digit(*pos)) {
+            if (digits < 19)
+                mantissa = mantissa * 10 + (*pos - '0');
+            digits++;
+            pos++;
+        }
+    }
+
+    bool isFloat = false;
+    bool hasExponent = false;
+
+    if (pos < end && *pos == '.') {
+        pos++;
+        if (pos >= end || !is_digit(*pos)) {
+            parser->pos = pos;
+            return parse_fail(parser, "invalid number");
+        }
+        while (pos < end && is_digit(*pos)) {
+            if (digits < 19)
+                mantissa = mantissa * 10 + (*pos - '0');
+            digits++;
+            fractionDigits++;
+            pos++;
+        }
+        isFloat = true;
+    }
+
+    if (pos < end && (*pos == 'e' || *pos == 'E')) {
+        pos++;
+        if (pos < end && (*pos == '+' || *pos == '-'))
+            pos++;
+        if (pos >= end || !is_digit(*pos)) {
+            parser->pos = pos;
+            return parse_fail(parser, "invalid number");
+        }
+        while (pos < end && is_digit(*pos))
+            pos++;
+        isFloat = true;
+        hasExponent = true;
+    }
+
+    parser->pos = pos;
+
+    if (!isFloat) {
+        i64 value = negative ? -(i64) mantissa : (i64) mantissa;
+        if (digits <= 10 && value >= INT32_MIN && value <= INT32_MAX) {
+            set_int(out, (int) value);
+            return;
+        }
+    }
+
+    // Fast path: the mantissa and the power of 10 are exact doubles, so the division is
+    // rounded the same way as strtod would round the decimal text.
+    if (!hasExponent && digits <= 15 && fractionDigits <= POWERS_OF_10_MAX) {
+        double value = (double) mantissa / g_powersOf10[fractionDigits];
+        set_float(out, (float) (negative ? -value : value));
+        return;
+    }
+
+    // The input might not be NULL-terminated, so strtod reads from a copy.
+    int length = (int) (pos - start);
+    char* buffer = parser_reserve(parser, length + 1);
+    memcpy(buffer, start, length);
+    buffer[length] = 0;
+    set_float(out, (float) strtod(buffer, NULL));
+}
+
+static bool consume_literal(JsonParser* parser, const char* literal, int length)
+{
+    if (parser->end - parser->pos < length || memcmp(parser->pos, literal, length) != 0)
+        return false;
+    parser->pos += length;
+    return true;
+}
+
+static void parse_value(JsonParser* parser, Value* out, int depth);
+
+static void parse_array(JsonParser* parser, Value* out, int depth)
+{
+    // 'pos' is after the opening bracket.
+    set_list(out, 0);
+
+    skip_whitespace(parser);
+    if (parser->pos < parser->end && *parser->pos == ']') {
+        parser->pos++;
+        return;
+    }
+
+    while (true) {
+        parse_value(parser, list_append(out), depth + 1);
+        if (parser->failed)
+            return;
+
+        skip_whitespace(parser);
+        if (parser->pos >= parser->end)
+            return parse_fail(parser, "unterminated array");
+
+        char c = *parser->pos++;
+        if (c == ']')
+            return;
+        if (c != ',') {
+            parser->pos--;
+            return parse_fail(parser, "expected ',' or ']'");
+        }
+    }
+}
+
+static void parse_object(JsonParser* parser, Value* out, int depth)
+{
+    // 'pos' is after the opening brace.
+    set_hashtable(out);
+
+    skip_whitespace(parser);
+    if (parser->pos < parser->end && *parser->pos == '}') {
+        parser->pos++;
+        return;
+    }
+
+    while (true) {
+        skip_whitespace(parser);
+        if (parser->pos >= parser->end || *parser->pos != '"')
+            return parse_fail(parser, "expected a string key");
+
+        parser->pos++;
+        Value key;
+        parse_string(parser, &key);
+        if (parser->failed)
+            return;
+
+        skip_whitespace(parser);
+        if (parser->pos >= parser->end || *parser->pos != ':')
+            return parse_fail(parser, "expected ':'");
+        parser->pos++;
+
+        parse_value(parser, hashtable_insert(out, &key, true), depth + 1);
+        if (parser->failed)
+            return;
+
+        skip_whitespace(parser);
+        if (parser->pos >= parser->end)
+            return parse_fail(parser, "unterminated object");
+
+        char c = *parser->pos++;
+        if (c == '}')
+            return;
+        if (c != ',') {
+            parser->pos--;
+            return parse_fail(parser, "expected ',' or '}'");
+        }
+    }
+}
+
+static void parse_value(JsonParser* parser, Value* out, int depth)
+{
+    skip_whitespace(parser);
+
+    if (parser->pos >= parser->end)
+        return parse_fail(parser, "unexpected end of input");
+
+    // 'depth' counts the enclosing containers, so this rejects the container that would
+    // be nested JSON_MAX_DEPTH + 1 levels deep.
+    char c = *parser->pos;
+    if ((c == '[' || c == '{') && depth >= JSON_MAX_DEPTH)
+        return parse_fail(parser, "too deeply nested");
+
+    switch (c) {
+    case '"':
+        parser->pos++;
+        return parse_string(parser, out);
+    case '[':
+        parser->pos++;
+        return parse_array(parser, out, depth);
+    case '{':
+        parser->pos++;
+        return parse_object(parser, out, depth);
+    case 't':
+        if (consume_literal(parser, "true", 4))
+            return set_bool(out, true);
+        break;
+    case 'f':
+        if (consume_literal(parser, "false", 5))
+            return set_bool(out, false);
+        break;
+    case 'n':
+        if (consume_literal(parser, "null", 4))
+            return set_null(out);
+        break;
+    case '-': case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        return parse_number(parser, out);
+    }
+
+    parse_fail(parser, "unexpected character");
+}
+
+static void json_parse_at(const char* str, int length, i64 baseOffset, Value* out)
+{
+    JsonParser parser;
+    parser.start = str;
+    parser.pos = str;
+    parser.end = str + length;
+    parser.buffer = NULL;
+    parser.bufferCapacity = 0;
+    parser.baseOffset = baseOffset;
+    parser.failed = false;
+
+    parse_value(&parser, out, 0);
+
+    if (!parser.failed) {
+        skip_whitespace(&parser);
+        if (parser.pos != parser.end)
+            parse_fail(&parser, "unexpected data after value");
+    }
+
+    free(parser.buffer);
+
+    if (parser.failed)
+        set_error_string(out, as_cstring(&parser.error));
+}
+
+void json_parse(const char* str, int length, Value* out)
+{
+    json_parse_at(str, length, 0, out);
+}
+
+void json_parse(const char* str, Value* out)
+{
+    json_parse(str, (int) strlen(str), out);
+}
+
+// -- Streaming --
+
+/*
+ A JsonStream accepts input in chunks, and finds where each complete value ends. It keeps
+ a resumable scan state (nesting depth, and whether it's inside a string) so that every
+ byte is scanned once, no matter how the input is split up. When a value is complete,
+ its bytes are handed to json_parse, and then dropped. So the stream only holds onto
+ the value that's in progress.
+
+ By default the stream emits each top-level value, for input that is a sequence of
+ documents (such as newline-delimited JSON). With 'arrayElements', the input is a
+ sequence of arrays, and the stream emits each array element instead.
+*/
+
+enum JsonStreamArrayState {
+    ARRAY_OUTSIDE,
+    ARRAY_FIRST,
+    ARRAY_NEXT,
+    ARRAY_AFTER_ELEMENT
+};
+
+struct JsonStream {
+    bool arrayElements;
+
+    // Bytes of the value in progress, followed by bytes that haven't been scanned.
+    char* data;
+    int size;
+    int capacity;
+
+    // Offset of data[0] in the whole input, for error messages.
+    i64 offset;
+
+    int scanned;
+
+    // Start of the value in progress, or -1 if between values.
+    int valueStart;
+    int depth;
+    bool inString;
+    bool escape;
+
+    JsonStreamArrayState arrayState;
+
+    bool failed;
+    Value error;
+};
+
+static void json_stream_reset(JsonStream* stream)
+{
+    stream->size = 0;
+    stream->offset = 0;
+    stream->scanned = 0;
+    stream->valueStart = -1;
+    stream->depth = 0;
+    stream->inString = false;
+    stream->escape = false;
+    stream->arrayState = ARRAY_OUTSIDE;
+    stream->failed = false;
+    set_null(&stream->error);
+}
+
+JsonStream* json_stream_create(bool arrayElements)
+{
+    JsonStream* stream = new JsonStream();
+    stream->arrayElements = arrayElements;
+    stream->data = NULL;
+    stream->capacity = 0;
+    json_stream_reset(stream);
+    return stream;
+}
+
+void json_stream_free(JsonStream* stream)
+{
+    free(stream->data);
+    delete stream;
+}
+
+static void stream_fail(JsonStream* stream, const char* message, int pos)
+{
+    stream->failed = true;
+    set_parse_error(&stream->error, message, stream->offset + pos);
+}
+
+static const char* find_structural(const char* pos, const char* end)
+{
+    while (end - pos >= SCAN_WIDTH) {
+        ScanMask mask = scan_structural(pos);
+        if (mask != 0)
+            return pos + scan_mask_first(mask);
+        pos += SCAN_WIDTH;
+    }
+
+    while (pos < end && !is_structural(*pos))
+        pos++;
+    return pos;
+}
+
+// Parse the value in progress, which ends at 'end'.
+static bool stream_emit(JsonStream* stream, int end, Value* valuesOut)
+{
+    Value* value = list_append(valuesOut);
+    json_parse_at(stream->data + stream->valueStart, end - stream->valueStart,
+        stream->offset + stream->valueStart, value);
+
+    if (is_error(value)) {
+        stream->failed = true;
+        move(value, &stream->error);
+        return false;
+    }
+
+    stream->valueStart = -1;
+    if (stream->arrayElements)
+        stream->arrayState = ARRAY_AFTER_ELEMENT;
+    return true;
+}
+
+static void stream_scan(JsonStream* stream, Value* valuesOut)
+{
+    const char* data = stream->data;
+    int size = stream->size;
+    int pos = stream->scanned;
+
+    while (pos < size) {
+        if (stream->valueStart < 0) {
+            // Between values.
+            char c = data[pos];
+            if (is_json_whitespace(c)) {
+                pos++;
+                continue;
+            }
+
+            if (stream->arrayElements) {
+                if (stream->arrayState == ARRAY_OUTSIDE) {
+                    if (c != '[')
+                        return stream_fail(stream, "expected an array", pos);
+                    stream->arrayState = ARRAY_FIRST;
+                    pos++;
+                    continue;
+                }
+
+                if (stream->arrayState == ARRAY_AFTER_ELEMENT) {
+                    if (c == ',')
+                        stream->arrayState = ARRAY_NEXT;
+                    else if (c == ']')
+                        stream->arrayState = ARRAY_OUTSIDE;
+                    else
+                        return stream_fail(stream, "expected ',' or ']'", pos);
+                    pos++;
+                    continue;
+                }
+
+                if (c == ']' && stream->arrayState == ARRAY_FIRST) {
+                    stream->arrayState = ARRAY_OUTSIDE;
+                    pos++;
+                    continue;
+                }
+            }
+
+            if (c == ',' || c == ':' || c == ']' || c == '}')
+                return stream_fail(stream, "unexpected character", pos);
+
+            stream->valueStart = pos;
+            if (c == '[' || c == '{')
+                stream->depth = 1;
+            else if (c == '"')
+                stream->inString = true;
+            pos++;
+
+        } else if (stream->inString) {
+            if (stream->escape) {
+                stream->escape = false;
+                pos++;
+                continue;
+            }
+
+            pos = (int) (find_string_special(data + pos, data + size) - data);
+            if (pos >= size)
+                break;
+
+            // Control characters are left for json_parse to reject.
+            char c = data[pos++];
+            if (c == '\\') {
+                stream->escape = true;
+            } else if (c == '"') {
+                stream->inString = false;
+                if (stream->depth == 0 && !stream_emit(stream, pos, valuesOut))
+                    return;
+            }
+
+        } else if (stream->depth > 0) {
+            // Mismatched brackets are left for json_parse to reject.
+            pos = (int) (find_structural(data + pos, data + size) - data);
+            if (pos >= size)
+                break;
+
+            char c = data[pos++];
+            if (c == '"') {
+                stream->inString = true;
+            } else if (c == '[' || c == '{') {
+                stream->depth++;
+            } else {
+                stream->depth--;
+                if (stream->depth == 0 && !stream_emit(stream, pos, valuesOut))
+                    return;
+            }
+
+        } else {
+            // A number or literal, which ends at the first delimiter. The delimiter is
+            // scanned again as the start of whatever comes next.
+            char c = data[pos];
+            if (is_json_whitespace(c) || is_structural(c) || c == ',' || c == ':') {
+                if (!stream_emit(stream, pos, valuesOut))
+                    return;
+            } else {
+                pos++;
+            }
+        }
+    }
+
+    stream->scanned = pos;
+}
+
+// Drop bytes that aren't part of the value in progress.
+static void stream_compact(JsonStream* stream)
+{
+    int keep = stream->valueStart >= 0 ? stream->valueStart : stream->scanned;
+    if (keep == 0)
+        return;
+
+    memmove(stream->data, stream->data + keep, stream->size - keep);
+    stream->size -= keep;
+    stream->scanned -= keep;
+    stream->offset += keep;
+    if (stream->valueStart >= 0)
+        stream->valueStart = 0;
+}
+
+void json_stream_push(JsonStream* stream, const char* data, int length, Value* valuesOut)
+{
+    set_list(valuesOut, 0);
+
+    if (!stream->failed) {
+        if (stream->size + length > stream->capacity) {
+            int capacity = stream->capacity < 256 ? 256 : stream->capacity;
+            while (capacity < stream->size + length)
+                capacity *= 2;
+            stream->data = (char*) ca_realloc(stream->data, capacity);
+            stream->capacity = capacity;
+        }
+
+        memcpy(stream->data + stream->size, data, length);
+        stream->size += length;
+
+        stream_scan(stream, valuesOut);
+        stream_compact(stream);
+    }
+
+    if (stream->failed)
+        set_error_string(valuesOut, as_cstring(&stream->error));
+}
+
+void json_stream_finish(JsonStream* stream, Value* valuesOut)
+{
+    set_list(valuesOut, 0);
+
+    if (!stream->failed) {
+        // A number or literal at the very end has nothing after it to end it.
+        if (stream->valueStart >= 0 && stream->depth == 0 && !stream->inString)
+            stream_emit(stream, stream->size, valuesOut);
+
+        if (!stream->failed && (stream->valueStart >= 0
+                || stream->arrayState != ARRAY_OUTSIDE))
+            stream_fail(stream, "unexpected end of input", stream->size);
+    }
+
+    if (stream->failed)
+        set_error_string(valuesOut, as_cstring(&stream->error));
+
+    json_stream_reset(stream);
+}
+
+// -- Writing --
+
+struct JsonWriter {
+    char* data;
+    int size;
+    int capacity;
+
+    bool failed;
+    Value error;
+};
+
+static char* writer_reserve(JsonWriter* writer, int size)
+{
+    if (writer->size + size > writer->capacity) {
+        int capacity = writer->capacity < 256 ? 256 : writer->capacity;
+        while (capacity < writer->size + size)
+            capacity *= 2;
+        writer->data = (char*) ca_realloc(writer->data, capacity);
+        writer->capacity = capacity;
+    }
+    return writer->data + writer->size;
+}
+
+static void writer_append(JsonWriter* writer, const char* str, int length)
+{
+    memcpy(writer_reserve(writer, length), str, length);
+    writer->size += length;
+}
+
+static void writer_append_char(JsonWriter* writer, char c)
+{
+    *writer_reserve(writer, 1) = c;
+    writer->size++;
+}
+
+static void write_string(JsonWriter* writer, const char* str, int length)
+{
+    // Worst case is 6 output bytes (\u00XX) for each input byte.
+    char* out = writer_reserve(writer, length * 6 + 2);
+    char* start = out;
+    const char* pos = str;
+    const char* end = str + length;
+
+    *out++ = '"';
+
+    while (pos < end) {
+        const char* special = find_string_special(pos, end);
+        memcpy(out, pos, special - pos);
+        out += special - pos;
+        pos = special;
+
+        if (pos >= end)
+            break;
+
+        char c = *pos++;
+        *out++ = '\\';
+        switch (c) {
+        case '"': *out++ = '"'; break;
+        case '\\': *out++ = '\\'; break;
+        case '\b': *out++ = 'b'; break;
+        case '\f': *out++ = 'f'; break;
+        case '\n': *out++ = 'n'; break;
+        case '\r': *out++ = 'r'; break;
+        case '\t': *out++ = 't'; break;
+        default: {
+            const char* hex = "0123456789abcdef";
+            *out++ = 'u';
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = hex[(c >> 4) & 0xf];
+            *out++ = hex[c & 0xf];
+        }
+        }
+    }
+
+    *out++ = '"';
+    writer->size += (int) (out - start);
+}
+
+// Write the decimal digits of 'value' ending just before 'end'. Returns the start.
+static char* write_digits_backwards(char* end, u64 value)
+{
+    do {
+        *--end = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return end;
+}
+
+static void write_int(JsonWriter* writer, int value)
+{
+    char buf[16];
+    char* end = buf + sizeof(buf);
+    u64 magnitude = value < 0 ? (u64) -(i64) value : (u64) value;
+    char* start = write_digits_backwards(end, magnitude);
+    if (value < 0)
+        *--start = '-';
+    writer_append(writer, start, (int) (end - start));
+}
+
+// The float fast path writes fixed-point numbers with up to this many decimal places.
+const int FLOAT_FAST_MAX_DECIMALS = 12;
+
+static void write_float(JsonWriter* writer, float value)
+{
+    if (value != value || value - value != 0) {
+        // NaN and infinity can't be written as JSON.
+        writer_append(writer, "null", 4);
+        return;
+    }
+
+    // Fast path for ordinary magnitudes: find the fewest decimal places that read back
+    // as the same float. 'scaled' and the power of 10 are both exact doubles, so the
+    // division rounds the same way that the parser's strtod does.
+    float magnitude = fabsf(value);
+    if (magnitude >= 1e-5f && magnitude < 1e9f) {
+        for (int decimals = 0; decimals <= FLOAT_FAST_MAX_DECIMALS; decimals++) {
+            double scaled = floor((double) magnitude * g_powersOf10[decimals] + 0.5);
+            if (scaled >= 1e15)
+                break;
+            if ((float) (scaled / g_powersOf10[decimals]) != magnitude)
+                continue;
+
+            char buf[40];
+            char* end = buf + sizeof(buf);
+            char* pos = end;
+            u64 fixed = (u64) scaled;
+
+            if (decimals == 0) {
+                *--pos = '0';
+            } else {
+                for (int i=0; i < decimals; i++) {
+                    *--pos = (char) ('0' + fixed % 10);
+                    fixed /= 10;
+                }
+            }
+            *--pos = '.';
+            pos = write_digits_backwards(pos, fixed);
+            if (value < 0)
+                *--pos = '-';
+
+            writer_append(writer, pos, (int) (end - pos));
+            return;
+        }
+    }
+
+    // Otherwise use the shortest representation that reads back as the same float.
+    char buf[32];
+    int length = 0;
+    for (int precision = 6; precision <= 9; precision++) {
+        length = sprintf(buf, "%.*g", precision, value);
+        if ((float) strtod(buf, NULL) == value)
+            break;
+    }
+
+    writer_append(writer, buf, length);
+
+    // Make sure it reads back as a float, not an int.
+    if (strpbrk(buf, ".eE") == NULL)
+        writer_append(writer, ".0", 2);
+}
+
+static void write_value(JsonWriter* writer, Value* value, int depth);
+
+static void write_key(JsonWriter* writer, Value* key)
+{
+    if (is_string(key)) {
+        write_string(writer, as_cstring(key), string_length(key));
+    } else if (is_symbol(key)) {
+        const char* str = symbol_as_string(key);
+        write_string(writer, str, (int) strlen(str));
+    } else {
+        Value str;
+        to_string(key, &str);
+        write_string(writer, as_cstring(&str), string_length(&str));
+    }
+}
+
+static void write_value(JsonWriter* writer, Value* value, int depth)
+{
+    if (writer->failed)
+        return;
+
+    if (depth >= JSON_MAX_DEPTH && (is_hashtable(value) || is_list_based(value))) {
+        writer->failed = true;
+        set_string(&writer->error, "json: value is too deeply nested");
+        return;
+    }
+
+    if (is_null(value)) {
+        writer_append(writer, "null", 4);
+    } else if (is_bool(value)) {
+        if (as_bool(value))
+            writer_append(writer, "true", 4);
+        else
+            writer_append(writer, "false", 5);
+    } else if (is_int(value)) {
+        write_int(writer, as_int(value));
+    } else if (is_float(value)) {
+        write_float(writer, as_float(value));
+    } else if (is_string(value)) {
+        write_string(writer, as_cstring(value), string_length(value));
+    } else if (is_symbol(value)) {
+        const char* str = symbol_as_string(value);
+        write_string(writer, str, (int) strlen(str));
+    } else if (is_hashtable(value)) {
+        writer_append_char(writer, '{');
+        bool first = true;
+        for (HashtableIterator it(value); it; ++it) {
+            if (!first)
+                writer_append_char(writer, ',');
+            first = false;
+            write_key(writer, it.key());
+            writer_append_char(writer, ':');
+            write_value(writer, it.value(), depth + 1);
+        }
+        writer_append_char(writer, '}');
+    } else if (is_struct(value)) {
+        Type* type = value->value_type;
+        writer_append_char(writer, '{');
+        int count = compound_type_get_field_count(type);
+        for (int i=0; i < count; i++) {
+            if (i > 0)
+                writer_append_char(writer, ',');
+            write_key(writer, compound_type_get_field_name(type, i));
+            writer_append_char(writer, ':');
+            write_value(writer, list_get(value, i), depth + 1);
+        }
+        writer_append_char(writer, '}');
+    } else if (is_list_based(value) && !is_func(value)) {
+        writer_append_char(writer, '[');
+        int count = list_length(value);
+        for (int i=0; i < count; i++) {
+            if (i > 0)
+                writer_append_char(writer, ',');
+            write_value(writer, list_get(value, i), depth + 1);
+        }
+        writer_append_char(writer, ']');
+    } else {
+        writer->failed = true;
+        set_string(&writer->error, "json: can't write a value of type ");
+        string_append(&writer->error, &value->value_type->name);
+    }
+}
+
+void json_write(Value* value, Value* out)
+{
+    ca_assert(value != out);
+
+    JsonWriter writer;
+    writer.data = NULL;
+    writer.size = 0;
+    writer.capacity = 0;
+    writer.failed = false;
+
+    write_value(&writer, value, 0);
+
+    if (writer.failed)
+        set_error_string(out, as_cstring(&writer.error));
+    else
+        set_string(out, writer.data, writer.size);
+
+    free(writer.data);
+}
+
+void parse_json(VM* vm)
+{
+    Value* out = vm->output();
+    json_parse(as_cstring(vm->input(0)), string_length(vm->input(0)), out);
+    if (is_error(out))
+        vm->throw_str(as_cstring(out));
+}
+
+void to_json(VM* vm)
+{
+    Value* out = vm->output();
+    json_write(vm->input(0), out);
+    if (is_error(out))
+        vm->throw_str(as_cstring(out));
+}
+
+static void json_stream_release(void* ptr)
+{
+    json_stream_free((JsonStream*) ptr);
+}
+
+static JsonStream* as_json_stream(Value* value)
+{
+    return (JsonStream*) as_native_ptr(value->index(0));
+}
+
+void make_json_stream(VM* vm)
+{
+    JsonStream* stream = json_stream_create(vm->input(0)->as_b());
+    Value* out = vm->output();
+    make(TYPES.json_stream, out);
+    set_native_ptr(out->index(0), stream, json_stream_release);
+}
+
+void JsonStream__push(VM* vm)
+{
+    JsonStream* stream = as_json_stream(vm->input(0));
+    Value* chunk = vm->input(1);
+    Value* out = vm->output();
+
+    if (is_string(chunk))
+        json_stream_push(stream, as_cstring(chunk), string_length(chunk), out);
+    else if (is_blob(chunk))
+        json_stream_push(stream, blob_data_flat(chunk), blob_size(chunk), out);
+    else
+        return vm->throw_str("JsonStream.push: expected a String or Blob");
+
+    if (is_error(out))
+        vm->throw_str(as_cstring(out));
+}
+
+void JsonStream__finish(VM* vm)
+{
+    Value* out = vm->output();
+    json_stream_finish(as_json_stream(vm->input(0)), out);
+    if (is_error(out))
+        vm->throw_str(as_cstring(out));
+}
+
+void json_install_functions(NativePatch* patch)
+{
+    circa_patch_function(patch, "parse_json", parse_json);
+    circa_patch_function(patch, "to_json", to_json);
+    circa_patch_function(patch, "json_stream", make_json_stream);
+    circa_patch_function(patch, "JsonStream.push", JsonStream__push);
+    circa_patch_function(patch, "JsonStream.finish", JsonStream__finish);
+}
+
+} // namespace circa
+
+using namespace circa;
+
+CIRCA_EXPORT void circa_parse_json(Value* in, Value* out)
+{
+    ca_assert(in != out);
+    json_parse(as_cstring(in), string_length(in), out);
+}
+
+CIRCA_EXPORT void circa_parse_json_len(const char* str, int length, Value* out)
+{
+    json_parse(str, length, out);
+}
+
+CIRCA_EXPORT void circa_to_json(Value* in, Value* out)
+{
+    json_write(in, out);
+}
+
+CIRCA_EXPORT caJsonStream* circa_new_json_stream(bool arrayElements)
+{
+    return json_stream_create(arrayElements);
+}
+
+CIRCA_EXPORT void circa_free_json_stream(caJsonStream* stream)
+{
+    json_stream_free(stream);
+}
+
+CIRCA_EXPORT void circa_json_stream_push(caJsonStream* stream, const char* data, int len,
+    caValue* valuesOut)
+{
+    json_stream_push(stream, data, len, valuesOut);
+}
+
+CIRCA_EXPORT void circa_json_stream_finish(caJsonStream* stream, caValue* valuesOut)
+{
+    json_stream_finish(stream, valuesOut);
+}
@@ -4,7 +4,30 @@
 
 namespace circa {
 
+// Parse a JSON document. On failure, 'valueOut' is an error value with a message.
+void json_parse(const char* str, int length, Value* valueOut);
 void json_parse(const char* str, Value* valueOut);
+
+// Write a value as JSON. On failure (for a value that has no JSON form), 'stringOut' is
+// an error value with a message.
 void json_write(Value* value, Value* stringOut);
 
+// Incremental parser, for input that arrives in chunks. If 'arrayElements' is true, the
+// input is one or more arrays, and each array element is emitted on its own. Otherwise
+// each top-level value is emitted.
+JsonStream* json_stream_create(bool arrayElements);
+void json_stream_free(JsonStream* stream);
+
+// Add a chunk of input. 'valuesOut' is set to a list of the values that were completed by
+// this chunk. If the input is invalid, 'valuesOut' is an error value, and so is the
+// result of each later push until the stream is finished.
+void json_stream_push(JsonStream* stream, const char* data, int length, Value* valuesOut);
+
+// Mark the end of the input, and reset the stream so that it can be used again. 'valuesOut'
+// is set to a list of any values that were completed by the end (such as a trailing
+// number), or an error value if the input ended in the middle of a value.
+void json_stream_finish(JsonStream* stream, Value* valuesOut);
+
+void json_install_functions(NativePatch* patch);
+
 }
@@ -2,9 +2,12 @@
 
 #include "common_headers.h"
 
+#include <atomic>
+
 #include "circa/circa.h"
 #include "circa/file.h"
 
+#include "binary_repr.h"
 #include "blob.h"
 #include "block.h"
 #include "building.h"
@@ -15,6 +18,7 @@
 #include "function.h"
 #include "hashtable.h"
 #include "inspection.h"
+#include "json.h"
 #include "kernel.h"
 #include "list.h"
 #include "modules.h"
@@ -33,13 +37,18 @@
 #include "type.h"
 #include "world.h"
 #include "vm.h"
+#include "worker_pool.h"
 
 namespace circa {
 
-World* g_world = NULL;
+CIRCA_THREAD_LOCAL World* g_world = NULL;
+
+CIRCA_THREAD_LOCAL BuiltinFuncs FUNCS;
+CIRCA_THREAD_LOCAL BuiltinTypes TYPES;
 
-BuiltinFuncs FUNCS;
-BuiltinTypes TYPES;
+// Number of Worlds that have been initialized and not shut down, across all threads. The
+// symbol table is shared between them.
+static std::atomic<int> g_liveWorldCount(0);
 
 void* ca_realloc(void* data, u32 newSize)
 {
@@ -430,7 +439,8 @@ void bootstrap_kernel()
     create_type_value(builtins, TYPES.void_type, "void");
     create_type_value(builtins, TYPES.vm, "VM");
 
-    // Create global symbol table (requires Hashtable type)
+    // Create global symbol table, if this is the first World.
+    g_liveWorldCount++;
     symbol_initialize_global_table();
 
     // Setup output_placeholder() function, needed to declare functions properly.
@@ -466,13 +476,16 @@ void bootstrap_kernel()
     parse(builtins, parse_statement_list, find_builtin_file("$builtins/stdlib.ca"));
     set_string(block_insert_property(builtins, s_ModuleName), "stdlib");
 
+    binary_repr_install_functions(world->builtinPatch);
     blob_install_functions(world->builtinPatch);
     selector_setup_funcs(world->builtinPatch);
     closures_install_functions(world->builtinPatch);
+    json_install_functions(world->builtinPatch);
     reflection_install_functions(world->builtinPatch);
     misc_builtins_setup_functions(world->builtinPatch);
     type_install_functions(world->builtinPatch);
     vm_install_functions(world->builtinPatch);
+    worker_pool_install_functions(world->builtinPatch);
 
     block_set_bool_prop(builtins, s_Builtins, true);
 
@@ -494,8 +507,10 @@ void bootstrap_kernel()
     // Finish setting up types that are declared in stdlib.ca.
     TYPES.color = as_type(builtins->get("Color"));
     TYPES.func = as_type(builtins->get("Func"));
+    TYPES.json_stream = as_type(builtins->get("JsonStream"));
     TYPES.module_ref = as_type(builtins->get("Module"));
     TYPES.vec2 = as_type(builtins->get("Vec2"));
+    TYPES.worker_pool = as_type(builtins->get("WorkerPool"));
 
     // Fix function_decl now that Func type is available.
     {
@@ -719,8 +734,6 @@ CIRCA_EXPORT caWorld* circa_initialize()
 
 CIRCA_EXPORT void circa_shutdown(caWorld* world)
 {
-    symbol_deinitialize_global_table();
-
     world_uninitialize(world);
 
     for_each_root_type(predelete_type);
@@ -730,6 +743,10 @@ CIRCA_EXPORT void circa_shutdown(caWorld* world)
     memset(&TYPES, 0, sizeof(TYPES));
 
     dealloc_world(world);
+    g_world = NULL;
+
+    if (--g_liveWorldCount == 0)
+        symbol_deinitialize_global_table();
 }
 
 } // namespace circa
@@ -122,6 +122,7 @@ struct BuiltinTypes {
     Type* float_type;
     Type* func;
     Type* int_type;
+    Type* json_stream;
     Type* list;
     Type* table;
     Type* module_ref;
@@ -137,14 +138,15 @@ struct BuiltinTypes {
     Type* type;
     Type* vm;
     Type* void_type;
+    Type* worker_pool;
 };
 
 extern Value* str_evaluationEmpty;
 extern Value* str_hasEffects;
 extern Value* str_origin;
 
-extern BuiltinFuncs FUNCS;
-extern BuiltinTypes TYPES;
+extern CIRCA_THREAD_LOCAL BuiltinFuncs FUNCS;
+extern CIRCA_THREAD_LOCAL BuiltinTypes TYPES;
 
 World* global_world();
 Block* global_builtins_block();
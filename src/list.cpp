@@ -11,6 +11,208 @@
 
 namespace circa {
 
+/*
+ List tries
+
+ A flat list has to copy every element when a shared list is touched. So when a large
+ list is duplicated, the copy is stored as a trie of refcounted chunks instead (a
+ persistent vector). Duplicating a trie list only creates a new ListData that shares the
+ root node. Writing to an element copies just the nodes on the path to that element, and
+ only the ones that are still shared.
+
+ Each node has LIST_TRIE_WIDTH entries. Leaf nodes (height 0) hold values, branch nodes
+ hold child pointers, which are NULL past the end of the list. Elements past 'count' are
+ always null.
+
+ list_get on a trie list that isn't shared (refCount is 1) makes the path to that element
+ unique before returning, since the caller may write to it. Pointers into a unique trie
+ stay valid until the list is resized.
+
+ Operations that rearrange elements (insert, remove) work through list_get, or flatten
+ the list first.
+*/
+
+ListData* allocate_list(int count, int capacity);
+
+#define LIST_TRIE_MIN_COUNT 64
+#define LIST_TRIE_BITS 5
+#define LIST_TRIE_WIDTH (1 << LIST_TRIE_BITS)
+#define LIST_TRIE_MASK (LIST_TRIE_WIDTH - 1)
+
+struct ListTrieLeaf {
+    int refCount;
+    Value items[LIST_TRIE_WIDTH];
+};
+
+struct ListTrieBranch {
+    int refCount;
+    void* children[LIST_TRIE_WIDTH];
+};
+
+static int* trie_node_refcount(void* node)
+{
+    // Both node types start with refCount.
+    return (int*) node;
+}
+
+static ListTrieLeaf* trie_new_leaf()
+{
+    ListTrieLeaf* leaf = (ListTrieLeaf*) malloc(sizeof(ListTrieLeaf));
+    leaf->refCount = 1;
+    for (int i=0; i < LIST_TRIE_WIDTH; i++)
+        initialize_null(&leaf->items[i]);
+    return leaf;
+}
+
+static ListTrieBranch* trie_new_branch()
+{
+    ListTrieBranch* branch = (ListTrieBranch*) malloc(sizeof(ListTrieBranch));
+    branch->refCount = 1;
+    for (int i=0; i < LIST_TRIE_WIDTH; i++)
+        branch->children[i] = NULL;
+    return branch;
+}
+
+static void trie_node_decref(void* node, int height)
+{
+    int* refCount = trie_node_refcount(node);
+    ca_assert(*refCount > 0);
+    (*refCount)--;
+    if (*refCount > 0)
+        return;
+
+    if (height == 0) {
+        ListTrieLeaf* leaf = (ListTrieLeaf*) node;
+        for (int i=0; i < LIST_TRIE_WIDTH; i++)
+            set_null(&leaf->items[i]);
+    } else {
+        ListTrieBranch* branch = (ListTrieBranch*) node;
+        for (int i=0; i < LIST_TRIE_WIDTH; i++)
+            if (branch->children[i] != NULL)
+                trie_node_decref(branch->children[i], height - 1);
+    }
+    free(node);
+}
+
+static void* trie_node_duplicate(void* node, int height)
+{
+    stat_increment(ListTrieNodeCopy);
+
+    if (height == 0) {
+        ListTrieLeaf* leaf = (ListTrieLeaf*) node;
+        ListTrieLeaf* dup = trie_new_leaf();
+        for (int i=0; i < LIST_TRIE_WIDTH; i++)
+            copy(&leaf->items[i], &dup->items[i]);
+        return dup;
+    }
+
+    ListTrieBranch* branch = (ListTrieBranch*) node;
+    ListTrieBranch* dup = trie_new_branch();
+    for (int i=0; i < LIST_TRIE_WIDTH; i++) {
+        dup->children[i] = branch->children[i];
+        if (dup->children[i] != NULL)
+            (*trie_node_refcount(dup->children[i]))++;
+    }
+    return dup;
+}
+
+static int trie_capacity(int height)
+{
+    return LIST_TRIE_WIDTH << (height * LIST_TRIE_BITS);
+}
+
+static int trie_child_index(int index, int height)
+{
+    return (index >> (height * LIST_TRIE_BITS)) & LIST_TRIE_MASK;
+}
+
+// Read-only lookup.
+static Value* trie_get(ListData* data, int index)
+{
+    void* node = data->trie;
+    for (int height = data->trieHeight; height > 0; height--)
+        node = ((ListTrieBranch*) node)->children[trie_child_index(index, height)];
+    return &((ListTrieLeaf*) node)->items[index & LIST_TRIE_MASK];
+}
+
+// Lookup for writing. Copies any shared node on the path, and creates missing nodes.
+// 'data' must not be shared.
+static Value* trie_get_for_write(ListData* data, int index)
+{
+    ca_assert(data->refCount == 1);
+    ca_assert(index < trie_capacity(data->trieHeight));
+
+    void** nodePtr = &data->trie;
+
+    for (int height = data->trieHeight;; height--) {
+        if (*nodePtr == NULL) {
+            if (height == 0)
+                *nodePtr = trie_new_leaf();
+            else
+                *nodePtr = trie_new_branch();
+        } else if (*trie_node_refcount(*nodePtr) > 1) {
+            void* dup = trie_node_duplicate(*nodePtr, height);
+            trie_node_decref(*nodePtr, height);
+            *nodePtr = dup;
+        }
+
+        if (height == 0)
+            return &((ListTrieLeaf*) *nodePtr)->items[index & LIST_TRIE_MASK];
+
+        nodePtr = &((ListTrieBranch*) *nodePtr)->children[trie_child_index(index, height)];
+    }
+}
+
+// Add an element to the end of a trie list. 'data' must not be shared.
+static Value* trie_append(ListData* data)
+{
+    if (data->count == trie_capacity(data->trieHeight)) {
+        ListTrieBranch* root = trie_new_branch();
+        root->children[0] = data->trie;
+        data->trie = root;
+        data->trieHeight++;
+    }
+
+    Value* element = trie_get_for_write(data, data->count);
+    data->count++;
+    return element;
+}
+
+// Create a trie list with a copy of each element in 'source'.
+static ListData* list_create_trie_copy(ListData* source)
+{
+    ListData* result = allocate_list(0, 0);
+    for (int i=0; i < source->count; i++) {
+        stat_increment(ListDuplicate_ElementCopy);
+        copy(list_get(source, i), trie_append(result));
+    }
+    return result;
+}
+
+// Like list_touch, but the result is always a flat list.
+static ListData* list_touch_flat(ListData* data)
+{
+    if (data == NULL || (data->trie == NULL && data->refCount == 1))
+        return data;
+
+    if (data->refCount > 1) {
+        stat_increment(ListDuplicate);
+        if (data->count >= 100)
+            stat_increment(ListDuplicate_100Count);
+    }
+
+    ListData* result = allocate_list(data->count, data->count);
+    for (int i=0; i < data->count; i++) {
+        stat_increment(ListDuplicate_ElementCopy);
+        if (data->trie != NULL)
+            copy(trie_get(data, i), &result->items[i]);
+        else
+            copy(&data->items[i], &result->items[i]);
+    }
+    list_decref(data);
+    return result;
+}
+
 void ListData::dump()
 {
     Value str;
@@ -27,11 +229,15 @@ ListData* allocate_list(int count, int capacity)
 {
     ca_assert(count <= capacity);
 
+    stat_increment(ListsCreated);
+
     ListData* data = (ListData*) malloc(list_size(capacity));
 
     data->refCount = 1;
     data->count = count;
     data->capacity = capacity;
+    data->trieHeight = 0;
+    data->trie = NULL;
     initialize_null(&data->attrs);
     for (int i=0; i < capacity; i++)
         initialize_null(&data->items[i]);
@@ -59,7 +265,9 @@ void free_list(ListData* data)
         return;
 
     // Release all elements
-    for (int i=0; i < data->count; i++)
+    if (data->trie != NULL)
+        trie_node_decref(data->trie, data->trieHeight);
+    for (int i=0; i < data->count && i < data->capacity; i++)
         set_null(&data->items[i]);
     set_null(&data->attrs);
     free(data);
@@ -76,6 +284,13 @@ Value* list_get(ListData* data, int index)
     ca_assert(data != NULL);
     ca_assert(index < data->count);
     ca_assert(index >= 0);
+
+    if (data->trie != NULL) {
+        if (data->refCount == 1)
+            return trie_get_for_write(data, index);
+        return trie_get(data, index);
+    }
+
     return &data->items[index];
 }
 Value* list_get_from_end(ListData* data, int index)
@@ -83,7 +298,7 @@ Value* list_get_from_end(ListData* data, int index)
     ca_assert(data != NULL);
     ca_assert(index < data->count);
     ca_assert(index >= 0);
-    return &data->items[data->count - index - 1];
+    return list_get(data, data->count - index - 1);
 }
 
 ListData* list_touch(ListData* original)
@@ -106,11 +321,25 @@ ListData* list_duplicate(ListData* source)
 
     stat_increment(ListDuplicate);
 
-    ListData* result = allocate_list(source->count, source->capacity);
-    
+    if (source->trie != NULL) {
+        // Share the root node.
+        stat_increment(ListDuplicate_Trie);
+        ListData* result = allocate_list(0, 0);
+        result->count = source->count;
+        result->trieHeight = source->trieHeight;
+        result->trie = source->trie;
+        (*trie_node_refcount(result->trie))++;
+        return result;
+    }
+
     if (source->count >= 100)
         stat_increment(ListDuplicate_100Count);
 
+    if (source->count >= LIST_TRIE_MIN_COUNT)
+        return list_create_trie_copy(source);
+
+    ListData* result = allocate_list(source->count, source->capacity);
+
     for (int i=0; i < source->count; i++) {
         stat_increment(ListDuplicate_ElementCopy);
         copy(&source->items[i], &result->items[i]);
@@ -124,6 +353,8 @@ ListData* list_increase_capacity(ListData* original, int newCapacity)
     if (original == NULL)
         return allocate_list(0, newCapacity);
 
+    ca_assert(original->trie == NULL);
+
     bool createCopy = original->refCount > 1;
 
     if (createCopy) {
@@ -175,6 +406,23 @@ ListData* list_resize(ListData* original, int newLength)
     if (original->count == newLength)
         return original;
 
+    // Touch first, this might turn a large shared list into a trie.
+    original = list_touch(original);
+
+    if (original->trie != NULL) {
+        ListData* result = original;
+
+        while (result->count < newLength)
+            trie_append(result);
+
+        // Nullify discarded elements
+        for (int i=newLength; i < result->count; i++)
+            set_null(trie_get_for_write(result, i));
+
+        result->count = newLength;
+        return result;
+    }
+
     ListData* result = NULL;
 
     if (newLength > original->capacity) {
@@ -189,7 +437,7 @@ ListData* list_resize(ListData* original, int newLength)
     } else {
 
         // Shrink list
-        result = list_touch(original);
+        result = original;
 
         // Nullify discarded elements
         for (int i=newLength; i < result->count; i++)
@@ -207,6 +455,9 @@ Value* list_append(ListData** dataPtr)
         *dataPtr = allocate_list(0, 1);
     } else {
         *dataPtr = list_touch(*dataPtr);
+
+        if ((*dataPtr)->trie != NULL)
+            return trie_append(*dataPtr);
         
         if ((*dataPtr)->count == (*dataPtr)->capacity)
             *dataPtr = list_double_capacity(*dataPtr);
@@ -229,6 +480,7 @@ Value* list_last(Value* list)
 
 Value* list_insert(ListData** dataPtr, int index)
 {
+    *dataPtr = list_touch_flat(*dataPtr);
     list_append(dataPtr);
 
     ListData* data = *dataPtr;
@@ -252,13 +504,13 @@ void list_remove_and_replace_with_last_element(ListData** data, int index)
     *data = list_touch(*data);
     ca_assert(index < (*data)->count);
 
-    set_null(&(*data)->items[index]);
+    set_null(list_get(*data, index));
 
     int lastElement = (*data)->count - 1;
     if (index < lastElement)
-        swap(&(*data)->items[index], &(*data)->items[lastElement]);
+        swap(list_get(*data, index), list_get(*data, lastElement));
 
-    (*data)->count--;
+    *data = list_resize(*data, lastElement);
 }
 
 void list_remove_nulls(ListData** dataPtr)
@@ -271,10 +523,10 @@ void list_remove_nulls(ListData** dataPtr)
 
     int numRemoved = 0;
     for (int i=0; i < data->count; i++) {
-        if (is_null(&data->items[i]))
+        if (is_null(list_get(data, i)))
             numRemoved++;
-        else
-            swap(&data->items[i - numRemoved], &data->items[i]);
+        else if (numRemoved > 0)
+            swap(list_get(data, i - numRemoved), list_get(data, i));
     }
     *dataPtr = list_resize(*dataPtr, data->count - numRemoved);
 }
@@ -307,7 +559,7 @@ void list_to_string(ListData* value, Value* out)
     for (int i=0; i < value->count; i++) {
         if (i > 0)
             string_append(out, ", ");
-        to_string(&value->items[i], out);
+        to_string(list_get(value, i), out);
     }
     string_append(out, "]");
 }
@@ -348,6 +600,7 @@ void list_slice(Value* original, int start, int end, Value* result)
 
 void list_reverse(Value* list)
 {
+    list_touch(list);
     int count = list_length(list);
     for (int i=0; i < count/2; i++) {
         swap(list_get(list, i), list_get(list, count - i - 1));
@@ -499,7 +752,7 @@ Value* list_get_safe(Value* value, int index)
 ListData* list_remove_index(ListData* original, int index)
 {
     ca_assert(index < original->count);
-    ListData* result = list_touch(original);
+    ListData* result = list_touch_flat(original);
 
     for (int i=index; i < result->count - 1; i++)
         swap(&result->items[i], &result->items[i+1]);
@@ -954,7 +1207,7 @@ namespace list_t {
         Value relativeIdentifier;
         for (int i=0; i < data->count; i++) {
             set_int(&relativeIdentifier, i);
-            callback(&data->items[i], &relativeIdentifier, context);
+            callback(list_get(data, i), &relativeIdentifier, context);
         }
     }
 
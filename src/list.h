@@ -19,10 +19,15 @@ struct ListData {
     int refCount;
     int count;
     int capacity;
-    int checksum;
+
+    // Large lists can store their elements in a trie of refcounted chunks, instead of in
+    // 'items'. See "List tries" in list.cpp. 'trie' is NULL for a flat list.
+    int trieHeight;
+    void* trie;
+
     Value attrs;
 
-    // items has size [capacity].
+    // items has size [capacity]. Unused for a trie list.
     Value items[0];
 
     // for debugging:
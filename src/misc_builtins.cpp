@@ -26,11 +26,12 @@
 #include "world.h"
 
 #include "ext/perlin.h"
+#include "ext/read_tar.h"
 
 namespace circa {
 
-Value* g_oracleValues;
-Value* g_spyValues;
+CIRCA_THREAD_LOCAL Value* g_oracleValues;
+CIRCA_THREAD_LOCAL Value* g_spyValues;
 
 void abs(VM* vm)
 {
@@ -998,6 +999,16 @@ void String__to_int(VM* vm)
     set_int(circa_output(vm), n);
 }
 
+void String__to_symbol(VM* vm)
+{
+    set_symbol_from_string(circa_output(vm), circa_input(vm, 0));
+}
+
+void Symbol__id(VM* vm)
+{
+    set_int(circa_output(vm), as_symbol(circa_input(vm, 0)));
+}
+
 void String__to_upper(VM* vm)
 {
     const char* in = circa_input(vm, 0)->as_str();
@@ -1072,6 +1083,25 @@ void file__read_text(Stack* stack)
 }
 #endif
 
+void file_read_mapped(VM* vm)
+{
+    circa_read_file_mapped(vm->world, circa_string_input(vm, 0), vm->output());
+    if (is_null(vm->output()))
+        vm->throw_str("File not found");
+}
+
+void tar_index(VM* vm)
+{
+    tar_build_index(vm->input(0), vm->output());
+}
+
+void tar_read(VM* vm)
+{
+    tar_read_file(vm->input(0), vm->input(1), vm->input(2), vm->output());
+    if (is_null(vm->output()))
+        vm->throw_str("File not found");
+}
+
 void typeof_func(VM* vm)
 {
     set_type(vm->output(), get_value_type(vm->input(0)));
@@ -1440,6 +1470,10 @@ void misc_builtins_setup_functions(NativePatch* patch)
     circa_patch_function(patch, "Table.set", Table__set);
     circa_patch_function(patch, "Table.empty", Table__empty);
 
+    circa_patch_function(patch, "file_read_mapped", file_read_mapped);
+    circa_patch_function(patch, "tar_index", tar_index);
+    circa_patch_function(patch, "tar_read", tar_read);
+
     circa_patch_function(patch, "Module.block", Module__block);
     circa_patch_function(patch, "Module._get", Module__get);
 
@@ -1458,6 +1492,8 @@ void misc_builtins_setup_functions(NativePatch* patch)
     circa_patch_function(patch, "String.to_lower", String__to_lower);
     circa_patch_function(patch, "String.to_number", String__to_number);
     circa_patch_function(patch, "String.to_int", String__to_int);
+    circa_patch_function(patch, "String.to_symbol", String__to_symbol);
+    circa_patch_function(patch, "Symbol.id", Symbol__id);
     circa_patch_function(patch, "make_module", make_module);
     circa_patch_function(patch, "noise", noise);
     circa_patch_function(patch, "not_equals", not_equals);
@@ -27,6 +27,20 @@ Term* run_name_search(NameSearch* params);
 
 bool exposes_nested_names(Term* term);
 
+static u32 unique_name_hash(Value* name)
+{
+    if (!is_string(name))
+        return 0;
+
+    // FNV-1a
+    u32 hash = 2166136261u;
+    for (const char* c = as_cstring(name); *c != 0; c++) {
+        hash ^= (u8) *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
 bool fits_lookup_type(Term* term, Symbol type)
 {
     switch (type) {
@@ -88,6 +102,10 @@ Term* run_name_search(NameSearch* params)
     if (position > block->length())
         position = block->length();
 
+    // A named term's uniqueName.base is a copy of its name, so the hash can be used to
+    // skip most terms without a string comparison.
+    u32 nameHash = unique_name_hash(&params->name);
+
     // Look for an exact match.
     for (int i = position - 1; i >= 0; i--) {
 
@@ -97,7 +115,8 @@ Term* run_name_search(NameSearch* params)
         if (term == NULL)
             continue;
 
-        if (equals(&term->nameValue, &params->name)
+        if (term->uniqueName.baseHash == nameHash
+                && equals(&term->nameValue, &params->name)
                 && fits_lookup_type(term, params->lookupType)
                 && (params->ordinal == -1 || term->uniqueOrdinal == params->ordinal))
             return term;
@@ -502,6 +521,9 @@ void update_unique_name(Term* term)
 
     if (term->owningBlock == NULL) {
         copy(&term->nameValue, &name.name);
+        copy(&term->nameValue, &name.base);
+        name.nameHash = unique_name_hash(&name.name);
+        name.baseHash = name.nameHash;
         return;
     }
 
@@ -518,9 +540,14 @@ void update_unique_name(Term* term)
 
     copy(&name.base, &name.name);
     name.ordinal = 0;
+    name.baseHash = unique_name_hash(&name.base);
+    name.nameHash = name.baseHash;
 
     // Look for a name collision. We might need to keep looping, if our generated name
     // collides with an existing name.
+    //
+    // This runs for every named term that the parser creates, so the hashes are checked
+    // before doing any string comparisons.
 
     Block* block = term->owningBlock;
 
@@ -534,15 +561,17 @@ void update_unique_name(Term* term)
 
             // If another term shares the same base, then make sure our ordinal is
             // higher. This turns some O(n) cases into O(1)
-            if (string_equals(&other->uniqueName.base, &name.base)
-                    && (other->uniqueName.ordinal >= name.ordinal)) {
+            if (other->uniqueName.baseHash == name.baseHash
+                    && (other->uniqueName.ordinal >= name.ordinal)
+                    && string_equals(&other->uniqueName.base, &name.base)) {
                 name.ordinal = other->uniqueName.ordinal + 1;
                 updatedName = true;
 
             // If this name is already used, then just try the next ordinal. This
             // case results in more blind searching, but it's necessary to handle
             // the situation where a generated name is already taken.
-            } else if (string_equals(&other->uniqueName.name, &name.name)) {
+            } else if (other->uniqueName.nameHash == name.nameHash
+                    && string_equals(&other->uniqueName.name, &name.name)) {
                 name.ordinal++;
                 updatedName = true;
             }
@@ -553,6 +582,7 @@ void update_unique_name(Term* term)
                 copy(&name.base, &name.name);
                 string_append(&name.name, "_");
                 string_append(&name.name, ordinalBuf);
+                name.nameHash = unique_name_hash(&name.name);
                 break;
             }
         }
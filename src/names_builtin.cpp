@@ -33,6 +33,7 @@ const char* builtin_symbol_to_string(int name)
     case s_failure: return "failure";
     case s_file: return "file";
     case s_filename: return "filename";
+    case s_filter: return "filter";
     case s_format: return "format";
     case s_frames: return "frames";
     case s_has_state: return "has_state";
@@ -53,6 +54,7 @@ const char* builtin_symbol_to_string(int name)
     case s_local_state_key: return "local_state_key";
     case s_loop: return "loop";
     case s_maddr: return "maddr";
+    case s_map: return "map";
     case s_major_block: return "major_block";
     case s_maybe: return "maybe";
     case s_memoize: return "memoize";
@@ -71,6 +73,7 @@ const char* builtin_symbol_to_string(int name)
     case s_outgoing: return "outgoing";
     case s_pc: return "pc";
     case s_produceOutput: return "produceOutput";
+    case s_reduce: return "reduce";
     case s_repeat: return "repeat";
     case s_return: return "return";
     case s_slot: return "slot";
@@ -361,6 +364,8 @@ const char* builtin_symbol_to_string(int name)
     case stat_FindModule: return "stat_FindModule";
     case stat_Bytecode_WriteTerm: return "stat_Bytecode_WriteTerm";
     case stat_Bytecode_CreateEntry: return "stat_Bytecode_CreateEntry";
+    case stat_Bytecode_SpecializeBlock: return "stat_Bytecode_SpecializeBlock";
+    case stat_Bytecode_InlineCall: return "stat_Bytecode_InlineCall";
     case stat_LoadFrameState: return "stat_LoadFrameState";
     case stat_StoreFrameState: return "stat_StoreFrameState";
     case stat_AppendMove: return "stat_AppendMove";
@@ -368,6 +373,7 @@ const char* builtin_symbol_to_string(int name)
     case stat_GetIndexMove: return "stat_GetIndexMove";
     case stat_Interpreter_Step: return "stat_Interpreter_Step";
     case stat_Interpreter_DynamicMethod_CacheHit: return "stat_Interpreter_DynamicMethod_CacheHit";
+    case stat_Interpreter_DynamicMethod_CacheMiss: return "stat_Interpreter_DynamicMethod_CacheMiss";
     case stat_Interpreter_DynamicMethod_SlowLookup: return "stat_Interpreter_DynamicMethod_SlowLookup";
     case stat_Interpreter_DynamicMethod_SlowLookup_Module: return "stat_Interpreter_DynamicMethod_SlowLookup_Module";
     case stat_Interpreter_DynamicMethod_SlowLookup_Hashtable: return "stat_Interpreter_DynamicMethod_SlowLookup_Hashtable";
@@ -377,6 +383,7 @@ const char* builtin_symbol_to_string(int name)
     case stat_Interpreter_CopyStackValue: return "stat_Interpreter_CopyStackValue";
     case stat_Interpreter_MoveStackValue: return "stat_Interpreter_MoveStackValue";
     case stat_Interpreter_CopyConst: return "stat_Interpreter_CopyConst";
+    case stat_Interpreter_DeoptimizeBlock: return "stat_Interpreter_DeoptimizeBlock";
     case stat_FindEnvValue: return "stat_FindEnvValue";
     case stat_Make: return "stat_Make";
     case stat_Copy: return "stat_Copy";
@@ -390,11 +397,16 @@ const char* builtin_symbol_to_string(int name)
     case stat_ListDuplicate: return "stat_ListDuplicate";
     case stat_ListDuplicate_100Count: return "stat_ListDuplicate_100Count";
     case stat_ListDuplicate_ElementCopy: return "stat_ListDuplicate_ElementCopy";
+    case stat_ListDuplicate_Trie: return "stat_ListDuplicate_Trie";
+    case stat_ListTrieNodeCopy: return "stat_ListTrieNodeCopy";
     case stat_ListCast_Touch: return "stat_ListCast_Touch";
     case stat_ListCast_CastElement: return "stat_ListCast_CastElement";
     case stat_HashtableDuplicate: return "stat_HashtableDuplicate";
     case stat_HashtableDuplicate_Copy: return "stat_HashtableDuplicate_Copy";
+    case stat_HashtableDuplicate_Hamt: return "stat_HashtableDuplicate_Hamt";
+    case stat_HashtableHamtNodeCopy: return "stat_HashtableHamtNodeCopy";
     case stat_StringCreate: return "stat_StringCreate";
+    case stat_StringCreateSmall: return "stat_StringCreateSmall";
     case stat_StringDuplicate: return "stat_StringDuplicate";
     case stat_StringResizeInPlace: return "stat_StringResizeInPlace";
     case stat_StringResizeCreate: return "stat_StringResizeCreate";
@@ -1901,6 +1913,10 @@ int builtin_symbol_from_string(const char* str)
             return s_file;
     default: return -1;
     }
+    case 't':
+        if (strcmp(str + 4, "er") == 0)
+            return s_filter;
+        break;
     default: return -1;
     }
     default: return -1;
@@ -2087,6 +2103,8 @@ int builtin_symbol_from_string(const char* str)
         if (strcmp(str + 3, "or_block") == 0)
             return s_major_block;
         break;
+    case 'p':
+            return s_map;
     case 'y':
         if (strcmp(str + 3, "be") == 0)
             return s_maybe;
@@ -2223,6 +2241,10 @@ int builtin_symbol_from_string(const char* str)
     switch (str[1]) {
     case 'e':
     switch (str[2]) {
+    case 'd':
+        if (strcmp(str + 3, "uce") == 0)
+            return s_reduce;
+        break;
     case 'p':
         if (strcmp(str + 3, "eat") == 0)
             return s_repeat;
@@ -2299,6 +2321,14 @@ int builtin_symbol_from_string(const char* str)
         if (strcmp(str + 15, "reateEntry") == 0)
             return stat_Bytecode_CreateEntry;
         break;
+    case 'I':
+        if (strcmp(str + 15, "nlineCall") == 0)
+            return stat_Bytecode_InlineCall;
+        break;
+    case 'S':
+        if (strcmp(str + 15, "pecializeBlock") == 0)
+            return stat_Bytecode_SpecializeBlock;
+        break;
     case 'W':
         if (strcmp(str + 15, "riteTerm") == 0)
             return stat_Bytecode_WriteTerm;
@@ -2474,9 +2504,17 @@ int builtin_symbol_from_string(const char* str)
     case 'e':
     switch (str[23]) {
     case '_':
-        if (strcmp(str + 24, "Copy") == 0)
+    switch (str[24]) {
+    case 'C':
+        if (strcmp(str + 25, "opy") == 0)
             return stat_HashtableDuplicate_Copy;
         break;
+    case 'H':
+        if (strcmp(str + 25, "amt") == 0)
+            return stat_HashtableDuplicate_Hamt;
+        break;
+    default: return -1;
+    }
     case 0:
             return stat_HashtableDuplicate;
     default: return -1;
@@ -2497,6 +2535,10 @@ int builtin_symbol_from_string(const char* str)
     }
     default: return -1;
     }
+    case 'H':
+        if (strcmp(str + 15, "amtNodeCopy") == 0)
+            return stat_HashtableHamtNodeCopy;
+        break;
     default: return -1;
     }
     default: return -1;
@@ -2569,6 +2611,10 @@ int builtin_symbol_from_string(const char* str)
     }
     case 'D':
     switch (str[18]) {
+    case 'e':
+        if (strcmp(str + 19, "optimizeBlock") == 0)
+            return stat_Interpreter_DeoptimizeBlock;
+        break;
     case 'y':
     switch (str[19]) {
     case 'n':
@@ -2600,9 +2646,33 @@ int builtin_symbol_from_string(const char* str)
     case '_':
     switch (str[31]) {
     case 'C':
-        if (strcmp(str + 32, "acheHit") == 0)
+    switch (str[32]) {
+    case 'a':
+    switch (str[33]) {
+    case 'c':
+    switch (str[34]) {
+    case 'h':
+    switch (str[35]) {
+    case 'e':
+    switch (str[36]) {
+    case 'H':
+        if (strcmp(str + 37, "it") == 0)
             return stat_Interpreter_DynamicMethod_CacheHit;
         break;
+    case 'M':
+        if (strcmp(str + 37, "iss") == 0)
+            return stat_Interpreter_DynamicMethod_CacheMiss;
+        break;
+    default: return -1;
+    }
+    default: return -1;
+    }
+    default: return -1;
+    }
+    default: return -1;
+    }
+    default: return -1;
+    }
     case 'M':
         if (strcmp(str + 32, "oduleLookup") == 0)
             return stat_Interpreter_DynamicMethod_ModuleLookup;
@@ -2785,6 +2855,10 @@ int builtin_symbol_from_string(const char* str)
         if (strcmp(str + 20, "lementCopy") == 0)
             return stat_ListDuplicate_ElementCopy;
         break;
+    case 'T':
+        if (strcmp(str + 20, "rie") == 0)
+            return stat_ListDuplicate_Trie;
+        break;
     default: return -1;
     }
     case 0:
@@ -2811,6 +2885,10 @@ int builtin_symbol_from_string(const char* str)
         if (strcmp(str + 10, "oftCopy") == 0)
             return stat_ListSoftCopy;
         break;
+    case 'T':
+        if (strcmp(str + 10, "rieNodeCopy") == 0)
+            return stat_ListTrieNodeCopy;
+        break;
     case 's':
     switch (str[10]) {
     case 'C':
@@ -3006,9 +3084,35 @@ int builtin_symbol_from_string(const char* str)
     case 'g':
     switch (str[11]) {
     case 'C':
-        if (strcmp(str + 12, "reate") == 0)
-            return stat_StringCreate;
+    switch (str[12]) {
+    case 'r':
+    switch (str[13]) {
+    case 'e':
+    switch (str[14]) {
+    case 'a':
+    switch (str[15]) {
+    case 't':
+    switch (str[16]) {
+    case 'e':
+    switch (str[17]) {
+    case 'S':
+        if (strcmp(str + 18, "mall") == 0)
+            return stat_StringCreateSmall;
         break;
+    case 0:
+            return stat_StringCreate;
+    default: return -1;
+    }
+    default: return -1;
+    }
+    default: return -1;
+    }
+    default: return -1;
+    }
+    default: return -1;
+    }
+    default: return -1;
+    }
     case 'D':
         if (strcmp(str + 12, "uplicate") == 0)
             return stat_StringDuplicate;
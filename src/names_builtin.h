@@ -26,383 +26,395 @@ const int s_expr = 16;
 const int s_failure = 17;
 const int s_file = 18;
 const int s_filename = 19;
-const int s_format = 20;
-const int s_frames = 21;
-const int s_has_state = 22;
-const int s_hidden = 23;
-const int s_ident = 24;
-const int s_incoming = 25;
-const int s_index = 26;
-const int s_inputs = 27;
-const int s_invalid = 28;
-const int s_iterator = 29;
-const int s_iterator_value = 30;
-const int s_items = 31;
-const int s_key = 32;
-const int s_last = 33;
-const int s_list = 34;
-const int s_liveness_list = 35;
-const int s_local_state = 36;
-const int s_local_state_key = 37;
-const int s_loop = 38;
-const int s_maddr = 39;
-const int s_major_block = 40;
-const int s_maybe = 41;
-const int s_memoize = 42;
-const int s_message = 43;
-const int s_method_name = 44;
-const int s_methodCache = 45;
-const int s_multiple = 46;
-const int s_next = 47;
-const int s_next_case = 48;
-const int s_no = 49;
-const int s_normal = 50;
-const int s_none = 51;
-const int s_newline = 52;
-const int s_out = 53;
-const int s_outputSlot = 54;
-const int s_outgoing = 55;
-const int s_pc = 56;
-const int s_produceOutput = 57;
-const int s_repeat = 58;
-const int s_return = 59;
-const int s_slot = 60;
-const int s_slots = 61;
-const int s_slotCount = 62;
-const int s_state = 63;
-const int s_statement = 64;
-const int s_step = 65;
-const int s_switch = 66;
-const int s_success = 67;
-const int s_type = 68;
-const int s_term = 69;
-const int s_top = 70;
-const int s_unknown = 71;
-const int s_yes = 72;
-const int s_EvaluationEmpty = 73;
-const int s_HasEffects = 74;
-const int s_HasControlFlow = 75;
-const int s_HasDynamicDispatch = 76;
-const int s_DirtyStateType = 77;
-const int s_Builtins = 78;
-const int s_ModuleName = 79;
-const int s_StaticErrors = 80;
-const int s_IsModule = 81;
-const int s_AccumulatingOutput = 82;
-const int s_Constructor = 83;
-const int s_Error = 84;
-const int s_ExplicitState = 85;
-const int s_ExplicitType = 86;
-const int s_Field = 87;
-const int s_FieldAccessor = 88;
-const int s_Final = 89;
-const int s_HiddenInput = 90;
-const int s_Implicit = 91;
-const int s_IgnoreError = 92;
-const int s_LocalStateResult = 93;
-const int s_Meta = 94;
-const int s_Message = 95;
-const int s_MethodName = 96;
-const int s_ModifyList = 97;
-const int s_Mutability = 98;
-const int s_Optional = 99;
-const int s_OriginalText = 100;
-const int s_OverloadedFunc = 101;
-const int s_Ref = 102;
-const int s_Rebind = 103;
-const int s_Setter = 104;
-const int s_Output = 105;
-const int s_PreferSpecialize = 106;
-const int s_Error_UnknownType = 107;
-const int s_Syntax_AnonFunction = 108;
-const int s_Syntax_BlockStyle = 109;
-const int s_Syntax_Brackets = 110;
-const int s_Syntax_ColorFormat = 111;
-const int s_Syntax_DeclarationStyle = 112;
-const int s_Syntax_ExplicitType = 113;
-const int s_Syntax_FunctionName = 114;
-const int s_Syntax_IdentifierRebind = 115;
-const int s_Syntax_ImplicitName = 116;
-const int s_Syntax_Import = 117;
-const int s_Syntax_InputFormat = 118;
-const int s_Syntax_IntegerFormat = 119;
-const int s_Syntax_LineEnding = 120;
-const int s_Syntax_LiteralList = 121;
-const int s_Syntax_MethodDecl = 122;
-const int s_Syntax_Multiline = 123;
-const int s_Syntax_NameBinding = 124;
-const int s_Syntax_NoBrackets = 125;
-const int s_Syntax_NoParens = 126;
-const int s_Syntax_Operator = 127;
-const int s_Syntax_OriginalFormat = 128;
-const int s_Syntax_Parens = 129;
-const int s_Syntax_PreWs = 130;
-const int s_Syntax_PreDotWs = 131;
-const int s_Syntax_PreOperatorWs = 132;
-const int s_Syntax_PreEndWs = 133;
-const int s_Syntax_PreEqualsSpace = 134;
-const int s_Syntax_PreLBracketWs = 135;
-const int s_Syntax_PreRBracketWs = 136;
-const int s_Syntax_PostEqualsSpace = 137;
-const int s_Syntax_PostFunctionWs = 138;
-const int s_Syntax_PostKeywordWs = 139;
-const int s_Syntax_PostLBracketWs = 140;
-const int s_Syntax_PostHeadingWs = 141;
-const int s_Syntax_PostNameWs = 142;
-const int s_Syntax_PostWs = 143;
-const int s_Syntax_PostOperatorWs = 144;
-const int s_Syntax_Properties = 145;
-const int s_Syntax_QuoteType = 146;
-const int s_Syntax_RebindSymbol = 147;
-const int s_Syntax_RebindOperator = 148;
-const int s_Syntax_RebindingInfix = 149;
-const int s_Syntax_ReturnStatement = 150;
-const int s_Syntax_Require = 151;
-const int s_Syntax_RequireLocal = 152;
-const int s_Syntax_StateKeyword = 153;
-const int s_Syntax_TypeMagicSymbol = 154;
-const int s_Syntax_WhitespaceBeforeEnd = 155;
-const int s_Syntax_WhitespacePreColon = 156;
-const int s_Syntax_WhitespacePostColon = 157;
-const int s_Wildcard = 158;
-const int s_RecursiveWildcard = 159;
-const int s_Function = 160;
-const int s_TypeRelease = 161;
-const int s_FileNotFound = 162;
-const int s_NotEnoughInputs = 163;
-const int s_TooManyInputs = 164;
-const int s_ExtraOutputNotFound = 165;
-const int s_Default = 166;
-const int s_ByDemand = 167;
-const int s_Unevaluated = 168;
-const int s_InProgress = 169;
-const int s_Lazy = 170;
-const int s_Consumed = 171;
-const int s_Uncaptured = 172;
-const int s_Return = 173;
-const int s_Continue = 174;
-const int s_Break = 175;
-const int s_Discard = 176;
-const int s_Control = 177;
-const int s_ExitLevelFunction = 178;
-const int s_ExitLevelLoop = 179;
-const int s_HighestExitLevel = 180;
-const int s_ExtraReturn = 181;
-const int s_Name = 182;
-const int s_Primary = 183;
-const int s_Anonymous = 184;
-const int s_Entropy = 185;
-const int s_OnDemand = 186;
-const int s_dev_compile = 187;
-const int s_hacks = 188;
-const int s_no_effect = 189;
-const int s_no_save_state = 190;
-const int s_effect = 191;
-const int s_set_value = 192;
-const int s_watch = 193;
-const int s_Copy = 194;
-const int s_Move = 195;
-const int s_Unobservable = 196;
-const int s_TermCounter = 197;
-const int s_Watch = 198;
-const int s_StackReady = 199;
-const int s_StackRunning = 200;
-const int s_StackFinished = 201;
-const int s_InfixOperator = 202;
-const int s_FunctionName = 203;
-const int s_TypeName = 204;
-const int s_TermName = 205;
-const int s_Keyword = 206;
-const int s_Whitespace = 207;
-const int s_UnknownIdentifier = 208;
-const int s_LookupAny = 209;
-const int s_LookupType = 210;
-const int s_LookupFunction = 211;
-const int s_Untyped = 212;
-const int s_UniformListType = 213;
-const int s_AnonStructType = 214;
-const int s_StructType = 215;
-const int s_NativePatch = 216;
-const int s_RecompileModule = 217;
-const int s_Filesystem = 218;
-const int s_Tarball = 219;
-const int s_Bootstrapping = 220;
-const int s_Done = 221;
-const int s_StorageTypeNull = 222;
-const int s_StorageTypeInt = 223;
-const int s_StorageTypeFloat = 224;
-const int s_StorageTypeBlob = 225;
-const int s_StorageTypeBool = 226;
-const int s_StorageTypeStack = 227;
-const int s_StorageTypeString = 228;
-const int s_StorageTypeList = 229;
-const int s_StorageTypeOpaquePointer = 230;
-const int s_StorageTypeTerm = 231;
-const int s_StorageTypeType = 232;
-const int s_StorageTypeHandle = 233;
-const int s_StorageTypeHashtable = 234;
-const int s_StorageTypeObject = 235;
-const int s_InterfaceType = 236;
-const int s_Delete = 237;
-const int s_Insert = 238;
-const int s_Element = 239;
-const int s_Key = 240;
-const int s_Replace = 241;
-const int s_Append = 242;
-const int s_Truncate = 243;
-const int s_ChangeAppend = 244;
-const int s_ChangeRename = 245;
-const int tok_Identifier = 246;
-const int tok_ColonString = 247;
-const int tok_Integer = 248;
-const int tok_HexInteger = 249;
-const int tok_Float = 250;
-const int tok_String = 251;
-const int tok_Color = 252;
-const int tok_Bool = 253;
-const int tok_LParen = 254;
-const int tok_RParen = 255;
-const int tok_LBrace = 256;
-const int tok_RBrace = 257;
-const int tok_LSquare = 258;
-const int tok_RSquare = 259;
-const int tok_Comma = 260;
-const int tok_At = 261;
-const int tok_Dot = 262;
-const int tok_DotAt = 263;
-const int tok_Star = 264;
-const int tok_DoubleStar = 265;
-const int tok_Question = 266;
-const int tok_Slash = 267;
-const int tok_DoubleSlash = 268;
-const int tok_Plus = 269;
-const int tok_Minus = 270;
-const int tok_LThan = 271;
-const int tok_LThanEq = 272;
-const int tok_GThan = 273;
-const int tok_GThanEq = 274;
-const int tok_Percent = 275;
-const int tok_Colon = 276;
-const int tok_DoubleColon = 277;
-const int tok_DoubleEquals = 278;
-const int tok_NotEquals = 279;
-const int tok_Equals = 280;
-const int tok_PlusEquals = 281;
-const int tok_MinusEquals = 282;
-const int tok_StarEquals = 283;
-const int tok_SlashEquals = 284;
-const int tok_ColonEquals = 285;
-const int tok_RightArrow = 286;
-const int tok_FatArrow = 287;
-const int tok_LeftArrow = 288;
-const int tok_Ampersand = 289;
-const int tok_DoubleAmpersand = 290;
-const int tok_VerticalBar = 291;
-const int tok_DoubleVerticalBar = 292;
-const int tok_Semicolon = 293;
-const int tok_TwoDots = 294;
-const int tok_Ellipsis = 295;
-const int tok_TripleLThan = 296;
-const int tok_TripleGThan = 297;
-const int tok_Pound = 298;
-const int tok_Def = 299;
-const int tok_Struct = 300;
-const int tok_UnusedName1 = 301;
-const int tok_UnusedName2 = 302;
-const int tok_UnusedName3 = 303;
-const int tok_If = 304;
-const int tok_Else = 305;
-const int tok_Elif = 306;
-const int tok_For = 307;
-const int tok_While = 308;
-const int tok_State = 309;
-const int tok_Return = 310;
-const int tok_In = 311;
-const int tok_Let = 312;
-const int tok_True = 313;
-const int tok_False = 314;
-const int tok_Namespace = 315;
-const int tok_Include = 316;
-const int tok_And = 317;
-const int tok_Or = 318;
-const int tok_Not = 319;
-const int tok_Discard = 320;
-const int tok_Nil = 321;
-const int tok_Break = 322;
-const int tok_Continue = 323;
-const int tok_Switch = 324;
-const int tok_Case = 325;
-const int tok_Require = 326;
-const int tok_RequireLocal = 327;
-const int tok_Import = 328;
-const int tok_Package = 329;
-const int tok_Section = 330;
-const int tok_Whitespace = 331;
-const int tok_Newline = 332;
-const int tok_Comment = 333;
-const int tok_Eof = 334;
-const int tok_Unrecognized = 335;
-const int s_NormalCall = 336;
-const int s_FuncApply = 337;
-const int s_FuncCall = 338;
-const int s_FirstStatIndex = 339;
-const int stat_TermCreated = 340;
-const int stat_TermPropAdded = 341;
-const int stat_TermPropAccess = 342;
-const int stat_NameSearch = 343;
-const int stat_NameSearchStep = 344;
-const int stat_FindModule = 345;
-const int stat_Bytecode_WriteTerm = 346;
-const int stat_Bytecode_CreateEntry = 347;
-const int stat_LoadFrameState = 348;
-const int stat_StoreFrameState = 349;
-const int stat_AppendMove = 350;
-const int stat_GetIndexCopy = 351;
-const int stat_GetIndexMove = 352;
-const int stat_Interpreter_Step = 353;
-const int stat_Interpreter_DynamicMethod_CacheHit = 354;
-const int stat_Interpreter_DynamicMethod_SlowLookup = 355;
-const int stat_Interpreter_DynamicMethod_SlowLookup_Module = 356;
-const int stat_Interpreter_DynamicMethod_SlowLookup_Hashtable = 357;
-const int stat_Interpreter_DynamicMethod_ModuleLookup = 358;
-const int stat_Interpreter_DynamicFuncToClosureCall = 359;
-const int stat_Interpreter_CopyTermValue = 360;
-const int stat_Interpreter_CopyStackValue = 361;
-const int stat_Interpreter_MoveStackValue = 362;
-const int stat_Interpreter_CopyConst = 363;
-const int stat_FindEnvValue = 364;
-const int stat_Make = 365;
-const int stat_Copy = 366;
-const int stat_Cast = 367;
-const int stat_ValueCastDispatched = 368;
-const int stat_Touch = 369;
-const int stat_BlobDuplicate = 370;
-const int stat_ListsCreated = 371;
-const int stat_ListsGrown = 372;
-const int stat_ListSoftCopy = 373;
-const int stat_ListDuplicate = 374;
-const int stat_ListDuplicate_100Count = 375;
-const int stat_ListDuplicate_ElementCopy = 376;
-const int stat_ListCast_Touch = 377;
-const int stat_ListCast_CastElement = 378;
-const int stat_HashtableDuplicate = 379;
-const int stat_HashtableDuplicate_Copy = 380;
-const int stat_StringCreate = 381;
-const int stat_StringDuplicate = 382;
-const int stat_StringResizeInPlace = 383;
-const int stat_StringResizeCreate = 384;
-const int stat_StringSoftCopy = 385;
-const int stat_StringToStd = 386;
-const int stat_DynamicCall = 387;
-const int stat_FinishDynamicCall = 388;
-const int stat_DynamicMethodCall = 389;
-const int stat_SetIndex = 390;
-const int stat_SetField = 391;
-const int stat_SetWithSelector_Touch_List = 392;
-const int stat_SetWithSelector_Touch_Hashtable = 393;
-const int stat_StackPushFrame = 394;
-const int s_LastStatIndex = 395;
-const int s_LastBuiltinName = 396;
+const int s_filter = 20;
+const int s_format = 21;
+const int s_frames = 22;
+const int s_has_state = 23;
+const int s_hidden = 24;
+const int s_ident = 25;
+const int s_incoming = 26;
+const int s_index = 27;
+const int s_inputs = 28;
+const int s_invalid = 29;
+const int s_iterator = 30;
+const int s_iterator_value = 31;
+const int s_items = 32;
+const int s_key = 33;
+const int s_last = 34;
+const int s_list = 35;
+const int s_liveness_list = 36;
+const int s_local_state = 37;
+const int s_local_state_key = 38;
+const int s_loop = 39;
+const int s_maddr = 40;
+const int s_map = 41;
+const int s_major_block = 42;
+const int s_maybe = 43;
+const int s_memoize = 44;
+const int s_message = 45;
+const int s_method_name = 46;
+const int s_methodCache = 47;
+const int s_multiple = 48;
+const int s_next = 49;
+const int s_next_case = 50;
+const int s_no = 51;
+const int s_normal = 52;
+const int s_none = 53;
+const int s_newline = 54;
+const int s_out = 55;
+const int s_outputSlot = 56;
+const int s_outgoing = 57;
+const int s_pc = 58;
+const int s_produceOutput = 59;
+const int s_reduce = 60;
+const int s_repeat = 61;
+const int s_return = 62;
+const int s_slot = 63;
+const int s_slots = 64;
+const int s_slotCount = 65;
+const int s_state = 66;
+const int s_statement = 67;
+const int s_step = 68;
+const int s_switch = 69;
+const int s_success = 70;
+const int s_type = 71;
+const int s_term = 72;
+const int s_top = 73;
+const int s_unknown = 74;
+const int s_yes = 75;
+const int s_EvaluationEmpty = 76;
+const int s_HasEffects = 77;
+const int s_HasControlFlow = 78;
+const int s_HasDynamicDispatch = 79;
+const int s_DirtyStateType = 80;
+const int s_Builtins = 81;
+const int s_ModuleName = 82;
+const int s_StaticErrors = 83;
+const int s_IsModule = 84;
+const int s_AccumulatingOutput = 85;
+const int s_Constructor = 86;
+const int s_Error = 87;
+const int s_ExplicitState = 88;
+const int s_ExplicitType = 89;
+const int s_Field = 90;
+const int s_FieldAccessor = 91;
+const int s_Final = 92;
+const int s_HiddenInput = 93;
+const int s_Implicit = 94;
+const int s_IgnoreError = 95;
+const int s_LocalStateResult = 96;
+const int s_Meta = 97;
+const int s_Message = 98;
+const int s_MethodName = 99;
+const int s_ModifyList = 100;
+const int s_Mutability = 101;
+const int s_Optional = 102;
+const int s_OriginalText = 103;
+const int s_OverloadedFunc = 104;
+const int s_Ref = 105;
+const int s_Rebind = 106;
+const int s_Setter = 107;
+const int s_Output = 108;
+const int s_PreferSpecialize = 109;
+const int s_Error_UnknownType = 110;
+const int s_Syntax_AnonFunction = 111;
+const int s_Syntax_BlockStyle = 112;
+const int s_Syntax_Brackets = 113;
+const int s_Syntax_ColorFormat = 114;
+const int s_Syntax_DeclarationStyle = 115;
+const int s_Syntax_ExplicitType = 116;
+const int s_Syntax_FunctionName = 117;
+const int s_Syntax_IdentifierRebind = 118;
+const int s_Syntax_ImplicitName = 119;
+const int s_Syntax_Import = 120;
+const int s_Syntax_InputFormat = 121;
+const int s_Syntax_IntegerFormat = 122;
+const int s_Syntax_LineEnding = 123;
+const int s_Syntax_LiteralList = 124;
+const int s_Syntax_MethodDecl = 125;
+const int s_Syntax_Multiline = 126;
+const int s_Syntax_NameBinding = 127;
+const int s_Syntax_NoBrackets = 128;
+const int s_Syntax_NoParens = 129;
+const int s_Syntax_Operator = 130;
+const int s_Syntax_OriginalFormat = 131;
+const int s_Syntax_Parens = 132;
+const int s_Syntax_PreWs = 133;
+const int s_Syntax_PreDotWs = 134;
+const int s_Syntax_PreOperatorWs = 135;
+const int s_Syntax_PreEndWs = 136;
+const int s_Syntax_PreEqualsSpace = 137;
+const int s_Syntax_PreLBracketWs = 138;
+const int s_Syntax_PreRBracketWs = 139;
+const int s_Syntax_PostEqualsSpace = 140;
+const int s_Syntax_PostFunctionWs = 141;
+const int s_Syntax_PostKeywordWs = 142;
+const int s_Syntax_PostLBracketWs = 143;
+const int s_Syntax_PostHeadingWs = 144;
+const int s_Syntax_PostNameWs = 145;
+const int s_Syntax_PostWs = 146;
+const int s_Syntax_PostOperatorWs = 147;
+const int s_Syntax_Properties = 148;
+const int s_Syntax_QuoteType = 149;
+const int s_Syntax_RebindSymbol = 150;
+const int s_Syntax_RebindOperator = 151;
+const int s_Syntax_RebindingInfix = 152;
+const int s_Syntax_ReturnStatement = 153;
+const int s_Syntax_Require = 154;
+const int s_Syntax_RequireLocal = 155;
+const int s_Syntax_StateKeyword = 156;
+const int s_Syntax_TypeMagicSymbol = 157;
+const int s_Syntax_WhitespaceBeforeEnd = 158;
+const int s_Syntax_WhitespacePreColon = 159;
+const int s_Syntax_WhitespacePostColon = 160;
+const int s_Wildcard = 161;
+const int s_RecursiveWildcard = 162;
+const int s_Function = 163;
+const int s_TypeRelease = 164;
+const int s_FileNotFound = 165;
+const int s_NotEnoughInputs = 166;
+const int s_TooManyInputs = 167;
+const int s_ExtraOutputNotFound = 168;
+const int s_Default = 169;
+const int s_ByDemand = 170;
+const int s_Unevaluated = 171;
+const int s_InProgress = 172;
+const int s_Lazy = 173;
+const int s_Consumed = 174;
+const int s_Uncaptured = 175;
+const int s_Return = 176;
+const int s_Continue = 177;
+const int s_Break = 178;
+const int s_Discard = 179;
+const int s_Control = 180;
+const int s_ExitLevelFunction = 181;
+const int s_ExitLevelLoop = 182;
+const int s_HighestExitLevel = 183;
+const int s_ExtraReturn = 184;
+const int s_Name = 185;
+const int s_Primary = 186;
+const int s_Anonymous = 187;
+const int s_Entropy = 188;
+const int s_OnDemand = 189;
+const int s_dev_compile = 190;
+const int s_hacks = 191;
+const int s_no_effect = 192;
+const int s_no_save_state = 193;
+const int s_effect = 194;
+const int s_set_value = 195;
+const int s_watch = 196;
+const int s_Copy = 197;
+const int s_Move = 198;
+const int s_Unobservable = 199;
+const int s_TermCounter = 200;
+const int s_Watch = 201;
+const int s_StackReady = 202;
+const int s_StackRunning = 203;
+const int s_StackFinished = 204;
+const int s_InfixOperator = 205;
+const int s_FunctionName = 206;
+const int s_TypeName = 207;
+const int s_TermName = 208;
+const int s_Keyword = 209;
+const int s_Whitespace = 210;
+const int s_UnknownIdentifier = 211;
+const int s_LookupAny = 212;
+const int s_LookupType = 213;
+const int s_LookupFunction = 214;
+const int s_Untyped = 215;
+const int s_UniformListType = 216;
+const int s_AnonStructType = 217;
+const int s_StructType = 218;
+const int s_NativePatch = 219;
+const int s_RecompileModule = 220;
+const int s_Filesystem = 221;
+const int s_Tarball = 222;
+const int s_Bootstrapping = 223;
+const int s_Done = 224;
+const int s_StorageTypeNull = 225;
+const int s_StorageTypeInt = 226;
+const int s_StorageTypeFloat = 227;
+const int s_StorageTypeBlob = 228;
+const int s_StorageTypeBool = 229;
+const int s_StorageTypeStack = 230;
+const int s_StorageTypeString = 231;
+const int s_StorageTypeList = 232;
+const int s_StorageTypeOpaquePointer = 233;
+const int s_StorageTypeTerm = 234;
+const int s_StorageTypeType = 235;
+const int s_StorageTypeHandle = 236;
+const int s_StorageTypeHashtable = 237;
+const int s_StorageTypeObject = 238;
+const int s_InterfaceType = 239;
+const int s_Delete = 240;
+const int s_Insert = 241;
+const int s_Element = 242;
+const int s_Key = 243;
+const int s_Replace = 244;
+const int s_Append = 245;
+const int s_Truncate = 246;
+const int s_ChangeAppend = 247;
+const int s_ChangeRename = 248;
+const int tok_Identifier = 249;
+const int tok_ColonString = 250;
+const int tok_Integer = 251;
+const int tok_HexInteger = 252;
+const int tok_Float = 253;
+const int tok_String = 254;
+const int tok_Color = 255;
+const int tok_Bool = 256;
+const int tok_LParen = 257;
+const int tok_RParen = 258;
+const int tok_LBrace = 259;
+const int tok_RBrace = 260;
+const int tok_LSquare = 261;
+const int tok_RSquare = 262;
+const int tok_Comma = 263;
+const int tok_At = 264;
+const int tok_Dot = 265;
+const int tok_DotAt = 266;
+const int tok_Star = 267;
+const int tok_DoubleStar = 268;
+const int tok_Question = 269;
+const int tok_Slash = 270;
+const int tok_DoubleSlash = 271;
+const int tok_Plus = 272;
+const int tok_Minus = 273;
+const int tok_LThan = 274;
+const int tok_LThanEq = 275;
+const int tok_GThan = 276;
+const int tok_GThanEq = 277;
+const int tok_Percent = 278;
+const int tok_Colon = 279;
+const int tok_DoubleColon = 280;
+const int tok_DoubleEquals = 281;
+const int tok_NotEquals = 282;
+const int tok_Equals = 283;
+const int tok_PlusEquals = 284;
+const int tok_MinusEquals = 285;
+const int tok_StarEquals = 286;
+const int tok_SlashEquals = 287;
+const int tok_ColonEquals = 288;
+const int tok_RightArrow = 289;
+const int tok_FatArrow = 290;
+const int tok_LeftArrow = 291;
+const int tok_Ampersand = 292;
+const int tok_DoubleAmpersand = 293;
+const int tok_VerticalBar = 294;
+const int tok_DoubleVerticalBar = 295;
+const int tok_Semicolon = 296;
+const int tok_TwoDots = 297;
+const int tok_Ellipsis = 298;
+const int tok_TripleLThan = 299;
+const int tok_TripleGThan = 300;
+const int tok_Pound = 301;
+const int tok_Def = 302;
+const int tok_Struct = 303;
+const int tok_UnusedName1 = 304;
+const int tok_UnusedName2 = 305;
+const int tok_UnusedName3 = 306;
+const int tok_If = 307;
+const int tok_Else = 308;
+const int tok_Elif = 309;
+const int tok_For = 310;
+const int tok_While = 311;
+const int tok_State = 312;
+const int tok_Return = 313;
+const int tok_In = 314;
+const int tok_Let = 315;
+const int tok_True = 316;
+const int tok_False = 317;
+const int tok_Namespace = 318;
+const int tok_Include = 319;
+const int tok_And = 320;
+const int tok_Or = 321;
+const int tok_Not = 322;
+const int tok_Discard = 323;
+const int tok_Nil = 324;
+const int tok_Break = 325;
+const int tok_Continue = 326;
+const int tok_Switch = 327;
+const int tok_Case = 328;
+const int tok_Require = 329;
+const int tok_RequireLocal = 330;
+const int tok_Import = 331;
+const int tok_Package = 332;
+const int tok_Section = 333;
+const int tok_Whitespace = 334;
+const int tok_Newline = 335;
+const int tok_Comment = 336;
+const int tok_Eof = 337;
+const int tok_Unrecognized = 338;
+const int s_NormalCall = 339;
+const int s_FuncApply = 340;
+const int s_FuncCall = 341;
+const int s_FirstStatIndex = 342;
+const int stat_TermCreated = 343;
+const int stat_TermPropAdded = 344;
+const int stat_TermPropAccess = 345;
+const int stat_NameSearch = 346;
+const int stat_NameSearchStep = 347;
+const int stat_FindModule = 348;
+const int stat_Bytecode_WriteTerm = 349;
+const int stat_Bytecode_CreateEntry = 350;
+const int stat_Bytecode_SpecializeBlock = 351;
+const int stat_Bytecode_InlineCall = 352;
+const int stat_LoadFrameState = 353;
+const int stat_StoreFrameState = 354;
+const int stat_AppendMove = 355;
+const int stat_GetIndexCopy = 356;
+const int stat_GetIndexMove = 357;
+const int stat_Interpreter_Step = 358;
+const int stat_Interpreter_DynamicMethod_CacheHit = 359;
+const int stat_Interpreter_DynamicMethod_CacheMiss = 360;
+const int stat_Interpreter_DynamicMethod_SlowLookup = 361;
+const int stat_Interpreter_DynamicMethod_SlowLookup_Module = 362;
+const int stat_Interpreter_DynamicMethod_SlowLookup_Hashtable = 363;
+const int stat_Interpreter_DynamicMethod_ModuleLookup = 364;
+const int stat_Interpreter_DynamicFuncToClosureCall = 365;
+const int stat_Interpreter_CopyTermValue = 366;
+const int stat_Interpreter_CopyStackValue = 367;
+const int stat_Interpreter_MoveStackValue = 368;
+const int stat_Interpreter_CopyConst = 369;
+const int stat_Interpreter_DeoptimizeBlock = 370;
+const int stat_FindEnvValue = 371;
+const int stat_Make = 372;
+const int stat_Copy = 373;
+const int stat_Cast = 374;
+const int stat_ValueCastDispatched = 375;
+const int stat_Touch = 376;
+const int stat_BlobDuplicate = 377;
+const int stat_ListsCreated = 378;
+const int stat_ListsGrown = 379;
+const int stat_ListSoftCopy = 380;
+const int stat_ListDuplicate = 381;
+const int stat_ListDuplicate_100Count = 382;
+const int stat_ListDuplicate_ElementCopy = 383;
+const int stat_ListDuplicate_Trie = 384;
+const int stat_ListTrieNodeCopy = 385;
+const int stat_ListCast_Touch = 386;
+const int stat_ListCast_CastElement = 387;
+const int stat_HashtableDuplicate = 388;
+const int stat_HashtableDuplicate_Copy = 389;
+const int stat_HashtableDuplicate_Hamt = 390;
+const int stat_HashtableHamtNodeCopy = 391;
+const int stat_StringCreate = 392;
+const int stat_StringCreateSmall = 393;
+const int stat_StringDuplicate = 394;
+const int stat_StringResizeInPlace = 395;
+const int stat_StringResizeCreate = 396;
+const int stat_StringSoftCopy = 397;
+const int stat_StringToStd = 398;
+const int stat_DynamicCall = 399;
+const int stat_FinishDynamicCall = 400;
+const int stat_DynamicMethodCall = 401;
+const int stat_SetIndex = 402;
+const int stat_SetField = 403;
+const int stat_SetWithSelector_Touch_List = 404;
+const int stat_SetWithSelector_Touch_Hashtable = 405;
+const int stat_StackPushFrame = 406;
+const int s_LastStatIndex = 407;
+const int s_LastBuiltinName = 408;
 
 const char* builtin_symbol_to_string(int name);
 int builtin_symbol_from_string(const char* str);
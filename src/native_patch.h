@@ -24,6 +24,9 @@ void module_patch_function(NativePatch* module, const char* name, EvaluateFunc f
 void native_patch_add_platform_specific_suffix(Value* filename);
 void native_patch_load_from_file(NativePatch* module, const char* filename);
 
+// Find the module that contains this block, or NULL if it's not inside a module.
+Block* find_enclosing_module(Block* block);
+
 // Called during bytecode compilation. Find the native func (if any) that should be used in
 // the execution of this block.
 NativeFuncIndex find_native_func_index(World* world, Block* block);
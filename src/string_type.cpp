@@ -105,6 +105,52 @@ int string_length(StringData* data)
     return data->length;
 }
 
+#if CIRCA_ENABLE_SMALL_STRINGS
+
+// Small strings are stored inside the Value's data field, with no StringData. The first
+// byte of the field holds (length << 1) | 1, followed by the characters and a null
+// terminator, and the rest of the field is zero. A StringData pointer always has a clear
+// low bit, so the first byte tells the two apart.
+//
+// The characters move with the Value, so a pointer from as_cstring() on a small string
+// is only good until the Value is moved or modified.
+
+const int SMALL_STRING_MAX_LENGTH = sizeof(caValueData) - 2;
+
+static inline bool is_small_string(Value* value)
+{
+    return (((uintptr_t) value->value_data.ptr) & 1) != 0;
+}
+
+static inline char* small_string_chars(Value* value)
+{
+    return ((char*) &value->value_data) + 1;
+}
+
+static inline int small_string_length(Value* value)
+{
+    return ((u8*) &value->value_data)[0] >> 1;
+}
+
+// Store a small string with the given length, and return the address of its characters.
+// The characters start off zeroed.
+static char* set_small_string_data(Value* value, int length)
+{
+    ca_assert(length <= SMALL_STRING_MAX_LENGTH);
+    stat_increment(StringCreateSmall);
+    value->value_data.ptr = NULL;
+    ((u8*) &value->value_data)[0] = (u8) ((length << 1) | 1);
+    return small_string_chars(value);
+}
+
+#else
+
+static inline bool is_small_string(Value* value) { return false; }
+static inline char* small_string_chars(Value* value) { return NULL; }
+static inline int small_string_length(Value* value) { return 0; }
+
+#endif
+
 // Tagged-value wrappers
 void string_initialize(Type* type, Value* value)
 {
@@ -113,19 +159,19 @@ void string_initialize(Type* type, Value* value)
 
 void string_release(Value* value)
 {
-    if (value->value_data.ptr == NULL)
+    if (value->value_data.ptr == NULL || is_small_string(value))
         return;
     decref((StringData*) value->value_data.ptr);
 }
 
 void string_copy(Value* source, Value* dest)
 {
-    StringData* data = (StringData*) source->value_data.ptr;
-    if (data != NULL)
-        incref(data);
+    caValueData data = source->value_data;
+    if (data.ptr != NULL && !is_small_string(source))
+        incref((StringData*) data.ptr);
 
     make_no_initialize(source->value_type, dest);
-    dest->value_data.ptr = data;
+    dest->value_data = data;
 
     stat_increment(StringSoftCopy);
 }
@@ -133,7 +179,7 @@ void string_copy(Value* source, Value* dest)
 void string_reset(Value* val)
 {
     StringData* data = (StringData*) val->value_data.ptr;
-    if (data != NULL)
+    if (data != NULL && !is_small_string(val))
         decref(data);
     val->value_data.ptr = NULL;
 }
@@ -158,10 +204,14 @@ bool string_equals(Value* left, Value* right)
     if (left->value_type != right->value_type)
         return false;
 
-    // Shortcut, check if objects are the same.
+    // Shortcut, check if objects are the same. This also covers two small strings with
+    // the same contents.
     if (left->value_data.ptr == right->value_data.ptr)
         return true;
 
+    if (is_small_string(left) || is_small_string(right))
+        return strcmp(as_cstring(left), as_cstring(right)) == 0;
+
     StringData* leftData = (StringData*) left->value_data.ptr;
     StringData* rightData = (StringData*) right->value_data.ptr;
 
@@ -214,6 +264,8 @@ void string_setup_type(Type* type)
 const char* as_cstring(Value* value)
 {
     ca_assert(value->value_type->storageType == s_StorageTypeString);
+    if (is_small_string(value))
+        return small_string_chars(value);
     StringData* data = (StringData*) value->value_data.ptr;
     if (data == NULL)
         return "";
@@ -237,15 +289,23 @@ void string_append_len(Value* left, const char* right, int len)
 
     ca_assert(is_string(left));
 
-    StringData** data = (StringData**) &left->value_data.ptr;
-    
-    int leftLength = string_length(*data);
+    // 'right' might point at the characters of a small string stored in 'left', which
+    // would be overwritten by the resize.
+    char smallBuf[sizeof(caValueData)];
+    if (right >= (const char*) &left->value_data
+            && right < (const char*) (&left->value_data + 1)) {
+        memcpy(smallBuf, right, len);
+        right = smallBuf;
+    }
+
+    int leftLength = string_length(left);
     int newLength = leftLength + len;
 
-    string_resize(data, newLength);
+    string_resize(left, newLength);
 
-    memcpy((*data)->str + leftLength, right, len);
-    (*data)->str[newLength] = 0;
+    char* str = (char*) as_cstring(left);
+    memcpy(str + leftLength, right, len);
+    str[newLength] = 0;
 }
 
 void string_append(Value* left, Value* right)
@@ -336,6 +396,33 @@ void string_resize(Value* s, int length)
     if (length < 0)
         length = string_length(s) + length;
 
+#if CIRCA_ENABLE_SMALL_STRINGS
+    if (is_small_string(s)) {
+        int oldLength = small_string_length(s);
+        if (length <= SMALL_STRING_MAX_LENGTH) {
+            // Zero everything past the new length, so that equal small strings have
+            // identical data.
+            char* str = small_string_chars(s);
+            if (length < oldLength)
+                memset(str + length, 0, oldLength - length);
+            ((u8*) &s->value_data)[0] = (u8) ((length << 1) | 1);
+            return;
+        }
+
+        // Too long, move to a StringData.
+        StringData* data = string_create(length);
+        memcpy(data->str, small_string_chars(s), oldLength);
+        data->str[length] = 0;
+        s->value_data.ptr = data;
+        return;
+    }
+
+    if (s->value_data.ptr == NULL && length <= SMALL_STRING_MAX_LENGTH) {
+        set_small_string_data(s, length);
+        return;
+    }
+#endif
+
     StringData** data = (StringData**) &s->value_data.ptr;
     string_resize(data, length);
 }
@@ -400,6 +487,8 @@ char string_get(Value* s, int index)
 
 int string_length(Value* s)
 {
+    if (is_small_string(s))
+        return small_string_length(s);
     return string_length((StringData*) s->value_data.ptr);
 }
 
@@ -593,6 +682,10 @@ std::string as_string(Value* value)
 char* string_initialize(Value* value, int length)
 {
     make(TYPES.string, value);
+#if CIRCA_ENABLE_SMALL_STRINGS
+    if (length <= SMALL_STRING_MAX_LENGTH)
+        return set_small_string_data(value, length);
+#endif
     StringData* data = string_create(length);
     value->value_data.ptr = data;
     return data->str;
@@ -600,16 +693,36 @@ char* string_initialize(Value* value, int length)
 
 void set_string(Value* value, const char* s)
 {
-    make(TYPES.string, value);
-    int length = (int) strlen(s);
-    StringData* data = string_create(length);
-    memcpy(data->str, s, length + 1);
-    value->value_data.ptr = data;
+    set_string(value, s, (int) strlen(s));
+}
+
+// Whether 'ptr' points at the characters held by this string.
+static bool string_holds_ptr(Value* value, const char* ptr)
+{
+    if (value->value_type->storageType != s_StorageTypeString)
+        return false;
+    const char* str = as_cstring(value);
+    return ptr >= str && ptr <= str + string_length(value);
 }
 
 void set_string(Value* value, const char* s, int length)
 {
+    if (string_holds_ptr(value, s)) {
+        // 's' came from this value (such as a slice of it), and make() would release it
+        // before the copy. Build the new string separately.
+        Value result;
+        set_string(&result, s, length);
+        move(&result, value);
+        return;
+    }
+
     make(TYPES.string, value);
+#if CIRCA_ENABLE_SMALL_STRINGS
+    if (length <= SMALL_STRING_MAX_LENGTH) {
+        memcpy(set_small_string_data(value, length), s, length);
+        return;
+    }
+#endif
     StringData* data = string_create(length);
     memcpy(data->str, s, length);
     data->str[length] = 0;
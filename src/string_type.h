@@ -51,6 +51,9 @@ void string_join(Value* list, Value* separator, Value* out);
 
 void string_split(Value* s, char sep, Value* listOut);
 
+// For a small string, the characters are stored inside the Value, so the result is only
+// good until the Value is moved, copied over, resized or released. That includes the Value
+// moving along with its container, such as a list or the VM stack being reallocated.
 const char* as_cstring(Value* value);
 
 // Initialize a string with the given length, and return the address. This value
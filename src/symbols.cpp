@@ -2,8 +2,10 @@
 
 #include "common_headers.h"
 
-#include "hashtable.h"
-#include "list.h"
+#include <atomic>
+#include <new>
+
+#include "debug.h"
 #include "names_builtin.h"
 #include "string_type.h"
 #include "symbols.h"
@@ -13,43 +15,272 @@
 
 namespace circa {
 
-Value* g_runtimeSymbolMap;    // Maps strings to Symbol values.
-Value* g_runtimeSymbolTable;   // List, associating Symbol values with strings.
-int g_nextRuntimeSymbol = s_LastBuiltinName + 1;
+/*
+ Symbol table
+
+ Every symbol, builtin or runtime, has a SymbolEntry that holds its text. Entries are
+ allocated from an arena and stay put until symbol_deinitialize_global_table, so the
+ pointer returned by symbol_as_string stays valid.
+
+ The table can be used from several threads at once, without locking. Entries are found
+ by hash, in an insert-only hash trie:
+
+  - Each slot (in the root array, or in a node below it) is either empty, holds one
+    entry, or points to a child node that uses the next SYMBOL_NODE_BITS of the hash.
+  - A new entry is stored in an empty slot with a compare-and-swap. If the slot already
+    holds a different entry, then a child node is created with that entry in it, and
+    swapped into the slot. Either way, if the swap fails then another thread changed the
+    slot first, and we look at it again.
+  - Slots never go back to empty, and entries are never removed, so readers can always
+    walk down the trie while another thread is adding to it.
+  - After the last hash bits, entries with the same hash share a slot as a chain, which
+    is only ever extended at the head.
+  - Symbol ids are mapped back to entries with a two-level array. Blocks of that array
+    are also installed with compare-and-swap.
+
+ When two threads create the same symbol at once, one of them wins and the other's symbol
+ id is never used. Looking up a symbol that already exists doesn't allocate.
+*/
+
+struct SymbolEntry {
+    SymbolEntry* next;
+    u32 hash;
+    int length;
+    Symbol symbol;
+    char text[0];
+};
+
+struct SymbolArenaChunk {
+    SymbolArenaChunk* prev;
+    size_t size;
+    std::atomic<size_t> used;
+    char* data() { return (char*) (this + 1); }
+};
+
+// A slot holds NULL, a SymbolEntry*, or a SymbolNode* with the low bit set.
+typedef std::atomic<void*> SymbolSlot;
+typedef std::atomic<SymbolEntry*> SymbolEntryPtr;
+
+#define SYMBOL_ROOT_BITS 12
+#define SYMBOL_NODE_BITS 4
+#define SYMBOL_NODE_WIDTH (1 << SYMBOL_NODE_BITS)
+
+struct SymbolNode {
+    SymbolSlot slots[SYMBOL_NODE_WIDTH];
+};
+
+const size_t SYMBOL_ARENA_CHUNK_SIZE = 16 * 1024;
+const int SYMBOL_INDEX_BLOCK_SIZE = 1024;
+const int SYMBOL_INDEX_BLOCK_COUNT = 4096;
+
+static std::atomic<SymbolArenaChunk*> g_symbolArena;
+static SymbolSlot g_symbolRoot[1 << SYMBOL_ROOT_BITS];
+static std::atomic<SymbolEntryPtr*> g_symbolIndex[SYMBOL_INDEX_BLOCK_COUNT];
+static std::atomic<int> g_nextRuntimeSymbol(s_LastBuiltinName + 1);
+
+static u32 symbol_text_hash(const char* str, int length)
+{
+    // Reads 8 bytes at a time, and mixes each word in with a multiply.
+    const u64 k = 0x9e3779b97f4a7c15ull;
+    u64 hash = (u64) length * k;
+
+    while (length >= 8) {
+        u64 word;
+        memcpy(&word, str, 8);
+        hash = (hash ^ word) * k;
+        hash ^= hash >> 32;
+        str += 8;
+        length -= 8;
+    }
+
+    if (length > 0) {
+        u64 word = 0;
+        for (int i=0; i < length; i++)
+            word |= (u64) (u8) str[i] << (8 * i);
+        hash = (hash ^ word) * k;
+        hash ^= hash >> 32;
+    }
+
+    return u32(hash);
+}
+
+static void* symbol_arena_alloc(size_t size)
+{
+    size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+    while (true) {
+        SymbolArenaChunk* chunk = g_symbolArena.load(std::memory_order_acquire);
+        if (chunk != NULL) {
+            size_t offset = chunk->used.fetch_add(size);
+            if (offset + size <= chunk->size)
+                return chunk->data() + offset;
+        }
+
+        // This chunk is full, start a new one. The first allocation in the new chunk is
+        // ours.
+        size_t chunkSize = size > SYMBOL_ARENA_CHUNK_SIZE ? size : SYMBOL_ARENA_CHUNK_SIZE;
+        SymbolArenaChunk* newChunk = (SymbolArenaChunk*)
+            malloc(sizeof(SymbolArenaChunk) + chunkSize);
+        new (newChunk) SymbolArenaChunk();
+        newChunk->prev = chunk;
+        newChunk->size = chunkSize;
+        newChunk->used = size;
+
+        if (g_symbolArena.compare_exchange_strong(chunk, newChunk))
+            return newChunk->data();
+
+        // Another thread started a new chunk first.
+        newChunk->~SymbolArenaChunk();
+        free(newChunk);
+    }
+}
+
+static bool slot_is_node(void* slot)
+{
+    return ((size_t) slot & 1) != 0;
+}
+
+static SymbolNode* slot_as_node(void* slot)
+{
+    return (SymbolNode*) ((size_t) slot - 1);
+}
+
+static SymbolEntryPtr* symbol_index_slot(Symbol symbol, bool create)
+{
+    if (symbol < 0 || symbol >= SYMBOL_INDEX_BLOCK_COUNT * SYMBOL_INDEX_BLOCK_SIZE)
+        return NULL;
+
+    std::atomic<SymbolEntryPtr*>& blockPtr = g_symbolIndex[symbol / SYMBOL_INDEX_BLOCK_SIZE];
+    SymbolEntryPtr* block = blockPtr.load(std::memory_order_acquire);
+
+    if (block == NULL) {
+        if (!create)
+            return NULL;
+
+        SymbolEntryPtr* newBlock = new SymbolEntryPtr[SYMBOL_INDEX_BLOCK_SIZE]();
+        if (blockPtr.compare_exchange_strong(block, newBlock))
+            block = newBlock;
+        else
+            delete[] newBlock;
+    }
+
+    return &block[symbol % SYMBOL_INDEX_BLOCK_SIZE];
+}
+
+static SymbolEntry* symbol_entry(Symbol symbol)
+{
+    SymbolEntryPtr* slot = symbol_index_slot(symbol, false);
+    if (slot == NULL)
+        return NULL;
+    return slot->load(std::memory_order_acquire);
+}
+
+static SymbolEntry* symbol_chain_find(SymbolEntry* entry, const char* str, int length,
+    u32 hash)
+{
+    for (; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && entry->length == length
+                && memcmp(entry->text, str, length) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+// Find the entry for this text, or create it using 'symbol' (or the next runtime
+// symbol id, if 'symbol' is -1).
+static SymbolEntry* symbol_intern(const char* str, int length, Symbol symbol)
+{
+    u32 hash = symbol_text_hash(str, length);
+    SymbolSlot* slot = &g_symbolRoot[hash & ((1 << SYMBOL_ROOT_BITS) - 1)];
+    int shift = SYMBOL_ROOT_BITS;
+
+    SymbolEntry* newEntry = NULL;
+    SymbolEntryPtr* indexSlot = NULL;
+
+    while (true) {
+        void* current = slot->load(std::memory_order_acquire);
+
+        if (slot_is_node(current)) {
+            SymbolNode* node = slot_as_node(current);
+            slot = &node->slots[(hash >> shift) & (SYMBOL_NODE_WIDTH - 1)];
+            shift += SYMBOL_NODE_BITS;
+            continue;
+        }
+
+        SymbolEntry* existing = (SymbolEntry*) current;
+        SymbolEntry* found = symbol_chain_find(existing, str, length, hash);
+        if (found != NULL) {
+            // Another thread created this symbol first. If we were given the id (as with
+            // builtins) then we shared an index slot with that thread, so put its entry
+            // back.
+            if (indexSlot != NULL) {
+                SymbolEntry* expected = newEntry;
+                indexSlot->compare_exchange_strong(expected,
+                    found->symbol == symbol ? found : NULL);
+            }
+            return found;
+        }
+
+        if (existing == NULL || shift >= 32) {
+            // Add our entry here.
+            if (newEntry == NULL) {
+                if (symbol == -1)
+                    symbol = g_nextRuntimeSymbol.fetch_add(1);
+
+                indexSlot = symbol_index_slot(symbol, true);
+                if (indexSlot == NULL)
+                    internal_error("string_to_symbol: too many symbols");
+
+                newEntry = (SymbolEntry*) symbol_arena_alloc(sizeof(SymbolEntry) + length + 1);
+                newEntry->hash = hash;
+                newEntry->length = length;
+                newEntry->symbol = symbol;
+                memcpy(newEntry->text, str, length);
+                newEntry->text[length] = 0;
+
+                // Make the symbol id resolvable before anyone can find the entry.
+                indexSlot->store(newEntry, std::memory_order_release);
+            }
+
+            newEntry->next = existing;
+            if (slot->compare_exchange_strong(current, newEntry, std::memory_order_release,
+                    std::memory_order_relaxed))
+                return newEntry;
+            continue;
+        }
+
+        // This slot has a different entry, move it down into a new node.
+        SymbolNode* node = new (symbol_arena_alloc(sizeof(SymbolNode))) SymbolNode();
+        node->slots[(existing->hash >> shift) & (SYMBOL_NODE_WIDTH - 1)] = existing;
+        slot->compare_exchange_strong(current, (void*) ((size_t) node + 1),
+            std::memory_order_release, std::memory_order_relaxed);
+
+        // If that failed, another thread changed the slot first. The node is left unused
+        // in the arena.
+    }
+}
+
+Symbol string_to_symbol(const char* str, int length)
+{
+    return symbol_intern(str, length, -1)->symbol;
+}
 
 Symbol string_to_symbol(const char* str)
 {
-    // Find this name as an existing builtin symbol.
+    // The generated lookup is quicker for builtin names. Builtins are also in the table,
+    // for callers that only have a length.
     int foundBuiltin = builtin_symbol_from_string(str);
     if (foundBuiltin != -1)
         return foundBuiltin;
 
-    // Find this name as an existing runtime symbol.
-    Value strVal;
-    set_string(&strVal, str);
-
-    Value* foundRuntime = hashtable_get(g_runtimeSymbolMap, &strVal);
-    if (foundRuntime != NULL)
-        return as_symbol(foundRuntime);
-
-    // Create a new runtime symbol.
-    Value* newRuntime = hashtable_insert(g_runtimeSymbolMap, &strVal);
-    int index = g_nextRuntimeSymbol++;
-    set_int(newRuntime, index);
-    list_resize(g_runtimeSymbolTable, index+1);
-    set_value(list_get(g_runtimeSymbolTable, index), &strVal);
-    return index;
+    return string_to_symbol(str, strlen(str));
 }
 
 void set_symbol_from_string(Value* val, Value* str)
 {
-    if (val == str) {
-        Value temp;
-        move(str, &temp);
-        return set_symbol_from_string(val, &temp);
-    }
-
-    set_symbol(val, string_to_symbol(as_cstring(str)));
+    // 'val' and 'str' may be the same value, so finish reading the string first.
+    Symbol symbol = string_to_symbol(as_cstring(str), string_length(str));
+    set_symbol(val, symbol);
 }
 
 void set_symbol_from_string(Value* val, const char* str)
@@ -59,13 +290,9 @@ void set_symbol_from_string(Value* val, const char* str)
 
 const char* symbol_as_string(Symbol symbol)
 {
-    const char* builtinName = builtin_symbol_to_string(symbol);
-    if (builtinName != NULL)
-        return builtinName;
-
-    Value* tableVal = list_get(g_runtimeSymbolTable, symbol);
-    if (tableVal != NULL)
-        return as_cstring(tableVal);
+    SymbolEntry* entry = symbol_entry(symbol);
+    if (entry != NULL)
+        return entry->text;
 
     return NULL;
 }
@@ -79,16 +306,9 @@ void symbol_to_string(Value* symbol, Value* str)
 {
     ca_assert(symbol != str);
 
-    const char* builtinName = builtin_symbol_to_string(as_symbol(symbol));
-    if (builtinName != NULL) {
-        set_string(str, builtinName);
-        return;
-    }
-
-    Value* tableVal = list_get(g_runtimeSymbolTable, as_symbol(symbol));
-    if (tableVal != NULL) {
-        ca_assert(is_string(tableVal));
-        copy(tableVal, str);
+    SymbolEntry* entry = symbol_entry(as_symbol(symbol));
+    if (entry != NULL) {
+        set_string(str, entry->text, entry->length);
         return;
     }
 
@@ -111,22 +331,35 @@ bool symbol_eq(Value* val, Symbol s)
     return is_symbol(val) && as_symbol(val) == s;
 }
 
+// Called by each new World. Only the first call adds anything.
 void symbol_initialize_global_table()
 {
-    g_runtimeSymbolMap = new Value();
-    set_hashtable(g_runtimeSymbolMap);
-    g_runtimeSymbolTable = new Value();
-    set_list(g_runtimeSymbolTable, 0);
+    for (Symbol symbol=0; symbol < s_LastBuiltinName; symbol++) {
+        const char* name = builtin_symbol_to_string(symbol);
+        symbol_intern(name, strlen(name), symbol);
+    }
 }
 
 void symbol_deinitialize_global_table()
 {
-    set_null(g_runtimeSymbolMap);
-    delete g_runtimeSymbolMap;
-    g_runtimeSymbolMap = NULL;
-    set_null(g_runtimeSymbolTable);
-    delete g_runtimeSymbolTable;
-    g_runtimeSymbolTable = NULL;
+    // Not thread safe, this should only happen when the last World is shut down.
+    for (int i=0; i < (1 << SYMBOL_ROOT_BITS); i++)
+        g_symbolRoot[i] = NULL;
+
+    for (int i=0; i < SYMBOL_INDEX_BLOCK_COUNT; i++) {
+        delete[] g_symbolIndex[i].load();
+        g_symbolIndex[i] = NULL;
+    }
+
+    SymbolArenaChunk* chunk = g_symbolArena.exchange(NULL);
+    while (chunk != NULL) {
+        SymbolArenaChunk* prev = chunk->prev;
+        chunk->~SymbolArenaChunk();
+        free(chunk);
+        chunk = prev;
+    }
+
+    g_nextRuntimeSymbol = s_LastBuiltinName + 1;
 }
 
 void symbol_setup_type(Type* type)
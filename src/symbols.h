@@ -5,6 +5,7 @@
 namespace circa {
 
 Symbol string_to_symbol(const char* str);
+Symbol string_to_symbol(const char* str, int length);
 void set_symbol_from_string(Value* val, Value* str);
 void set_symbol_from_string(Value* val, const char* str);
 
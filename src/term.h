@@ -44,7 +44,12 @@ struct Term
         Value name;
         Value base;
         int ordinal;
-        UniqueName() : ordinal(0) {}
+
+        // Hashes of 'name' and 'base', used to skip string comparisons when searching
+        // for a collision.
+        u32 nameHash;
+        u32 baseHash;
+        UniqueName() : ordinal(0), nameHash(0), baseHash(0) {}
     };
 
     UniqueName uniqueName;
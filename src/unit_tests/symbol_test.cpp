@@ -47,6 +47,16 @@ void new_runtime_symbol()
     test_assert(as_symbol(&b) != as_symbol(&c));
 }
 
+void lookup_with_length()
+{
+    Symbol a = string_to_symbol("NewSymbol3");
+    test_equals(string_to_symbol("NewSymbol3 and more", 10), a);
+    test_equals(symbol_as_string(a), "NewSymbol3");
+
+    // Builtins are found either way.
+    test_equals(string_to_symbol("filename", 4), s_file);
+}
+
 void builtin_symbol_used_in_code()
 {
     Block block;
@@ -65,6 +75,7 @@ void register_tests()
     REGISTER_TEST_CASE(symbol_test::builtin_to_string);
     REGISTER_TEST_CASE(symbol_test::find_builtin_with_string);
     REGISTER_TEST_CASE(symbol_test::new_runtime_symbol);
+    REGISTER_TEST_CASE(symbol_test::lookup_with_length);
     REGISTER_TEST_CASE(symbol_test::builtin_symbol_used_in_code);
 }
 
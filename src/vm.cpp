@@ -2,6 +2,8 @@
 
 #include "common_headers.h"
 
+#include <atomic>
+
 #include "bytecode.h"
 #include "blob.h"
 #include "block.h"
@@ -28,10 +30,14 @@
  State frames
 
  Each state frame consists of:
-   [parent, key, incoming, outgoing]
+   [key, incoming, outgoing]
+
+ Frames are stored back-to-back in vm->stateStack, so pushing a frame doesn't allocate
+ (once the stack has been that deep before). The parent of a frame is the one before it.
 
  Frame is created with op_push_state_frame which provides the value 'key'
    On creation we do a lookup in the topmost frame to digout 'incoming' (using key)
+   If nothing is found then 'incoming' is left as null.
    New frame is now 'topmost'
 
  save_state_value will write to 'outgoing' hashtable of the topmost frame
@@ -43,8 +49,17 @@
 
  pop_state_frame_discard is similar, but it discards 'outgoing'
 
+ Only the frame stack is flat. The state itself is still nested hashtables keyed by
+ unique name, for static keys as well as dynamic ones, so every frame that saves state
+ still builds an 'outgoing' table. A layout with slots fixed at compile time (and a flat
+ array per stateful block) hasn't been done. VM.get_state/set_state expose the named
+ form, and migrating state after a block is recompiled looks values up by name, so
+ slots would need a name mapping that's rebuilt on each recompile.
+
 */
 
+#define STATE_FRAME_SIZE 3
+
 namespace circa {
 
 VM* new_vm(World* world)
@@ -54,6 +69,8 @@ VM* new_vm(World* world)
     VM* vm = (VM*) malloc(sizeof(VM));
 
     vm->stack.init();
+    vm->stateStack.init();
+    vm->stateTop = 0;
     vm->world = world;
 
     vm->nextLiveVM = vm->world->firstLiveVM;
@@ -77,7 +94,6 @@ VM* new_vm(World* world)
     initialize_null(&vm->demandEvalMap);
     set_hashtable(&vm->demandEvalMap);
     initialize_null(&vm->incomingUpvalues);
-    initialize_null(&vm->stateStack);
     initialize_null(&vm->incomingEnv);
     set_hashtable(&vm->incomingEnv);
     initialize_null(&vm->env);
@@ -123,6 +139,8 @@ void free_vm(VM* vm)
     set_null(&vm->topLevelUpvalues);
     set_null(&vm->bcHacks);
     vm->stack.clear();
+    clear_state_stack(vm);
+    vm->stateStack.clear();
     set_null(&vm->incomingUpvalues);
     set_null(&vm->state);
     set_null(&vm->demandEvalMap);
@@ -138,7 +156,7 @@ void vm_reset_call_stack(VM* vm)
     vm->stack.clear();
     vm->stackTop = 0;
     vm->error = false;
-    set_null(&vm->stateStack);
+    clear_state_stack(vm);
     set_null(&vm->incomingUpvalues);
     vm->inputCount = 0;
 }
@@ -210,11 +228,62 @@ static inline Value* get_slot_fast(VM* vm, int slot)
     return vm->stack[index];
 }
 
+// Guard for the float ops: both inputs are numbers and at least one is a float. When
+// this fails, the op falls through to the generic call that follows it.
+static inline bool float_op_guard(Value* left, Value* right)
+{
+    if (is_float(left))
+        return is_float(right) || is_int(right);
+    return is_int(left) && is_float(right);
+}
+
 static inline Value* get_const(VM* vm, int constIndex)
 {
     return vm->bc->consts[constIndex];
 }
 
+#if CIRCA_ENABLE_INLINE_DYNAMIC_METHOD_CACHE
+
+// Each op_dyn_method call site has a small cache of [type, addr] entries, stored in its
+// const. Entries are dropped when the world's code changes (such as from
+// module_install_replacement).
+#define DYN_METHOD_CACHE_MAX_ENTRIES 4
+
+static inline int dyn_method_cache_lookup(VM* vm, Value* methodSite, Type* type)
+{
+    Value* version = methodSite->index(1);
+    Value* entries = methodSite->index(2);
+
+    if (version->as_i() != vm->world->globalScriptVersion) {
+        set_int(version, vm->world->globalScriptVersion);
+        set_list(entries, 0);
+        return -1;
+    }
+
+    int count = entries->length();
+    for (int i=0; i < count; i++) {
+        Value* entry = entries->index(i);
+        if (as_type(entry->index(0)) == type)
+            return entry->index(1)->as_i();
+    }
+    return -1;
+}
+
+static void dyn_method_cache_save(VM* vm, Value* methodSite, Type* type, int addr)
+{
+    Value* entries = methodSite->index(2);
+
+    // Past the limit, the call site is megamorphic and new types aren't cached.
+    if (entries->length() >= DYN_METHOD_CACHE_MAX_ENTRIES)
+        return;
+
+    Value* entry = entries->append()->set_list(2);
+    set_type(entry->index(0), type);
+    set_int(entry->index(1), addr);
+}
+
+#endif
+
 static inline void do_call_op(VM* vm, int top, int inputCount, int toAddr)
 {
     int prevTop = vm->stackTop;
@@ -227,6 +296,26 @@ static inline void do_call_op(VM* vm, int top, int inputCount, int toAddr)
     set_null(get_slot_fast(vm, 0));
 }
 
+static void vm_deoptimize_block(VM* vm, Block* block)
+{
+    // The inputs don't match this type-specialized block. Continue in the generic version,
+    // and patch the calling op to go there directly from now on.
+
+    stat_increment(Interpreter_DeoptimizeBlock);
+
+    int addr = find_or_compile_major_block(vm->bc, block);
+    int callerPc = vm->stack[vm->stackTop - 2]->as_i() - 1;
+
+    if (callerPc >= 0 && callerPc < vm->bc->opCount) {
+        Op* caller = &vm->bc->ops[callerPc];
+        if (caller->opcode == op_call || caller->opcode == op_copy_call
+                || caller->opcode == op_move_call)
+            caller->c = addr;
+    }
+
+    vm->pc = addr;
+}
+
 static void vm_throw_error_not_enough_inputs(VM* vm, Block* func, int found)
 {
     int expected = count_input_placeholders(func);
@@ -269,6 +358,32 @@ static void vm_throw_error_expected_closure(VM* vm, Value* value)
     vm->throw_error(&message);
 }
 
+#if TRACE_EXECUTION || TRACE_EXECUTION_REGISTERS
+static void vm_trace_op(VM* vm, Op op, int executionDepth)
+{
+    #if TRACE_EXECUTION_REGISTERS
+        for (int i=0; i < executionDepth; i++) printf(" ");
+        printf("(registers) ");
+        int count = std::min(vm->bc->slotCount, vm->stack.size - vm->stackTop);
+
+        for (int i=0; i < count; i++) {
+            char* s = get_slot_fast(vm, i)->to_c_string();
+            if (i != 0)
+                printf(", ");
+            printf("%d:%s", i, s);
+            free(s);
+        }
+        printf("\n");
+    #endif
+
+    #if TRACE_EXECUTION
+        for (int i=0; i < executionDepth; i++) printf(" ");
+        printf("[pc:%d]: ", vm->pc-1);
+        dump_op(vm->bc, op);
+    #endif
+}
+#endif
+
 void vm_run(VM* vm, VM* callingVM)
 {
     #if CIRCA_ENABLE_PERF_STATS
@@ -281,7 +396,7 @@ void vm_run(VM* vm, VM* callingVM)
 
     vm->pc = 0;
     vm->stackTop = 0;
-    set_null(&vm->stateStack);
+    clear_state_stack(vm);
     vm->error = false;
     vm->inputCount = 0;
     vm_grow_stack(vm, 1);
@@ -290,7 +405,7 @@ void vm_run(VM* vm, VM* callingVM)
 
     Op* ops = vm->bc->ops;
 
-    #if TRACE_EXECUTION
+    #if TRACE_EXECUTION || TRACE_EXECUTION_REGISTERS
         int executionDepth = 0;
     #endif
 
@@ -313,47 +428,134 @@ void vm_run(VM* vm, VM* callingVM)
     #endif
 
 
-    while (true) {
+    #if TRACE_EXECUTION || TRACE_EXECUTION_REGISTERS
+        #define trace_op() vm_trace_op(vm, op, executionDepth);
+    #else
+        #define trace_op()
+    #endif
 
-        ca_assert(vm->pc < vm->bc->opCount);
+    // The Op is copied out of the ops array (it's only 8 bytes), because some ops can
+    // compile more bytecode, which reallocates 'ops'.
+    #define fetch_op() \
+        ca_assert(vm->pc < vm->bc->opCount); \
+        op = ops[vm->pc++]; \
+        trace_op();
+
+    #if CIRCA_ENABLE_THREADED_DISPATCH
+
+        // Direct-threaded dispatch. Each handler finishes by fetching the next op and
+        // jumping straight to its label, so there's one indirect branch per handler
+        // (instead of a single shared one), and no bounds check on the opcode.
+        //
+        // The table is shared between threads. The first thread to get here fills it in,
+        // and any others wait for it to finish.
+        static void* dispatchTable[256];
+        static std::atomic<int> dispatchTableState(0); // 0 = empty, 1 = filling, 2 = ready
+
+        int expectedState = 0;
+        if (dispatchTableState.load(std::memory_order_acquire) != 2
+                && dispatchTableState.compare_exchange_strong(expectedState, 1)) {
+            for (int i=0; i < 256; i++)
+                dispatchTable[i] = &&label_unrecognized;
+
+            #define set_dispatch(opcode) dispatchTable[(u8) opcode] = &&label_##opcode;
+            set_dispatch(op_nope);
+            set_dispatch(op_uncompiled_call);
+            set_dispatch(op_uncompiled_copy_call);
+            set_dispatch(op_uncompiled_move_call);
+            set_dispatch(op_call);
+            set_dispatch(op_copy_call);
+            set_dispatch(op_move_call);
+            set_dispatch(op_guard_types);
+            set_dispatch(op_func_call_d);
+            set_dispatch(op_func_apply_d);
+            set_dispatch(op_dyn_method);
+            set_dispatch(op_jump);
+            set_dispatch(op_jif);
+            set_dispatch(op_jnif);
+            set_dispatch(op_jeq);
+            set_dispatch(op_jneq);
+            set_dispatch(op_jgt);
+            set_dispatch(op_jgte);
+            set_dispatch(op_jlt);
+            set_dispatch(op_jlte);
+            set_dispatch(op_grow_frame);
+            set_dispatch(op_load_const);
+            set_dispatch(op_load_i);
+            set_dispatch(op_native);
+            set_dispatch(op_ret_or_stop);
+            set_dispatch(op_ret);
+            set_dispatch(op_varargs_to_list);
+            set_dispatch(op_splat_upvalues);
+            set_dispatch(op_copy);
+            set_dispatch(op_move);
+            set_dispatch(op_set_null);
+            set_dispatch(op_cast_fixed_type);
+            set_dispatch(op_make_func);
+            set_dispatch(op_add_i);
+            set_dispatch(op_sub_i);
+            set_dispatch(op_mult_i);
+            set_dispatch(op_div_i);
+            set_dispatch(op_add_i_imm);
+            set_dispatch(op_sub_i_imm);
+            set_dispatch(op_lt_i);
+            set_dispatch(op_lte_i);
+            set_dispatch(op_gt_i);
+            set_dispatch(op_gte_i);
+            set_dispatch(op_add_f);
+            set_dispatch(op_sub_f);
+            set_dispatch(op_mult_f);
+            set_dispatch(op_div_f);
+            set_dispatch(op_lt_f);
+            set_dispatch(op_lte_f);
+            set_dispatch(op_gt_f);
+            set_dispatch(op_gte_f);
+            set_dispatch(op_push_state_frame);
+            set_dispatch(op_push_state_frame_dkey);
+            set_dispatch(op_pop_state_frame);
+            set_dispatch(op_pop_discard_state_frame);
+            set_dispatch(op_get_state_value);
+            set_dispatch(op_save_state_value);
+            set_dispatch(op_comment);
+            #undef set_dispatch
+
+            dispatchTableState.store(2, std::memory_order_release);
+        }
 
-        Op op = ops[vm->pc++];
+        while (dispatchTableState.load(std::memory_order_acquire) != 2) {}
 
-        #if TRACE_EXECUTION_REGISTERS
-            trace_execution_indent();
-            printf("(registers) ");
-            int count = std::min(vm->bc->slotCount, vm->stack.size - vm->stackTop);
+        #define dispatch_op() goto *dispatchTable[op.opcode];
+        #define dispatch_next() { fetch_op(); goto *dispatchTable[op.opcode]; }
+        #define vm_case(opcode) label_##opcode
+        #define vm_case_default label_unrecognized
+    #else
+        #define dispatch_op() switch (op.opcode)
+        #define dispatch_next() continue
+        #define vm_case(opcode) case opcode
+        #define vm_case_default default
+    #endif
 
-            for (int i=0; i < count; i++) {
-                char* s = get_slot_fast(vm, i)->to_c_string();
-                if (i != 0)
-                    printf(", ");
-                printf("%d:%s", i, s);
-                free(s);
-            }
-            printf("\n");
-        #endif
+    Op op;
 
-        #if TRACE_EXECUTION
-            trace_execution_indent();
-            printf("[pc:%d]: ", vm->pc-1);
-            dump_op(vm->bc, op);
-        #endif
+    while (true) {
 
-        switch (op.opcode) {
+        fetch_op();
 
-        case op_nope:
-            continue;
-        case op_uncompiled_call: {
+        dispatch_op() {
+
+        vm_case(op_nope):
+            dispatch_next();
+        vm_case(op_uncompiled_call): {
             vm->pc--;
             Block* block = get_const(vm, op.c)->asBlock();
-            int addr = find_or_compile_major_block(vm->bc, block);
+            Value* inputs = op.b > 0 ? get_slot_fast(vm, op.a + 1) : NULL;
+            int addr = find_or_compile_specialized_block(vm->bc, block, inputs, op.b);
             ops = vm->bc->ops;
             ops[vm->pc].opcode = op_call;
             ops[vm->pc].c = addr;
-            continue;
+            dispatch_next();
         }
-        case op_call: {
+        vm_case(op_call): {
             trace_call_inputs();
 
             do_call_op(vm, op.a, op.b, op.c);
@@ -362,9 +564,51 @@ void vm_run(VM* vm, VM* callingVM)
                 executionDepth++;
             #endif
 
-            continue;
+            dispatch_next();
+        }
+        vm_case(op_uncompiled_copy_call):
+        vm_case(op_uncompiled_move_call): {
+            vm->pc--;
+            Block* block = get_const(vm, op.c)->asBlock();
+            int addr = find_or_compile_specialized_block(vm->bc, block, get_slot_fast(vm, op.b), 1);
+            ops = vm->bc->ops;
+            ops[vm->pc].opcode = op.opcode == op_uncompiled_copy_call ? op_copy_call : op_move_call;
+            ops[vm->pc].c = addr;
+            dispatch_next();
+        }
+        vm_case(op_copy_call): {
+            copy(get_slot_fast(vm, op.b), get_slot_fast(vm, op.a + 1));
+            do_call_op(vm, op.a, 1, op.c);
+
+            #if TRACE_EXECUTION
+                executionDepth++;
+            #endif
+
+            dispatch_next();
+        }
+        vm_case(op_move_call): {
+            move(get_slot_fast(vm, op.b), get_slot_fast(vm, op.a + 1));
+            do_call_op(vm, op.a, 1, op.c);
+
+            #if TRACE_EXECUTION
+                executionDepth++;
+            #endif
+
+            dispatch_next();
         }
-        case op_func_call_d: {
+        vm_case(op_guard_types): {
+            Value* specialization = get_const(vm, op.c);
+            for (int i=0; i < op.b; i++) {
+                Value* typeId = specialization->index(i + 1);
+                if (!is_null(typeId) && get_slot_fast(vm, op.a + i)->value_type->id != as_int(typeId)) {
+                    vm_deoptimize_block(vm, specialization->index(0)->asBlock());
+                    ops = vm->bc->ops;
+                    break;
+                }
+            }
+            dispatch_next();
+        }
+        vm_case(op_func_call_d): {
             trace_call_inputs();
 
             Value* func = get_slot_fast(vm, op.a);
@@ -405,9 +649,9 @@ void vm_run(VM* vm, VM* callingVM)
                 executionDepth++;
             #endif
 
-            continue;
+            dispatch_next();
         }
-        case op_func_apply_d: {
+        vm_case(op_func_apply_d): {
             trace_call_inputs();
 
             int top = op.a;
@@ -465,20 +709,42 @@ void vm_run(VM* vm, VM* callingVM)
                 executionDepth++;
             #endif
 
-            continue;
+            dispatch_next();
         }
-        case op_dyn_method: {
+        vm_case(op_dyn_method): {
             trace_call_inputs();
 
-            // grow in case we need to convert to Table.get call.
-            vm_grow_stack(vm, op.a + 3);
+            // grow in case we need to convert to Table.get call. That shifts inputs up one
+            // slot to make room for the key, so the frame at op.a needs op.b + 2 slots
+            // (output, table, key, then the other inputs), counting from stackTop.
+            vm_grow_stack(vm, vm->stackTop + op.a + op.b + 2);
 
             Value* object = get_slot_fast(vm, op.a + 1);
-            Value* nameLocation = get_const(vm, op.c);
-            Block* method = find_method_on_type(get_value_type(object), nameLocation);
+            Type* objectType = get_value_type(object);
+
+            #if CIRCA_ENABLE_INLINE_DYNAMIC_METHOD_CACHE
+            {
+                int cachedAddr = dyn_method_cache_lookup(vm, get_const(vm, op.c), objectType);
+                if (cachedAddr != -1) {
+                    stat_increment(Interpreter_DynamicMethod_CacheHit);
+                    do_call_op(vm, op.a, op.b, cachedAddr);
+                    #if TRACE_EXECUTION
+                        executionDepth++;
+                    #endif
+                    dispatch_next();
+                }
+                stat_increment(Interpreter_DynamicMethod_CacheMiss);
+            }
+            #endif
+
+            stat_increment(Interpreter_DynamicMethod_SlowLookup);
+
+            Value* nameLocation = get_const(vm, op.c)->index(0);
+            Block* method = find_method_on_type(objectType, nameLocation);
 
             if (method == NULL) {
                 if (is_module_ref(object)) {
+                    stat_increment(Interpreter_DynamicMethod_SlowLookup_Module);
                     Term* found = module_lookup(vm->world, object, nameLocation->index(0));
                     if (found != NULL) {
                         if (is_function(found)) {
@@ -497,16 +763,17 @@ void vm_run(VM* vm, VM* callingVM)
                                 executionDepth++;
                             #endif
 
-                            continue;
+                            dispatch_next();
                         } else {
                             if (has_static_value(found)) {
                                 copy(term_value(found), get_slot_fast(vm, op.a));
-                                continue;
+                                dispatch_next();
                             }
                         }
                     }
 
                 } else if (is_hashtable(object)) {
+                    stat_increment(Interpreter_DynamicMethod_SlowLookup_Hashtable);
                     Block* function = NULL;
                     if (op.b > 1) {
                         function = FUNCS.table_get_and_call->nestedContents;
@@ -518,7 +785,7 @@ void vm_run(VM* vm, VM* callingVM)
                     ops = vm->bc->ops;
 
                     // re-acquire nameLocation because it can be invalidated by compile.
-                    nameLocation = get_const(vm, op.c);
+                    nameLocation = get_const(vm, op.c)->index(0);
 
                     for (int input=op.b - 1; input >= 1; input--) {
                         move(get_slot_fast(vm, op.a+1+input), get_slot_fast(vm, op.a+2+input));
@@ -530,13 +797,13 @@ void vm_run(VM* vm, VM* callingVM)
 
                     // Temp, convert to symbol if needed
                     if (is_string(input1))
-                        set_symbol(input1, string_to_symbol(as_cstring(input1)));
+                        set_symbol_from_string(input1, input1);
 
                     do_call_op(vm, op.a, op.b + 1, addr);
                     #if TRACE_EXECUTION
                         executionDepth++;
                     #endif
-                    continue;
+                    dispatch_next();
                 }
 
                 Value msg;
@@ -551,48 +818,72 @@ void vm_run(VM* vm, VM* callingVM)
             int addr = find_or_compile_major_block(vm->bc, method);
             ops = vm->bc->ops;
 
+            #if CIRCA_ENABLE_INLINE_DYNAMIC_METHOD_CACHE
+                dyn_method_cache_save(vm, get_const(vm, op.c), objectType, addr);
+            #endif
+
             do_call_op(vm, op.a, op.b, addr);
 
             #if TRACE_EXECUTION
                 executionDepth++;
             #endif
 
-            continue;
+            dispatch_next();
         }
-        case op_jump:
+        vm_case(op_jump):
             vm->pc = op.c;
-            continue;
-        case op_jif: {
+            dispatch_next();
+        vm_case(op_jif): {
             Value* a = get_slot_fast(vm, op.a);
             if (a->asBool())
                 vm->pc = op.c;
-            continue;
+            dispatch_next();
         }
-        case op_jnif: {
+        vm_case(op_jnif): {
             Value* a = get_slot_fast(vm, op.a);
             if (!a->asBool())
                 vm->pc = op.c;
-            continue;
+            dispatch_next();
         }
-        case op_jeq: {
+        vm_case(op_jeq): {
             Value* a = get_slot_fast(vm, op.a);
             Value* b = get_slot_fast(vm, op.b);
             if (equals(a, b))
                 vm->pc = op.c;
-            continue;
+            dispatch_next();
         }
-        case op_jneq: {
+        vm_case(op_jneq): {
             Value* a = get_slot_fast(vm, op.a);
             Value* b = get_slot_fast(vm, op.b);
             if (!equals(a, b))
                 vm->pc = op.c;
-            continue;
+            dispatch_next();
+        }
+        vm_case(op_jgt): {
+            if (get_slot_fast(vm, op.a)->as_i() > get_slot_fast(vm, op.b)->as_i())
+                vm->pc = op.c;
+            dispatch_next();
         }
-        case op_grow_frame: {
+        vm_case(op_jgte): {
+            if (get_slot_fast(vm, op.a)->as_i() >= get_slot_fast(vm, op.b)->as_i())
+                vm->pc = op.c;
+            dispatch_next();
+        }
+        vm_case(op_jlt): {
+            if (get_slot_fast(vm, op.a)->as_i() < get_slot_fast(vm, op.b)->as_i())
+                vm->pc = op.c;
+            dispatch_next();
+        }
+        vm_case(op_jlte): {
+            if (get_slot_fast(vm, op.a)->as_i() <= get_slot_fast(vm, op.b)->as_i())
+                vm->pc = op.c;
+            dispatch_next();
+        }
+        vm_case(op_grow_frame): {
             vm_grow_stack(vm, vm->stackTop + op.a);
-            continue;
+            dispatch_next();
         }
-        case op_load_const: {
+        vm_case(op_load_const): {
             Value* slot = get_slot_fast(vm, op.a);
             Value* val = get_const(vm, op.b);
             copy(val, slot);
@@ -602,14 +893,14 @@ void vm_run(VM* vm, VM* callingVM)
                 printf("loaded const %s to r%d\n", val->to_c_string(), op.a);
             #endif
 
-            continue;
+            dispatch_next();
         }
-        case op_load_i: {
+        vm_case(op_load_i): {
             Value* slot = get_slot_fast(vm, op.a);
             set_int(slot, op.b);
-            continue;
+            dispatch_next();
         }
-        case op_native: {
+        vm_case(op_native): {
             EvaluateFunc func = get_native_func(vm->world, op.a);
             func(vm);
 
@@ -619,16 +910,16 @@ void vm_run(VM* vm, VM* callingVM)
             if (vm->error)
                 goto finish_run;
 
-            continue;
+            dispatch_next();
         }
-        case op_ret_or_stop: {
+        vm_case(op_ret_or_stop): {
             if (vm->stackTop == 0) {
                 vm_cleanup_on_stop(vm);
                 goto finish_run;
             }
             // fallthrough
         }
-        case op_ret: {
+        vm_case(op_ret): {
             #if DEBUG
                 int prevTop = vm->stackTop;
             #endif
@@ -641,9 +932,9 @@ void vm_run(VM* vm, VM* callingVM)
             vm->pc = get_slot_fast(vm, -2)->as_i();
             vm->stackTop = get_slot_fast(vm, -1)->as_i();
 
-            continue;
+            dispatch_next();
         }
-        case op_varargs_to_list: {
+        vm_case(op_varargs_to_list): {
             Value list;
             int firstInputIndex = op.a;
             int inputCount = vm->inputCount - firstInputIndex;
@@ -652,9 +943,9 @@ void vm_run(VM* vm, VM* callingVM)
             for (int i=0; i < inputCount; i++)
                 copy(vm->stack[vm->stackTop + 1 + firstInputIndex + i], list.index(i));
             move(&list, vm->stack[vm->stackTop + firstInputIndex + 1]);
-            continue;
+            dispatch_next();
         }
-        case op_splat_upvalues: {
+        vm_case(op_splat_upvalues): {
             if (is_null(&vm->incomingUpvalues)) {
                 vm->throw_str("vm error: Called a closure without any bindings (maybe was a dyn_method call?)");
                 goto finish_run;
@@ -670,9 +961,9 @@ void vm_run(VM* vm, VM* callingVM)
                 copy(value, get_slot_fast(vm, op.a + i));
             }
             set_null(&vm->incomingUpvalues);
-            continue;
+            dispatch_next();
         }
-        case op_copy: {
+        vm_case(op_copy): {
             Value* dest = get_slot_fast(vm, op.a);
             Value* source = get_slot_fast(vm, op.b);
             copy(source, dest);
@@ -682,9 +973,9 @@ void vm_run(VM* vm, VM* callingVM)
                 printf("copied: %s from r%d to r%d\n", dest->to_c_string(), op.b, op.a);
             #endif
 
-            continue;
+            dispatch_next();
         }
-        case op_move: {
+        vm_case(op_move): {
             Value* dest = get_slot_fast(vm, op.a);
             Value* source = get_slot_fast(vm, op.b);
             move(source, dest);
@@ -694,14 +985,14 @@ void vm_run(VM* vm, VM* callingVM)
                 printf("moved: %s from r%d to r%d\n", dest->to_c_string(), op.b, op.a);
             #endif
 
-            continue;
+            dispatch_next();
         }
-        case op_set_null: {
+        vm_case(op_set_null): {
             Value* val = get_slot_fast(vm, op.a);
             set_null(val);
-            continue;
+            dispatch_next();
         }
-        case op_cast_fixed_type: {
+        vm_case(op_cast_fixed_type): {
             Value* dest = get_slot_fast(vm, op.a);
             Value* val = get_slot_fast(vm, op.b);
 
@@ -718,69 +1009,181 @@ void vm_run(VM* vm, VM* callingVM)
                 vm->throw_error(&msg);
                 goto finish_run;
             }
-            continue;
+            dispatch_next();
         }
-        case op_make_func: {
+        vm_case(op_make_func): {
             Value* a = get_slot_fast(vm, op.a);
             Value* b = get_slot_fast(vm, op.b);
             Value* c = get_slot_fast(vm, op.c);
             set_closure(a, b->asBlock(), c);
-            continue;
+            dispatch_next();
         }
-        case op_add_i: {
+        vm_case(op_add_i): {
             Value* a = get_slot_fast(vm, op.a);
             Value* b = get_slot_fast(vm, op.b);
             Value* c = get_slot_fast(vm, op.c);
             set_int(a, b->as_i() + c->as_i());
-            continue;
+            dispatch_next();
         }
-        case op_sub_i: {
+        vm_case(op_sub_i): {
             Value* a = get_slot_fast(vm, op.a);
             Value* b = get_slot_fast(vm, op.b);
             Value* c = get_slot_fast(vm, op.c);
             set_int(a, b->as_i() - c->as_i());
-            continue;
+            dispatch_next();
         }
-        case op_mult_i: {
+        vm_case(op_mult_i): {
             Value* a = get_slot_fast(vm, op.a);
             Value* b = get_slot_fast(vm, op.b);
             Value* c = get_slot_fast(vm, op.c);
             set_int(a, b->as_i() * c->as_i());
-            continue;
+            dispatch_next();
         }
-        case op_div_i: {
+        vm_case(op_div_i): {
             Value* a = get_slot_fast(vm, op.a);
             Value* b = get_slot_fast(vm, op.b);
             Value* c = get_slot_fast(vm, op.c);
             set_int(a, b->as_i() / c->as_i());
-            continue;
+            dispatch_next();
+        }
+        vm_case(op_add_i_imm): {
+            Value* a = get_slot_fast(vm, op.a);
+            Value* b = get_slot_fast(vm, op.b);
+            set_int(a, b->as_i() + op.c);
+            dispatch_next();
+        }
+        vm_case(op_sub_i_imm): {
+            Value* a = get_slot_fast(vm, op.a);
+            Value* b = get_slot_fast(vm, op.b);
+            set_int(a, b->as_i() - op.c);
+            dispatch_next();
+        }
+        vm_case(op_lt_i): {
+            Value* a = get_slot_fast(vm, op.a);
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            set_bool(a, b->as_i() < c->as_i());
+            dispatch_next();
+        }
+        vm_case(op_lte_i): {
+            Value* a = get_slot_fast(vm, op.a);
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            set_bool(a, b->as_i() <= c->as_i());
+            dispatch_next();
+        }
+        vm_case(op_gt_i): {
+            Value* a = get_slot_fast(vm, op.a);
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            set_bool(a, b->as_i() > c->as_i());
+            dispatch_next();
+        }
+        vm_case(op_gte_i): {
+            Value* a = get_slot_fast(vm, op.a);
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            set_bool(a, b->as_i() >= c->as_i());
+            dispatch_next();
+        }
+        vm_case(op_add_f): {
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            if (float_op_guard(b, c)) {
+                set_float(get_slot_fast(vm, op.a), to_float(b) + to_float(c));
+                vm->pc++;
+            }
+            dispatch_next();
+        }
+        vm_case(op_sub_f): {
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            if (float_op_guard(b, c)) {
+                set_float(get_slot_fast(vm, op.a), to_float(b) - to_float(c));
+                vm->pc++;
+            }
+            dispatch_next();
+        }
+        vm_case(op_mult_f): {
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            if (float_op_guard(b, c)) {
+                set_float(get_slot_fast(vm, op.a), to_float(b) * to_float(c));
+                vm->pc++;
+            }
+            dispatch_next();
+        }
+        vm_case(op_div_f): {
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            if (is_number(b) && is_number(c)) {
+                set_float(get_slot_fast(vm, op.a), to_float(b) / to_float(c));
+                vm->pc++;
+            }
+            dispatch_next();
+        }
+        vm_case(op_lt_f): {
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            if (float_op_guard(b, c)) {
+                set_bool(get_slot_fast(vm, op.a), to_float(b) < to_float(c));
+                vm->pc++;
+            }
+            dispatch_next();
         }
-        case op_push_state_frame: {
+        vm_case(op_lte_f): {
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            if (float_op_guard(b, c)) {
+                set_bool(get_slot_fast(vm, op.a), to_float(b) <= to_float(c));
+                vm->pc++;
+            }
+            dispatch_next();
+        }
+        vm_case(op_gt_f): {
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            if (float_op_guard(b, c)) {
+                set_bool(get_slot_fast(vm, op.a), to_float(b) > to_float(c));
+                vm->pc++;
+            }
+            dispatch_next();
+        }
+        vm_case(op_gte_f): {
+            Value* b = get_slot_fast(vm, op.b);
+            Value* c = get_slot_fast(vm, op.c);
+            if (float_op_guard(b, c)) {
+                set_bool(get_slot_fast(vm, op.a), to_float(b) >= to_float(c));
+                vm->pc++;
+            }
+            dispatch_next();
+        }
+        vm_case(op_push_state_frame): {
             Value* key = NULL;
             Term* caller = vm_calling_term(vm);
             if (caller != NULL)
                 key = unique_name(caller);
             push_state_frame(vm, key);
-            continue;
+            dispatch_next();
         }
-        case op_push_state_frame_dkey:
+        vm_case(op_push_state_frame_dkey):
             push_state_frame(vm, get_slot_fast(vm, op.a));
-            continue;
-        case op_pop_state_frame:
+            dispatch_next();
+        vm_case(op_pop_state_frame):
             pop_state_frame(vm);
-            continue;
-        case op_pop_discard_state_frame:
+            dispatch_next();
+        vm_case(op_pop_discard_state_frame):
             pop_discard_state_frame(vm);
-            continue;
-        case op_get_state_value:
+            dispatch_next();
+        vm_case(op_get_state_value):
             get_state_value(vm, get_slot_fast(vm, op.b), get_slot_fast(vm, op.a));
-            continue;
-        case op_save_state_value:
+            dispatch_next();
+        vm_case(op_save_state_value):
             save_state_value(vm, get_slot_fast(vm, op.a), get_slot_fast(vm, op.b));
-            continue;
-        case op_comment:
-            continue;
-        default: {
+            dispatch_next();
+        vm_case(op_comment):
+            dispatch_next();
+        vm_case_default: {
             printf("unrecognized op: 0x%x\n", op.opcode);
             internal_error("unrecognized op in vm_run");
         }
@@ -788,6 +1191,13 @@ void vm_run(VM* vm, VM* callingVM)
     }
 
 finish_run:;
+    #undef fetch_op
+    #undef trace_op
+    #undef dispatch_op
+    #undef dispatch_next
+    #undef vm_case
+    #undef vm_case_default
+
     #if TRACE_EXECUTION
         printf("vm_run finished");
         if (vm->error)
@@ -990,6 +1400,11 @@ void VM__perf_stats(VM* vm)
 #endif
 }
 
+void perf_stats_enabled(VM* vm)
+{
+    set_bool(vm->output(), CIRCA_ENABLE_PERF_STATS);
+}
+
 void bytecode_get_mop_size(VM* vm)
 {
     set_int(vm->output(), (int) sizeof(BytecodeMetadata));
@@ -1100,15 +1515,49 @@ VMStackFrame vm_walk_up_stack_frames(VM* vm, VMStackFrame frame, int count)
     return frame;
 }
 
+Term* vm_find_calling_term(VM* vm, int height)
+{
+    // Find the term that made the call 'height' frames up from the top. Calls that were
+    // inlined count as frames, so the result doesn't depend on what got inlined.
+
+    Bytecode* bc = vm->bc;
+    VMStackFrame frame = vm_top_stack_frame(vm);
+
+    while (true) {
+        frame = vm_walk_up_stack_frames(vm, frame, 1);
+        if (frame.top == -1)
+            return NULL;
+
+        if (bc == NULL || bc->metadataSize == 0) {
+            if (height == 0)
+                return NULL;
+            height--;
+            continue;
+        }
+
+        int maddr = find_return_maddr(bc, frame.pc);
+
+        if (height == 0)
+            return find_active_term_at_maddr(bc, maddr);
+        height--;
+
+        for (int start = find_active_inline_start(bc, maddr); start != -1;
+                start = find_active_inline_start(bc, start - 1)) {
+            if (height == 0)
+                return find_active_term_at_maddr(bc, start - 1);
+            height--;
+        }
+    }
+}
+
 void reflect_caller(VM* vm)
 {
     int height = vm->input(0)->as_i();
-    VMStackFrame frame = vm_walk_up_stack_frames(vm, vm_top_stack_frame(vm), height + 1);
+    Term* term = vm_find_calling_term(vm, height);
 
-    if (frame.top == -1)
+    if (term == NULL)
         return set_null(vm->output());
 
-    Term* term = find_active_term(vm->bc, frame.pc);
     set_term_ref(vm->output(), term);
 }
 
@@ -1133,31 +1582,43 @@ void vm_demand_eval_store(VM* vm)
     copy(vm->input(1), hashtable_insert_term_key(&vm->demandEvalMap, term));
 }
 
+static Value* state_frame(VM* vm, int index)
+{
+    return vm->stateStack[index * STATE_FRAME_SIZE];
+}
+
+void clear_state_stack(VM* vm)
+{
+    for (int i=0; i < vm->stateTop * STATE_FRAME_SIZE; i++)
+        set_null(vm->stateStack[i]);
+    vm->stateTop = 0;
+}
+
 void push_state_frame(VM* vm, Value* key)
 {
     #if TRACE_STATE_EXECUTION
-        printf("pushing state frame, top = %d (was %d), key = %s\n", newTop,
-            vm->stateTop, key->to_c_string());
+        printf("pushing state frame, top = %d, key = %s\n", vm->stateTop,
+            key == NULL ? "null" : key->to_c_string());
     #endif
 
-    if (is_null(&vm->stateStack)) {
+    int index = vm->stateTop;
+    vm->stateStack.reserve((index + 1) * STATE_FRAME_SIZE);
+    vm->stateTop++;
+
+    Value* top = state_frame(vm, index);
+    Value* incoming = top + 1;
+
+    if (index == 0) {
         // First frame
-        set_list(&vm->stateStack, 4);
-        copy(&vm->state, vm->stateStack.index(2));
+        copy(&vm->state, incoming);
         return;
     }
 
     ca_assert(key != NULL);
 
-    Value parent;
-    Value top;
+    copy(key, top);
 
-    move(&vm->stateStack, &parent);
-    set_list(&top, 4);
-    copy(key, top.index(1));
-
-    Value* parentIncoming = parent.index(2);
-    Value* incoming = top.index(2);
+    Value* parentIncoming = state_frame(vm, index - 1) + 1;
 
     Value* found = NULL;
 
@@ -1171,36 +1632,30 @@ void push_state_frame(VM* vm, Value* key)
             printf("  incoming state frame is: %s\n", incoming->to_c_string());
         #endif
     } else {
-        set_hashtable(incoming);
         #if TRACE_STATE_EXECUTION
             printf("  incoming state frame is null\n");
         #endif
     }
-
-    move(&parent, top.index(0));
-    move(&top, &vm->stateStack);
 }
 
 void pop_state_frame(VM* vm)
 {
-    ca_assert(!is_null(&vm->stateStack));
-
-    Value top;
-    Value parent;
+    ca_assert(vm->stateTop > 0);
 
-    move(&vm->stateStack, &top);
-    move(top.index(0), &parent);
+    vm->stateTop--;
+    Value* top = state_frame(vm, vm->stateTop);
+    Value* key = top;
+    Value* topOutgoing = top + 2;
 
-    Value* topOutgoing = top.index(3);
+    set_null(top + 1);
 
-    if (is_null(&parent)) {
+    if (vm->stateTop == 0) {
         // First frame
         move(topOutgoing, &vm->state);
         return;
     }
 
-    Value* key = top.index(1);
-    Value* parentOutgoing = parent.index(3);
+    Value* parentOutgoing = state_frame(vm, vm->stateTop - 1) + 2;
 
     if (is_null(topOutgoing)) {
         if (is_hashtable(parentOutgoing))
@@ -1214,19 +1669,22 @@ void pop_state_frame(VM* vm)
         move(topOutgoing, hashtable_insert(parentOutgoing, key));
     }
 
-    move(&parent, &vm->stateStack);
+    set_null(key);
 }
 
 void pop_discard_state_frame(VM* vm)
 {
-    Value top;
-    move(&vm->stateStack, &top);
-    move(top.index(0), &vm->stateStack);
+    ca_assert(vm->stateTop > 0);
+
+    vm->stateTop--;
+    Value* top = state_frame(vm, vm->stateTop);
+    for (int i=0; i < STATE_FRAME_SIZE; i++)
+        set_null(top + i);
 }
 
 void get_state_value(VM* vm, Value* key, Value* dest)
 {
-    Value* frameIncoming = vm->stateStack.index(2);
+    Value* frameIncoming = state_frame(vm, vm->stateTop - 1) + 1;
     Value* found = NULL;
     if (is_hashtable(frameIncoming))
         found = hashtable_get(frameIncoming, key);
@@ -1247,7 +1705,7 @@ void save_state_value(VM* vm, Value* key, Value* value)
             value->to_c_string());
     #endif
 
-    Value* frameOutgoing = vm->stateStack.index(3);
+    Value* frameOutgoing = state_frame(vm, vm->stateTop - 1) + 2;
     if (is_null(value)) {
         if (is_hashtable(frameOutgoing))
             hashtable_remove(frameOutgoing, key);
@@ -1278,6 +1736,30 @@ void vm_to_frame_list(VM* vm, Value* frameList)
     int currentPc = vm->pc;
 
     while (true) {
+        Term* currentTerm = NULL;
+
+        // Calls that were inlined into this frame are listed as their own frames.
+        if (bc != NULL && bc->metadataSize > 0) {
+            // In every frame the pc has already moved past the op that's running (or that
+            // made the call), which might have been the last op of an inlined call.
+            int maddr = find_running_maddr(bc, currentPc);
+            currentTerm = find_active_term_at_maddr(bc, maddr);
+            int inlineStart = find_active_inline_start(bc, maddr);
+
+            while (inlineStart != -1) {
+                Value* inlined = frameList->append()->set_hashtable();
+                inlined->insert(s_block)->set_block(bc->metadata[inlineStart].block);
+                inlined->insert(s_top)->set_int(currentTop);
+                inlined->insert(s_pc)->set_int(currentPc);
+                inlined->insert(s_current_term)->set_term(currentTerm);
+
+                // Like a real frame, the caller's term is found at the return address.
+                currentTerm = find_active_term_at_maddr(bc,
+                    find_return_maddr(bc, find_inline_end_addr(bc, inlineStart)));
+                inlineStart = find_active_inline_start(bc, inlineStart - 1);
+            }
+        }
+
         Value* frame = frameList->append()->set_hashtable();
 
         Block* block = find_active_major_block(bc, currentPc);
@@ -1287,8 +1769,6 @@ void vm_to_frame_list(VM* vm, Value* frameList)
         //Value* blockInfo = bc->blockToInfo.val_key(&blockVal);
         //int slotCount = blockInfo->field(s_slotCount)->as_i();
 
-        Term* currentTerm = find_active_term(bc, currentPc);
-
         frame->insert(s_block)->set_block(block);
         frame->insert(s_top)->set_int(currentTop);
         frame->insert(s_pc)->set_int(currentPc);
@@ -1355,7 +1835,11 @@ void VM::dump()
 void VM::throw_error(Value* err)
 {
     this->error = true;
-    copy(err, this->output());
+
+    // Natives often build the error in their output slot, in which case it's already
+    // in place.
+    if (err != this->output())
+        copy(err, this->output());
 }
 
 void vm_pop_frames(VM* vm, int height)
@@ -1529,6 +2013,7 @@ void vm_install_functions(NativePatch* patch)
     circa_patch_function(patch, "VM.get_bytecode_const", VM__get_bytecode_const);
     circa_patch_function(patch, "VM.precompile", VM__precompile);
     circa_patch_function(patch, "VM.perf_stats", VM__perf_stats);
+    circa_patch_function(patch, "perf_stats_enabled", perf_stats_enabled);
     circa_patch_function(patch, "bytecode_mop_size", bytecode_get_mop_size);
     circa_patch_function(patch, "reflect_caller", reflect_caller);
     circa_patch_function(patch, "reflect_stack_trace", reflect_stack_trace);
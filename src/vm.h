@@ -30,7 +30,10 @@ struct VM {
     u8 inputCount;
     Value incomingUpvalues;
 
-    Value stateStack;
+    // State frames, STATE_FRAME_SIZE values each. Only the first 'stateTop' frames are
+    // in use, the rest is kept allocated for the next push.
+    ValueArray stateStack;
+    int stateTop;
 
     Value state;
 
@@ -86,6 +89,7 @@ Value* vm_get_error(VM* vm);
 Value* vm_get_state(VM* vm);
 void vm_set_state(VM* vm, Value* state);
 
+void clear_state_stack(VM* vm);
 void push_state_frame(VM* vm, Value* key);
 void pop_state_frame(VM* vm);
 void pop_discard_state_frame(VM* vm);
@@ -96,6 +100,7 @@ void vm_prepare_env(VM* vm, VM* callingVM);
 void vm_cleanup_on_stop(VM* vm);
 
 Term* vm_calling_term(VM* vm);
+Term* vm_find_calling_term(VM* vm, int height);
 void vm_to_frame_list(VM* vm, Value* frameList);
 
 void vm_install_functions(NativePatch* patch);
@@ -0,0 +1,869 @@
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+#include "common_headers.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "block.h"
+#include "building.h"
+#include "closures.h"
+#include "native_patch.h"
+
+#include "binary_repr.h"
+#include "kernel.h"
+#include "list.h"
+#include "modules.h"
+#include "names.h"
+#include "native_ptr.h"
+#include "string_type.h"
+#include "symbols.h"
+#include "tagged_value.h"
+#include "term.h"
+#include "type.h"
+#include "vm.h"
+#include "world.h"
+#include "worker_pool.h"
+
+namespace circa {
+
+/*
+ Worker pools
+
+ A WorkerPool runs script instances on a set of threads. Values (along with Types,
+ Blocks and everything else) aren't safe to share between threads, so each worker thread
+ calls circa_initialize to create its own World, and loads its own copy of the modules it
+ uses. Symbols are the only thing shared, since the symbol table is thread safe.
+
+ Nothing crosses between threads as a Value. Inputs and outputs are encoded in the binary
+ format (see binary_repr.cpp) by the sending thread, and decoded by the receiving thread.
+
+ An instance is a VM that stays on one worker thread. Calls to the same instance run in
+ the order they were made, and the VM keeps its state between calls.
+
+ A pool also runs tasks, which are chunks of a par_map/par_filter/par_reduce call. A task
+ can run on any thread, so a worker that runs out of messages will steal tasks from
+ the other workers' queues before it goes to sleep. Pushing a task also wakes one idle
+ worker, which looks for work to steal again. That way a task queued behind a long call
+ on a busy worker doesn't wait while other workers sleep.
+*/
+
+// -- Message queues --
+
+enum WorkerMessageKind {
+    MSG_SPAWN,
+    MSG_CALL,
+    MSG_KILL,
+    MSG_TASK,
+    MSG_STOP,
+    MSG_RESULT,
+    MSG_ERROR
+};
+
+struct WorkerMessage {
+    WorkerMessage* next;
+    WorkerMessageKind kind;
+    int instance;
+
+    // Encoded value (owned by the message), or NULL.
+    char* data;
+    u32 size;
+};
+
+struct WorkerQueue {
+    std::mutex mutex;
+    std::condition_variable ready;
+    WorkerMessage* first;
+    WorkerMessage* last;
+
+    WorkerQueue() : first(NULL), last(NULL) {}
+};
+
+static WorkerMessage* new_message(WorkerMessageKind kind, int instance, BinaryBuffer* buf)
+{
+    WorkerMessage* msg = (WorkerMessage*) malloc(sizeof(WorkerMessage));
+    msg->next = NULL;
+    msg->kind = kind;
+    msg->instance = instance;
+    msg->data = NULL;
+    msg->size = 0;
+    if (buf != NULL) {
+        msg->data = buf->data;
+        msg->size = buf->size;
+        binary_buffer_init(buf);
+    }
+    return msg;
+}
+
+static WorkerMessage* new_message(WorkerMessageKind kind, int instance, Value* value)
+{
+    BinaryBuffer buf;
+    binary_buffer_init(&buf);
+    Value error;
+    if (!binary_encode(value, &buf, &error))
+        internal_error(as_cstring(&error));
+    return new_message(kind, instance, &buf);
+}
+
+static void free_message(WorkerMessage* msg)
+{
+    free(msg->data);
+    free(msg);
+}
+
+static void message_decode(WorkerMessage* msg, Value* out)
+{
+    if (!binary_decode(msg->data, msg->size, out))
+        internal_error(as_cstring(out));
+}
+
+static void queue_push(WorkerQueue* queue, WorkerMessage* msg)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (queue->last == NULL)
+            queue->first = msg;
+        else
+            queue->last->next = msg;
+        queue->last = msg;
+    }
+    queue->ready.notify_one();
+}
+
+static WorkerMessage* queue_pop(WorkerQueue* queue, bool wait)
+{
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    while (wait && queue->first == NULL)
+        queue->ready.wait(lock);
+
+    WorkerMessage* msg = queue->first;
+    if (msg != NULL) {
+        queue->first = msg->next;
+        if (queue->first == NULL)
+            queue->last = NULL;
+    }
+    return msg;
+}
+
+// Remove and return the first MSG_TASK in the queue, if any.
+static WorkerMessage* queue_steal_task(WorkerQueue* queue)
+{
+    std::lock_guard<std::mutex> lock(queue->mutex);
+
+    WorkerMessage* prev = NULL;
+    for (WorkerMessage* msg = queue->first; msg != NULL; prev = msg, msg = msg->next) {
+        if (msg->kind != MSG_TASK)
+            continue;
+
+        if (prev == NULL)
+            queue->first = msg->next;
+        else
+            prev->next = msg->next;
+        if (queue->last == msg)
+            queue->last = prev;
+        msg->next = NULL;
+        return msg;
+    }
+    return NULL;
+}
+
+// -- Workers --
+
+// True on a pool's worker threads. par_map and friends run sequentially there, instead of
+// starting another pool.
+static CIRCA_THREAD_LOCAL bool g_onWorkerThread = false;
+
+struct Worker {
+    WorkerPool* pool;
+    std::thread thread;
+    WorkerQueue inbox;
+
+    // Set while the worker is out of messages, and is looking for tasks or sleeping.
+    std::atomic<bool> idle;
+
+    Worker() : idle(false) {}
+};
+
+struct WorkerPool {
+    int workerCount;
+    Worker* workers;
+
+    WorkerQueue results;
+
+    // Incremented for each task pushed, so that a sleeping worker can tell when there may
+    // be a task to steal.
+    std::atomic<int> taskGeneration;
+
+    // These are only used by the thread that owns the pool.
+    int nextInstance;
+    int pendingCalls;
+
+    // Encoded [fileSources, moduleSearchPaths], copied from the World that created the
+    // pool, so that workers find the same module files.
+    BinaryBuffer worldSettings;
+
+    caWorkerSetupFunc setup;
+    void* setupContext;
+};
+
+// State for one instance, on its worker thread. If the instance couldn't be created then
+// 'vm' is NULL and 'error' says why.
+struct WorkerInstance {
+    VM* vm;
+    Value error;
+};
+
+static void delete_instance_vm(VM* vm)
+{
+    free_vm(vm);
+    free(vm);
+}
+
+static void worker_spawn(World* world, WorkerInstance* instance, Value* args)
+{
+    Value* filename = list_get(args, 0);
+    Value* functionName = list_get(args, 1);
+
+    Block* module = load_module_by_filename(world, filename);
+    if (module == NULL) {
+        set_string(&instance->error, "module file not found: ");
+        string_append(&instance->error, filename);
+        return;
+    }
+
+    Term* function = find_local_name(module, functionName);
+    if (function == NULL || !is_function(function)) {
+        set_string(&instance->error, "function not found: ");
+        string_append(&instance->error, functionName);
+        return;
+    }
+
+    instance->vm = new_vm(nested_contents(function));
+}
+
+static WorkerMessage* vm_error_message(VM* vm, int id)
+{
+    Value* error = vm_get_error(vm);
+    if (is_string(error))
+        return new_message(MSG_ERROR, id, error);
+
+    Value message;
+    to_string(error, &message);
+    return new_message(MSG_ERROR, id, &message);
+}
+
+static WorkerMessage* worker_call(WorkerInstance* instance, int id, WorkerMessage* msg)
+{
+    if (instance == NULL) {
+        Value error;
+        set_string(&error, "instance doesn't exist");
+        return new_message(MSG_ERROR, id, &error);
+    }
+
+    if (instance->vm == NULL)
+        return new_message(MSG_ERROR, id, &instance->error);
+
+    VM* vm = instance->vm;
+
+    Value inputs;
+    message_decode(msg, &inputs);
+
+    vm_grow_stack(vm, list_length(&inputs) + 1);
+    for (int i=0; i < list_length(&inputs); i++)
+        move(list_get(&inputs, i), vm->input(i));
+
+    vm_run(vm, NULL);
+
+    if (vm_has_error(vm))
+        return vm_error_message(vm, id);
+
+    BinaryBuffer buf;
+    binary_buffer_init(&buf);
+    Value error;
+    if (!binary_encode(vm->output(), &buf, &error)) {
+        free(buf.data);
+        return new_message(MSG_ERROR, id, &error);
+    }
+    return new_message(MSG_RESULT, id, &buf);
+}
+
+// Run one chunk of a par_map/par_filter/par_reduce call. The task is encoded as
+// [moduleFilename, functionPath, bindings, op, items]; see par_apply.
+static WorkerMessage* worker_run_task(World* world, WorkerMessage* msg)
+{
+    int id = msg->instance;
+    Value task;
+    message_decode(msg, &task);
+
+    Value* filename = list_get(&task, 0);
+    Block* module = is_null(filename)
+        ? global_builtins_block()
+        : load_module_by_filename(world, filename);
+
+    Term* function = module == NULL ? NULL
+        : find_from_relative_name_list(list_get(&task, 1), module);
+
+    if (function == NULL || function->nestedContents == NULL) {
+        Value error;
+        set_string(&error, "couldn't find function on worker thread");
+        return new_message(MSG_ERROR, id, &error);
+    }
+
+    Symbol op = as_symbol(list_get(&task, 3));
+    Value* items = list_get(&task, 4);
+    int count = list_length(items);
+
+    VM* vm = new_vm(function->nestedContents);
+    move(list_get(&task, 2), &vm->topLevelUpvalues);
+
+    Value results;
+    set_list(&results, 0);
+
+    int start = 0;
+    if (op == s_reduce)
+        copy(list_get(items, start++), &results);
+
+    for (int i=start; i < count; i++) {
+        Value* item = list_get(items, i);
+
+        vm_grow_stack(vm, 3);
+        if (op == s_reduce) {
+            move(&results, vm->input(0));
+            copy(item, vm->input(1));
+        } else {
+            copy(item, vm->input(0));
+        }
+
+        vm_run(vm, NULL);
+
+        if (vm_has_error(vm)) {
+            WorkerMessage* error = vm_error_message(vm, id);
+            delete_instance_vm(vm);
+            return error;
+        }
+
+        Value* output = vm->output();
+        if (op == s_map)
+            move(output, list_append(&results));
+        else if (op == s_filter && is_bool(output) && as_bool(output))
+            move(item, list_append(&results));
+        else if (op == s_reduce)
+            move(output, &results);
+    }
+
+    delete_instance_vm(vm);
+
+    BinaryBuffer buf;
+    binary_buffer_init(&buf);
+    Value error;
+    if (!binary_encode(&results, &buf, &error)) {
+        free(buf.data);
+        return new_message(MSG_ERROR, id, &error);
+    }
+    return new_message(MSG_RESULT, id, &buf);
+}
+
+static WorkerMessage* worker_next_message(Worker* worker)
+{
+    WorkerPool* pool = worker->pool;
+    int self = worker - pool->workers;
+
+    while (true) {
+        WorkerMessage* msg = queue_pop(&worker->inbox, false);
+        if (msg != NULL)
+            return msg;
+
+        // Mark as idle before reading the generation. Then a task pushed after this read
+        // will see the flag, and wake us.
+        worker->idle = true;
+        int generation = pool->taskGeneration;
+
+        for (int i=1; i < pool->workerCount; i++) {
+            msg = queue_steal_task(&pool->workers[(self + i) % pool->workerCount].inbox);
+            if (msg != NULL) {
+                worker->idle = false;
+                return msg;
+            }
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(worker->inbox.mutex);
+            while (worker->inbox.first == NULL && pool->taskGeneration == generation)
+                worker->inbox.ready.wait(lock);
+        }
+        worker->idle = false;
+    }
+}
+
+// Queue a task on one worker, and wake another worker that's idle, since it can steal
+// the task if the first worker is busy.
+static void pool_push_task(WorkerPool* pool, int workerIndex, WorkerMessage* msg)
+{
+    queue_push(&pool->workers[workerIndex].inbox, msg);
+    pool->taskGeneration++;
+
+    for (int i=1; i < pool->workerCount; i++) {
+        Worker* other = &pool->workers[(workerIndex + i) % pool->workerCount];
+        if (other->idle) {
+            // Taking the lock means the worker is either waiting, or will see the new
+            // generation before it waits.
+            std::lock_guard<std::mutex> lock(other->inbox.mutex);
+            other->inbox.ready.notify_one();
+            break;
+        }
+    }
+}
+
+static void worker_main(Worker* worker)
+{
+    WorkerPool* pool = worker->pool;
+    g_onWorkerThread = true;
+    World* world = circa_initialize();
+
+    {
+        WorkerMessage settingsMsg;
+        settingsMsg.data = pool->worldSettings.data;
+        settingsMsg.size = pool->worldSettings.size;
+        Value settings;
+        message_decode(&settingsMsg, &settings);
+        move(list_get(&settings, 0), &world->fileSources);
+        move(list_get(&settings, 1), &world->moduleSearchPaths);
+    }
+
+    if (pool->setup != NULL)
+        pool->setup(pool->setupContext, world);
+
+    std::map<int, WorkerInstance*> instances;
+
+    while (true) {
+        WorkerMessage* msg = worker_next_message(worker);
+        WorkerMessageKind kind = msg->kind;
+
+        std::map<int, WorkerInstance*>::iterator found = instances.find(msg->instance);
+        WorkerInstance* instance = found == instances.end() ? NULL : found->second;
+
+        switch (kind) {
+        case MSG_SPAWN: {
+            instance = new WorkerInstance();
+            instance->vm = NULL;
+            instances[msg->instance] = instance;
+
+            Value args;
+            message_decode(msg, &args);
+            worker_spawn(world, instance, &args);
+            break;
+        }
+        case MSG_CALL:
+            queue_push(&pool->results, worker_call(instance, msg->instance, msg));
+            break;
+        case MSG_KILL:
+            if (instance != NULL) {
+                if (instance->vm != NULL)
+                    delete_instance_vm(instance->vm);
+                delete instance;
+                instances.erase(msg->instance);
+            }
+            break;
+        case MSG_TASK:
+            queue_push(&pool->results, worker_run_task(world, msg));
+            break;
+        default:
+            break;
+        }
+
+        free_message(msg);
+
+        if (kind == MSG_STOP)
+            break;
+    }
+
+    for (std::map<int, WorkerInstance*>::iterator it = instances.begin();
+            it != instances.end(); ++it) {
+        if (it->second->vm != NULL)
+            delete_instance_vm(it->second->vm);
+        delete it->second;
+    }
+
+    circa_shutdown(world);
+}
+
+WorkerPool* worker_pool_create(World* world, int threadCount, caWorkerSetupFunc setup,
+    void* context)
+{
+    if (threadCount < 1)
+        threadCount = 1;
+
+    WorkerPool* pool = new WorkerPool();
+    pool->workerCount = threadCount;
+    pool->workers = new Worker[threadCount];
+    pool->nextInstance = 1;
+    pool->pendingCalls = 0;
+    pool->taskGeneration = 0;
+    pool->setup = setup;
+    pool->setupContext = context;
+
+    Value settings;
+    set_list(&settings, 2);
+    copy(&world->fileSources, list_get(&settings, 0));
+    copy(&world->moduleSearchPaths, list_get(&settings, 1));
+
+    binary_buffer_init(&pool->worldSettings);
+    Value error;
+    if (!binary_encode(&settings, &pool->worldSettings, &error))
+        internal_error(as_cstring(&error));
+
+    for (int i=0; i < threadCount; i++) {
+        Worker* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->thread = std::thread(worker_main, worker);
+    }
+
+    return pool;
+}
+
+void worker_pool_free(WorkerPool* pool)
+{
+    for (int i=0; i < pool->workerCount; i++)
+        queue_push(&pool->workers[i].inbox, new_message(MSG_STOP, 0, (BinaryBuffer*) NULL));
+
+    for (int i=0; i < pool->workerCount; i++)
+        pool->workers[i].thread.join();
+
+    while (WorkerMessage* msg = queue_pop(&pool->results, false))
+        free_message(msg);
+
+    free(pool->worldSettings.data);
+    delete[] pool->workers;
+    delete pool;
+}
+
+static Worker* instance_worker(WorkerPool* pool, int instance)
+{
+    return &pool->workers[instance % pool->workerCount];
+}
+
+int worker_pool_spawn(WorkerPool* pool, const char* filename, const char* functionName)
+{
+    int instance = pool->nextInstance++;
+
+    Value args;
+    set_list(&args, 2);
+    set_string(list_get(&args, 0), filename);
+    set_string(list_get(&args, 1), functionName);
+
+    queue_push(&instance_worker(pool, instance)->inbox,
+        new_message(MSG_SPAWN, instance, &args));
+    return instance;
+}
+
+bool worker_pool_call(WorkerPool* pool, int instance, Value* inputs, Value* errorOut)
+{
+    BinaryBuffer buf;
+    binary_buffer_init(&buf);
+    if (!binary_encode(inputs, &buf, errorOut)) {
+        free(buf.data);
+        return false;
+    }
+
+    pool->pendingCalls++;
+    queue_push(&instance_worker(pool, instance)->inbox,
+        new_message(MSG_CALL, instance, &buf));
+    return true;
+}
+
+bool worker_pool_receive(WorkerPool* pool, Value* resultOut, bool wait)
+{
+    if (pool->pendingCalls == 0)
+        return false;
+
+    WorkerMessage* msg = queue_pop(&pool->results, wait);
+    if (msg == NULL)
+        return false;
+
+    pool->pendingCalls--;
+
+    set_list(resultOut, 3);
+    set_int(list_get(resultOut, 0), msg->instance);
+    set_symbol(list_get(resultOut, 1), msg->kind == MSG_RESULT ? s_success : s_error);
+    message_decode(msg, list_get(resultOut, 2));
+    free_message(msg);
+    return true;
+}
+
+void worker_pool_kill(WorkerPool* pool, int instance)
+{
+    queue_push(&instance_worker(pool, instance)->inbox,
+        new_message(MSG_KILL, instance, (BinaryBuffer*) NULL));
+}
+
+// -- Parallel list functions --
+
+// Don't split a list into chunks smaller than this.
+static const int PAR_MIN_CHUNK_SIZE = 256;
+
+// Most chunks per worker thread. More chunks than threads gives idle workers something
+// to steal when the work is uneven.
+static const int PAR_CHUNKS_PER_WORKER = 4;
+
+static int default_worker_thread_count()
+{
+    const char* env = getenv("CIRCA_WORKER_THREADS");
+    if (env != NULL)
+        return atoi(env);
+    return std::thread::hardware_concurrency();
+}
+
+// Find how a worker thread can load the function: writes [moduleFilename, functionPath]
+// to 'locationOut'. A nil filename means the function is a builtin. Returns false if the
+// function isn't safe to run on other threads (it has state or effects), or if it can't
+// be found by name.
+static bool par_function_location(Value* func, Value* locationOut)
+{
+    Block* block = func_block(func);
+    if (block == NULL || block->owningTerm == NULL)
+        return false;
+
+    if (block_has_state(block) == s_yes || block_has_effects(block))
+        return false;
+
+    Value filename;
+    Block* module = find_enclosing_module(block);
+    if (module == NULL) {
+        module = global_builtins_block();
+    } else {
+        Value* prop = block_get_property(module, s_filename);
+        if (prop == NULL)
+            return false;
+        copy(prop, &filename);
+    }
+
+    Value path;
+    get_relative_name_as_list(block->owningTerm, module, &path);
+    if (is_null(&path))
+        return false;
+
+    set_list(locationOut, 2);
+    move(&filename, list_get(locationOut, 0));
+    move(&path, list_get(locationOut, 1));
+    return true;
+}
+
+// Run 'op' (:map, :filter or :reduce) over the list using the World's worker pool. For
+// :reduce, the result is a list of partial results, one per chunk. Returns false if the
+// call should run sequentially instead.
+static bool par_apply(World* world, Value* list, Value* func, Symbol op, Value* resultOut,
+    Value* errorOut)
+{
+    if (g_onWorkerThread)
+        return false;
+
+    int length = list_length(list);
+    Value location;
+    if (length < PAR_MIN_CHUNK_SIZE * 2 || !par_function_location(func, &location))
+        return false;
+
+    if (world->workerPool == NULL) {
+        int threadCount = default_worker_thread_count();
+        if (threadCount < 2)
+            return false;
+        world->workerPool = worker_pool_create(world, threadCount, NULL, NULL);
+    }
+
+    WorkerPool* pool = world->workerPool;
+
+    int chunkCount = length / PAR_MIN_CHUNK_SIZE;
+    if (chunkCount > pool->workerCount * PAR_CHUNKS_PER_WORKER)
+        chunkCount = pool->workerCount * PAR_CHUNKS_PER_WORKER;
+
+    // Encode every chunk before sending any, so that we can still fall back if a value
+    // can't be sent.
+    BinaryBuffer* chunks = new BinaryBuffer[chunkCount];
+    bool encoded = true;
+    Value task;
+    set_list(&task, 5);
+    copy(list_get(&location, 0), list_get(&task, 0));
+    copy(list_get(&location, 1), list_get(&task, 1));
+    copy(func_bindings(func), list_get(&task, 2));
+    set_symbol(list_get(&task, 3), op);
+
+    for (int chunk=0; chunk < chunkCount; chunk++) {
+        int start = (int) ((i64) length * chunk / chunkCount);
+        int end = (int) ((i64) length * (chunk + 1) / chunkCount);
+
+        Value* items = list_get(&task, 4);
+        set_list(items, end - start);
+        for (int i=start; i < end; i++)
+            copy(list_get(list, i), list_get(items, i - start));
+
+        binary_buffer_init(&chunks[chunk]);
+        Value error;
+        if (encoded && !binary_encode(&task, &chunks[chunk], &error))
+            encoded = false;
+    }
+
+    if (!encoded) {
+        for (int chunk=0; chunk < chunkCount; chunk++)
+            free(chunks[chunk].data);
+        delete[] chunks;
+        return false;
+    }
+
+    for (int chunk=0; chunk < chunkCount; chunk++)
+        pool_push_task(pool, chunk % pool->workerCount,
+            new_message(MSG_TASK, chunk, &chunks[chunk]));
+    delete[] chunks;
+
+    Value partials;
+    set_list(&partials, chunkCount);
+    int firstError = chunkCount;
+
+    for (int received=0; received < chunkCount; received++) {
+        WorkerMessage* msg = queue_pop(&pool->results, true);
+        int chunk = msg->instance;
+
+        if (msg->kind == MSG_ERROR && chunk < firstError) {
+            firstError = chunk;
+            message_decode(msg, errorOut);
+        } else if (msg->kind == MSG_RESULT) {
+            message_decode(msg, list_get(&partials, chunk));
+        }
+        free_message(msg);
+    }
+
+    if (firstError < chunkCount)
+        return true;
+
+    if (op == s_reduce) {
+        move(&partials, resultOut);
+        return true;
+    }
+
+    set_list(resultOut, 0);
+    for (int chunk=0; chunk < chunkCount; chunk++) {
+        Value* items = list_get(&partials, chunk);
+        for (int i=0; i < list_length(items); i++)
+            move(list_get(items, i), list_append(resultOut));
+    }
+    return true;
+}
+
+// -- Builtins --
+
+static void worker_pool_release(void* ptr)
+{
+    worker_pool_free((WorkerPool*) ptr);
+}
+
+static WorkerPool* as_worker_pool(Value* value)
+{
+    return (WorkerPool*) as_native_ptr(value->index(0));
+}
+
+void make_worker_pool(VM* vm)
+{
+    WorkerPool* pool = worker_pool_create(vm->world, vm->input(0)->as_i(), NULL, NULL);
+    Value* out = vm->output();
+    make(TYPES.worker_pool, out);
+    set_native_ptr(out->index(0), pool, worker_pool_release);
+}
+
+void WorkerPool__spawn(VM* vm)
+{
+    int instance = worker_pool_spawn(as_worker_pool(vm->input(0)),
+        as_cstring(vm->input(1)), as_cstring(vm->input(2)));
+    set_int(vm->output(), instance);
+}
+
+void WorkerPool__call(VM* vm)
+{
+    Value error;
+    if (!worker_pool_call(as_worker_pool(vm->input(0)), vm->input(1)->as_i(),
+            vm->input(2), &error))
+        vm->throw_error(&error);
+}
+
+void WorkerPool__receive(VM* vm)
+{
+    if (!worker_pool_receive(as_worker_pool(vm->input(0)), vm->output(), true))
+        set_null(vm->output());
+}
+
+void WorkerPool__kill(VM* vm)
+{
+    worker_pool_kill(as_worker_pool(vm->input(0)), vm->input(1)->as_i());
+}
+
+void on_worker_thread(VM* vm)
+{
+    set_bool(vm->output(), g_onWorkerThread);
+}
+
+void List___par_apply(VM* vm)
+{
+    Value result;
+    Value error;
+    bool ran = par_apply(vm->world, vm->input(0), vm->input(1), as_symbol(vm->input(2)),
+        &result, &error);
+
+    if (!is_null(&error))
+        return vm->throw_error(&error);
+
+    Value* out = vm->output();
+    if (!ran) {
+        set_list(out, 0);
+    } else {
+        set_list(out, 1);
+        move(&result, list_get(out, 0));
+    }
+}
+
+void worker_pool_install_functions(NativePatch* patch)
+{
+    circa_patch_function(patch, "worker_pool", make_worker_pool);
+    circa_patch_function(patch, "WorkerPool.spawn", WorkerPool__spawn);
+    circa_patch_function(patch, "WorkerPool.call", WorkerPool__call);
+    circa_patch_function(patch, "WorkerPool.receive", WorkerPool__receive);
+    circa_patch_function(patch, "WorkerPool.kill", WorkerPool__kill);
+    circa_patch_function(patch, "on_worker_thread", on_worker_thread);
+    circa_patch_function(patch, "List._par_apply", List___par_apply);
+}
+
+} // namespace circa
+
+using namespace circa;
+
+CIRCA_EXPORT caWorkerPool* circa_new_worker_pool(caWorld* world, int threadCount,
+    caWorkerSetupFunc setup, void* context)
+{
+    return worker_pool_create(world, threadCount, setup, context);
+}
+
+CIRCA_EXPORT void circa_free_worker_pool(caWorkerPool* pool)
+{
+    worker_pool_free(pool);
+}
+
+CIRCA_EXPORT int circa_worker_spawn(caWorkerPool* pool, const char* filename,
+    const char* functionName)
+{
+    return worker_pool_spawn(pool, filename, functionName);
+}
+
+CIRCA_EXPORT bool circa_worker_call(caWorkerPool* pool, int instance, caValue* inputs,
+    caValue* errorOut)
+{
+    return worker_pool_call(pool, instance, inputs, errorOut);
+}
+
+CIRCA_EXPORT bool circa_worker_receive(caWorkerPool* pool, caValue* resultOut, bool wait)
+{
+    return worker_pool_receive(pool, resultOut, wait);
+}
+
+CIRCA_EXPORT void circa_worker_kill(caWorkerPool* pool, int instance)
+{
+    worker_pool_kill(pool, instance);
+}
@@ -0,0 +1,30 @@
+// Copyright (c) Andrew Fischer. See LICENSE file for license terms.
+
+#pragma once
+
+namespace circa {
+
+struct WorkerPool;
+
+WorkerPool* worker_pool_create(World* world, int threadCount, caWorkerSetupFunc setup,
+    void* context);
+void worker_pool_free(WorkerPool* pool);
+
+// Create a script instance, which runs the function 'functionName' from the module file
+// 'filename'. Returns the new instance's id.
+int worker_pool_spawn(WorkerPool* pool, const char* filename, const char* functionName);
+
+// Queue a call to an instance. 'inputs' is a list. Returns false (and writes to 'errorOut')
+// if the inputs can't be sent to another thread.
+bool worker_pool_call(WorkerPool* pool, int instance, Value* inputs, Value* errorOut);
+
+// Fetch the result of a finished call, as [instance, :success, output] or
+// [instance, :error, message]. If 'wait' is true then this blocks until one is ready.
+// Returns false if there is no result (and, when waiting, no calls still running).
+bool worker_pool_receive(WorkerPool* pool, Value* resultOut, bool wait);
+
+void worker_pool_kill(WorkerPool* pool, int instance);
+
+void worker_pool_install_functions(NativePatch* patch);
+
+} // namespace circa
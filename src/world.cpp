@@ -19,6 +19,7 @@
 #include "string_type.h"
 #include "tagged_value.h"
 #include "term.h"
+#include "worker_pool.h"
 #include "world.h"
 
 #if CIRCA_ENABLE_LIBUV
@@ -75,6 +76,7 @@ void world_initialize(World* world)
 
     world->fileWatchWorld = alloc_file_watch_world();
     world->builtinPatch = circa_create_native_patch(world, "builtins");
+    world->workerPool = NULL;
 
     #if CIRCA_ENABLE_LIBUV
         world->libuvWorld = alloc_libuv_world();
@@ -85,6 +87,10 @@ void world_initialize(World* world)
 
 void world_uninitialize(World* world)
 {
+    if (world->workerPool != NULL)
+        worker_pool_free(world->workerPool);
+    world->workerPool = NULL;
+
     set_null(&world->moduleSearchPaths);
     free_file_watch_world(world->fileWatchWorld);
 }
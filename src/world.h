@@ -15,6 +15,9 @@ struct World {
     FileWatchWorld* fileWatchWorld;
     LibuvWorld* libuvWorld;
 
+    // Worker threads used by List.par_map and friends. Started on first use.
+    WorkerPool* workerPool;
+
     // Global IDs.
     int nextTermID;
     int nextBlockID;
@@ -24,9 +24,13 @@ class CircaProcess:
 
         # Create proc if necessary
         if self.proc is None:
+            # Use a fixed number of worker threads, so that the parallel list functions
+            # use the worker pool and split lists the same way on every machine.
+            env = dict(os.environ)
+            env['CIRCA_WORKER_THREADS'] = '3'
             self.proc = subprocess.Popen(ExecutablePath + " -run-stdin",
                 shell=True, stdin=subprocess.PIPE,
-                stdout=subprocess.PIPE, close_fds=True)
+                stdout=subprocess.PIPE, close_fds=True, env=env)
 
             (self.stdin, self.stdout) = (self.proc.stdin, self.proc.stdout)
             
@@ -171,6 +175,16 @@ def run_one_test(suite, file):
     if failed:
         suite.failedTests.append(file)
 
+def binary_has_perf_stats(process):
+    import tempfile
+    with tempfile.NamedTemporaryFile('w', suffix='.ca', delete=False) as probe:
+        probe.write("print(perf_stats_enabled())\n")
+    try:
+        output = list(process.run(probe.name))
+    finally:
+        os.remove(probe.name)
+    return output == ['true']
+
 def run_all_tests(suite):
 
     # Fetch list of disabled tests
@@ -181,6 +195,12 @@ def run_all_tests(suite):
         #print("skip pattern:", line)
         disabled_test_patterns.append(re.compile(line))
 
+    # Tests in stats/ check VM.perf_stats counters, which are compiled out of release
+    # builds by default.
+    if not binary_has_perf_stats(suite.process):
+        print("Perf stats are disabled in this build, skipping " + TestRoot + "/stats")
+        disabled_test_patterns.append(re.compile(os.path.join(TestRoot, 'stats/')))
+
 
     # Iterate through each test file
     for file in list_files_recr(TestRoot):